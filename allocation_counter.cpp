@@ -0,0 +1,94 @@
+#include "allocation_counter.h"
+
+#ifndef DECIMATE_COUNT_ALLOCATIONS
+
+long long heap_allocation_count()
+{
+	return -1;
+}
+
+#else
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic< long long > allocations( 0 );
+}
+
+long long heap_allocation_count()
+{
+	return allocations.load( std::memory_order_relaxed );
+}
+
+#if defined( __GLIBC__ )
+
+// Replace the C allocation functions, which also serve operator new and
+// Eigen's dynamic matrices, and forward to glibc's own.
+extern "C"
+{
+	void * __libc_malloc( size_t size );
+	void * __libc_calloc( size_t count, size_t size );
+	void * __libc_realloc( void * p, size_t size );
+	void * __libc_memalign( size_t alignment, size_t size );
+
+	void * malloc( size_t size )
+	{
+		allocations.fetch_add( 1, std::memory_order_relaxed );
+		return __libc_malloc( size );
+	}
+	void * calloc( size_t count, size_t size )
+	{
+		allocations.fetch_add( 1, std::memory_order_relaxed );
+		return __libc_calloc( count, size );
+	}
+	void * realloc( void * p, size_t size )
+	{
+		allocations.fetch_add( 1, std::memory_order_relaxed );
+		return __libc_realloc( p, size );
+	}
+	void * memalign( size_t alignment, size_t size )
+	{
+		allocations.fetch_add( 1, std::memory_order_relaxed );
+		return __libc_memalign( alignment, size );
+	}
+	void * aligned_alloc( size_t alignment, size_t size )
+	{
+		allocations.fetch_add( 1, std::memory_order_relaxed );
+		return __libc_memalign( alignment, size );
+	}
+	int posix_memalign( void ** p, size_t alignment, size_t size )
+	{
+		allocations.fetch_add( 1, std::memory_order_relaxed );
+		*p = __libc_memalign( alignment, size );
+		return *p ? 0 : ENOMEM;
+	}
+}
+
+#else
+
+// Elsewhere only operator new is counted, which misses Eigen's matrices.
+void * operator new( size_t size )
+{
+	allocations.fetch_add( 1, std::memory_order_relaxed );
+	if( void * p = std::malloc( size ? size : 1 ) ) return p;
+	throw std::bad_alloc();
+}
+void * operator new[]( size_t size ) { return operator new( size ); }
+void * operator new( size_t size, const std::nothrow_t & ) noexcept
+{
+	allocations.fetch_add( 1, std::memory_order_relaxed );
+	return std::malloc( size ? size : 1 );
+}
+void * operator new[]( size_t size, const std::nothrow_t & tag ) noexcept { return operator new( size, tag ); }
+void operator delete( void * p ) noexcept { std::free( p ); }
+void operator delete[]( void * p ) noexcept { std::free( p ); }
+void operator delete( void * p, const std::nothrow_t & ) noexcept { std::free( p ); }
+void operator delete[]( void * p, const std::nothrow_t & ) noexcept { std::free( p ); }
+
+#endif
+
+#endif
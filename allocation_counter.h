@@ -0,0 +1,13 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+// Returns the number of heap allocations the program has made so far if it
+// was built with DECIMATE_COUNT_ALLOCATIONS (the CMake option of the same
+// name), and -1 otherwise. For checking that a piece of code doesn't
+// allocate:
+//     const long long before = heap_allocation_count();
+//     ...
+//     const long long allocations = heap_allocation_count() - before;
+long long heap_allocation_count();
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef ATTRIBUTE_QUADRIC_H
+#define ATTRIBUTE_QUADRIC_H
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+// A symmetric (N+1)x(N+1) quadric over homogeneous N-dimensional points
+// (x,y,z,u,v,a...,1), stored as the coefficients of its upper triangle (row
+// by row). The first five coordinates are the position and the texture
+// coordinate; the rest are attributes carried along with them, such as a
+// normal. All sizes are fixed, so each dimension compiles to its own code.
+template < int N >
+struct AttributeQuadric
+{
+	enum { DIM = N, NUM_COEFFS = ( N + 1 )*( N + 2 )/2 };
+	typedef Eigen::Matrix<double,N+1,N+1> Matrix;
+	typedef Eigen::Matrix<double,N+1,1> Vector;
+	typedef Eigen::Matrix<double,N,1> Point;
+
+	double c[NUM_COEFFS];
+
+	// The zero quadric.
+	AttributeQuadric() { std::fill( c, c + NUM_COEFFS, 0.0 ); }
+	explicit AttributeQuadric( const Matrix & M )
+	{
+		for( int i = 0; i <= N; ++i ) {
+			for( int j = i; j <= N; ++j ) {
+				c[ index( i, j ) ] = M( i, j );
+			}
+		}
+	}
+
+	// Index of entry (i,j) in c.
+	static int index( int i, int j )
+	{
+		if( i > j ) std::swap( i, j );
+		return i*(N+1) - i*(i-1)/2 + (j-i);
+	}
+	double operator()( int i, int j ) const { return c[ index( i, j ) ]; }
+
+	Matrix matrix() const
+	{
+		Matrix M;
+		for( int i = 0; i <= N; ++i ) {
+			for( int j = i; j <= N; ++j ) {
+				M( i, j ) = M( j, i ) = c[ index( i, j ) ];
+			}
+		}
+		return M;
+	}
+	// Returns v' * Q * v.
+	double evaluate( const Vector & v ) const { return v.dot( matrix() * v ); }
+
+	AttributeQuadric & operator+=( const AttributeQuadric & rhs )
+	{
+		for( int k = 0; k < NUM_COEFFS; ++k ) c[k] += rhs.c[k];
+		return *this;
+	}
+	AttributeQuadric & operator*=( double s )
+	{
+		for( int k = 0; k < NUM_COEFFS; ++k ) c[k] *= s;
+		return *this;
+	}
+};
+
+template < int N >
+AttributeQuadric< N > operator+( const AttributeQuadric< N > & lhs, const AttributeQuadric< N > & rhs )
+{
+	AttributeQuadric< N > result( lhs );
+	result += rhs;
+	return result;
+}
+
+// Returns the quadric of the squared distance to the plane of the triangle
+// (p1,p2,p3) in N dimensions. See Garland and Heckbert 1998, Sections 3.4
+// and 5.1.
+template < int N >
+AttributeQuadric< N > face_attribute_quadric(
+	const Eigen::Matrix<double,N,1> & p1,
+	const Eigen::Matrix<double,N,1> & p2,
+	const Eigen::Matrix<double,N,1> & p3 )
+{
+	typedef Eigen::Matrix<double,N,1> Point;
+
+	// Paper Section 5.1
+	const Point e1 = (p2-p1)/(p2-p1).norm();
+	Point e2 = p3-p1-(e1.dot(p3-p1))*e1;
+	e2 /= e2.norm();
+	assert( std::fabs(e1.norm() - 1) <= 1e-7 );
+	assert( std::fabs(e2.norm() - 1) <= 1e-7 );
+
+	const Eigen::Matrix<double,N,N> A = Eigen::Matrix<double,N,N>::Identity() - e1*e1.transpose() - e2*e2.transpose();
+	const Point b = p1.dot(e1)*e1 + p1.dot(e2)*e2 - p1;
+	const double c = p1.dot(p1) - p1.dot(e1)*p1.dot(e1) - p1.dot(e2)*p1.dot(e2);
+
+	// Paper Section 3.4
+	typename AttributeQuadric< N >::Matrix metric;
+	metric.template block<N,N>(0,0) = A;
+	metric.template block<N,1>(0,N) = b;
+	metric.template block<1,N>(N,0) = b.transpose();
+	metric(N,N) = c;
+	return AttributeQuadric< N >( metric );
+}
+
+// The attributes of q, split off from the position and texture coordinate:
+// with x = (x,y,z,u,v,1) and a the attributes,
+//     Q(x,a) = x' P x + 2 a' B' x + a' A a.
+template < int N >
+void split_attributes(
+	const AttributeQuadric< N > & q,
+	Eigen::Matrix<double,6,6> & P,
+	Eigen::Matrix<double,6,N-5> & B,
+	Eigen::Matrix<double,N-5,N-5> & A )
+{
+	const int K = N - 5;
+	for( int i = 0; i < 6; ++i ) {
+		const int qi = i < 5 ? i : N;
+		for( int j = 0; j < 6; ++j ) P(i,j) = q( qi, j < 5 ? j : N );
+		for( int k = 0; k < K; ++k ) B(i,k) = q( qi, 5 + k );
+	}
+	for( int k = 0; k < K; ++k ) {
+		for( int l = 0; l < K; ++l ) A(k,l) = q( 5 + k, 5 + l );
+	}
+	// Keeps A positive definite where the faces don't constrain every
+	// attribute, e.g. a single face.
+	A.diagonal().array() += 1e-9;
+}
+
+// The 5D quadric of the error left at each position and texture coordinate
+// once the attributes take the values minimizing q there, i.e. the Schur
+// complement P - B A^-1 B' of split_attributes(). Placing a vertex by
+// minimizing it is the same as minimizing q over every coordinate.
+template < int N >
+AttributeQuadric< 5 > reduce_attributes( const AttributeQuadric< N > & q )
+{
+	Eigen::Matrix<double,6,6> P;
+	Eigen::Matrix<double,6,N-5> B;
+	Eigen::Matrix<double,N-5,N-5> A;
+	split_attributes( q, P, B, A );
+	const Eigen::Matrix<double,N-5,6> X = A.ldlt().solve( B.transpose() );
+	return AttributeQuadric< 5 >( Eigen::Matrix<double,6,6>( P - B*X ) );
+}
+
+// The attributes minimizing q at the position and texture coordinate p.
+template < int N >
+Eigen::Matrix<double,N-5,1> best_attributes( const AttributeQuadric< N > & q, const Eigen::Matrix<double,5,1> & p )
+{
+	Eigen::Matrix<double,6,6> P;
+	Eigen::Matrix<double,6,N-5> B;
+	Eigen::Matrix<double,N-5,N-5> A;
+	split_attributes( q, P, B, A );
+	Eigen::Matrix<double,6,1> x;
+	x << p, 1;
+	return A.ldlt().solve( -B.transpose()*x );
+}
+
+#endif
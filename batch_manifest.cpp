@@ -0,0 +1,48 @@
+#include "batch_manifest.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+int BatchJob::target_for( int num_vertices ) const
+{
+	if( percent_vertices > 0 ) return int( lround( ( percent_vertices * num_vertices )/100. ) );
+	return target_num_vertices;
+}
+
+bool read_batch_manifest( const std::string & path, std::vector< BatchJob > & jobs, std::string & error )
+{
+	jobs.clear();
+	std::ifstream in( path );
+	if( !in ) {
+		error = "Could not read manifest: " + path;
+		return false;
+	}
+	std::string text;
+	for( int line = 1; std::getline( in, text ); ++line ) {
+		std::istringstream fields( text );
+		std::string first;
+		if( !( fields >> first ) || first[0] == '#' ) continue;
+
+		BatchJob job;
+		job.line = line;
+		job.input_path = first;
+		std::string target;
+		const bool parsed = bool( fields >> target >> job.seam_aware_degree >> job.uv_weight >> job.output_path );
+		std::string rest;
+		bool valid_target = !target.empty();
+		if( valid_target && target.back() == '%' ) {
+			std::istringstream percent( target.substr( 0, target.size() - 1 ) );
+			valid_target = bool( percent >> job.percent_vertices ) && percent.eof() && job.percent_vertices > 0;
+		}
+		else if( valid_target ) {
+			std::istringstream count( target );
+			valid_target = bool( count >> job.target_num_vertices ) && count.eof() && job.target_num_vertices > 0;
+		}
+		if( !parsed || ( fields >> rest ) || !valid_target || job.seam_aware_degree < 0 || job.seam_aware_degree > 2 ) {
+			error = path + ":" + std::to_string( line ) + ": Expected <input> <target> <strictness> <uv-weight> <output>: " + text;
+			return false;
+		}
+		jobs.push_back( job );
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#ifndef BATCH_MANIFEST_H
+#define BATCH_MANIFEST_H
+
+#include <string>
+#include <vector>
+
+// One mesh of a batch manifest. A manifest has one job per line:
+//
+//   <input> <target> <strictness> <uv-weight> <output>
+//
+// separated by whitespace, so paths can't contain any. <target> is a number
+// of vertices, or a percentage of the input's vertices if it ends in '%'.
+// Blank lines and lines starting with '#' are skipped.
+struct BatchJob
+{
+	std::string input_path;
+	std::string output_path;
+	// Exactly one of these is used: percent_vertices if it is positive.
+	int target_num_vertices = 0;
+	double percent_vertices = 0.0;
+	int seam_aware_degree = 2;
+	double uv_weight = 1.0;
+	// The line of the manifest, for messages.
+	int line = 0;
+
+	// The target for an input mesh with num_vertices vertices.
+	int target_for( int num_vertices ) const;
+};
+
+// Reads the jobs of the manifest at `path`. Returns false, with a message in
+// `error`, if the file can't be read or a line is malformed.
+bool read_batch_manifest( const std::string & path, std::vector< BatchJob > & jobs, std::string & error );
+
+#endif
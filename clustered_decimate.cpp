@@ -0,0 +1,286 @@
+#include "clustered_decimate.h"
+#include "quadric_error_metric.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// The centroid of face f times 3.
+	Eigen::RowVector3d centroid( const Eigen::MatrixXd & V, const Eigen::MatrixXi & F, int f )
+	{
+		return V.row( F(f,0) ) + V.row( F(f,1) ) + V.row( F(f,2) );
+	}
+
+	// Splits faces[begin..end) until every part has at most max_faces faces,
+	// appending the end of each part to offsets in order.
+	void split_clusters(
+		const Eigen::MatrixXd & V,
+		const Eigen::MatrixXi & F,
+		int max_faces,
+		int begin,
+		int end,
+		std::vector< int > & faces,
+		std::vector< int > & offsets )
+	{
+		if( end - begin <= max_faces ) {
+			offsets.push_back( end );
+			return;
+		}
+		Eigen::RowVector3d lo = centroid( V, F, faces[begin] ), hi = lo;
+		for( int i = begin + 1; i < end; ++i ) {
+			const Eigen::RowVector3d c = centroid( V, F, faces[i] );
+			lo = lo.cwiseMin( c );
+			hi = hi.cwiseMax( c );
+		}
+		int axis;
+		( hi - lo ).maxCoeff( &axis );
+		// Ties are broken by face index, so the split doesn't depend on the
+		// standard library.
+		const int middle = begin + ( end - begin )/2;
+		std::nth_element( faces.begin() + begin, faces.begin() + middle, faces.begin() + end, [&]( int a, int b )
+		{
+			const double ca = centroid( V, F, a )( axis ), cb = centroid( V, F, b )( axis );
+			return ca < cb || ( ca == cb && a < b );
+		} );
+		split_clusters( V, F, max_faces, begin, middle, faces, offsets );
+		split_clusters( V, F, max_faces, middle, end, faces, offsets );
+	}
+
+	// Sorts the distinct entries of the rows rows[0..n) of M into ids, and
+	// replaces each entry by its index in ids.
+	void compact_indices(
+		const Eigen::MatrixXi & M,
+		const int * rows,
+		int n,
+		Eigen::MatrixXi & local,
+		Eigen::VectorXi & ids )
+	{
+		std::vector< int > sorted( 3*n );
+		for( int i = 0; i < n; ++i ) {
+			for( int k = 0; k < 3; ++k ) sorted[3*i+k] = M( rows[i], k );
+		}
+		std::sort( sorted.begin(), sorted.end() );
+		sorted.erase( std::unique( sorted.begin(), sorted.end() ), sorted.end() );
+		ids = Eigen::Map< Eigen::VectorXi >( sorted.data(), sorted.size() );
+		local.resize( n, 3 );
+		for( int i = 0; i < n; ++i ) {
+			for( int k = 0; k < 3; ++k ) {
+				local( i, k ) = int( std::lower_bound( sorted.begin(), sorted.end(), M( rows[i], k ) ) - sorted.begin() );
+			}
+		}
+	}
+}
+
+int partition_mesh(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	int max_cluster_faces,
+	std::vector< int > & faces,
+	std::vector< int > & offsets )
+{
+	assert( max_cluster_faces > 0 );
+	faces.resize( F.rows() );
+	for( int f = 0; f < F.rows(); ++f ) faces[f] = f;
+	offsets.assign( 1, 0 );
+	if( F.rows() > 0 ) split_clusters( V, F, max_cluster_faces, 0, F.rows(), faces, offsets );
+	return int( offsets.size() ) - 1;
+}
+
+void find_shared_vertices(
+	const Eigen::MatrixXi & F,
+	const std::vector< int > & faces,
+	const std::vector< int > & offsets,
+	int num_vertices,
+	std::vector< char > & shared )
+{
+	std::vector< int > first_cluster( num_vertices, -1 );
+	shared.assign( num_vertices, 0 );
+	for( int c = 0; c + 1 < int( offsets.size() ); ++c ) {
+		for( int i = offsets[c]; i < offsets[c+1]; ++i ) {
+			for( int k = 0; k < 3; ++k ) {
+				const int v = F( faces[i], k );
+				if( first_cluster[v] == -1 ) first_cluster[v] = c;
+				else if( first_cluster[v] != c ) shared[v] = 1;
+			}
+		}
+	}
+}
+
+void extract_cluster(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const int * cluster_faces,
+	int num_faces,
+	const std::vector< char > & shared,
+	MeshCluster & cluster )
+{
+	compact_indices( F, cluster_faces, num_faces, cluster.F, cluster.vertices );
+	compact_indices( FT, cluster_faces, num_faces, cluster.FT, cluster.tcs );
+	cluster.V.resize( cluster.vertices.size(), V.cols() );
+	for( int i = 0; i < cluster.vertices.size(); ++i ) cluster.V.row(i) = V.row( cluster.vertices(i) );
+	cluster.TC.resize( cluster.tcs.size(), TC.cols() );
+	for( int i = 0; i < cluster.tcs.size(); ++i ) cluster.TC.row(i) = TC.row( cluster.tcs(i) );
+	cluster.locked_vertices.clear();
+	for( int i = 0; i < cluster.vertices.size(); ++i ) {
+		if( shared[ cluster.vertices(i) ] ) cluster.locked_vertices.push_back( i );
+	}
+}
+
+bool decimate_cluster(
+	MeshCluster & cluster,
+	double ratio,
+	int seam_aware_degree,
+	bool preserve_boundaries,
+	double pos_scale,
+	double uv_weight,
+	const DecimationOptions & options,
+	double & max_error )
+{
+	max_error = 0.0;
+	const int num_locked = int( cluster.locked_vertices.size() );
+	const int num_unlocked = int( cluster.V.rows() ) - num_locked;
+	const int target_num_vertices = num_locked + int( std::ceil( ratio*num_unlocked ) );
+	if( target_num_vertices <= 0 || target_num_vertices >= cluster.V.rows() ) return true;
+
+	EdgeMap seam_edges;
+	find_seam_edges( cluster.V, cluster.TC, cluster.F, cluster.FT, seam_edges );
+	QuadricStore Vmetrics;
+	half_edge_qslim_5d( cluster.V, cluster.F, cluster.TC, cluster.FT, pos_scale, uv_weight, Vmetrics );
+
+	DecimationOptions cluster_options = options;
+	cluster_options.lod_targets.clear();
+	cluster_options.locked_vertices = cluster.locked_vertices;
+	// A cluster is small enough to stay in cache, and the locked vertices are
+	// matched below in their order.
+	cluster_options.spatial_order = false;
+	MeshCluster decimated;
+	DecimationOrigins origins;
+	const bool success = decimate_halfedge_5d(
+		cluster.V, cluster.F, cluster.TC, cluster.FT, seam_edges, Vmetrics, target_num_vertices, seam_aware_degree,
+		decimated.V, decimated.F, decimated.TC, decimated.FT, preserve_boundaries, pos_scale, uv_weight, max_error,
+		cluster_options, nullptr, nullptr, nullptr, &origins );
+
+	decimated.vertices.resize( origins.vertices.size() );
+	for( int i = 0; i < origins.vertices.size(); ++i ) decimated.vertices(i) = cluster.vertices( origins.vertices(i) );
+	decimated.tcs.resize( origins.tcs.size() );
+	for( int i = 0; i < origins.tcs.size(); ++i ) decimated.tcs(i) = cluster.tcs( origins.tcs(i) );
+	// Locked vertices are never removed, and keep their order.
+	for( int i = 0, j = 0; i < decimated.vertices.size() && j < num_locked; ++i ) {
+		if( origins.vertices(i) == cluster.locked_vertices[j] ) decimated.locked_vertices.push_back( i ), ++j;
+	}
+	assert( int( decimated.locked_vertices.size() ) == num_locked );
+	cluster = std::move( decimated );
+	return success;
+}
+
+void stitch_clusters(
+	const std::vector< MeshCluster > & clusters,
+	int num_vertices,
+	int num_tcs,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out )
+{
+	// The row of V_out and TC_out of each row of the whole mesh, or -1.
+	std::vector< int > vertex_row( num_vertices, -1 );
+	std::vector< int > tc_row( num_tcs, -1 );
+	int nV = 0, nTC = 0, nF = 0;
+	for( const auto & cluster : clusters ) {
+		for( int i = 0; i < cluster.vertices.size(); ++i ) if( vertex_row[ cluster.vertices(i) ] == -1 ) vertex_row[ cluster.vertices(i) ] = nV++;
+		for( int i = 0; i < cluster.tcs.size(); ++i ) if( tc_row[ cluster.tcs(i) ] == -1 ) tc_row[ cluster.tcs(i) ] = nTC++;
+		nF += cluster.F.rows();
+	}
+	const int dim = clusters.empty() ? 3 : int( clusters.front().V.cols() );
+	V_out.resize( nV, dim );
+	TC_out.resize( nTC, 2 );
+	F_out.resize( nF, 3 );
+	FT_out.resize( nF, 3 );
+	int f = 0;
+	for( const auto & cluster : clusters ) {
+		for( int i = 0; i < cluster.vertices.size(); ++i ) V_out.row( vertex_row[ cluster.vertices(i) ] ) = cluster.V.row(i);
+		for( int i = 0; i < cluster.tcs.size(); ++i ) TC_out.row( tc_row[ cluster.tcs(i) ] ) = cluster.TC.row(i);
+		for( int i = 0; i < cluster.F.rows(); ++i, ++f ) {
+			for( int k = 0; k < 3; ++k ) {
+				F_out( f, k ) = vertex_row[ cluster.vertices( cluster.F(i,k) ) ];
+				FT_out( f, k ) = tc_row[ cluster.tcs( cluster.FT(i,k) ) ];
+			}
+		}
+	}
+}
+
+bool decimate_clustered(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	int target_num_vertices,
+	int max_cluster_faces,
+	int seam_aware_degree,
+	bool preserve_boundaries,
+	double pos_scale,
+	double uv_weight,
+	const DecimationOptions & options,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out,
+	double & max_error,
+	ClusteredDecimationStats * stats )
+{
+	assert( options.lod_targets.empty() && options.locked_vertices.empty() && options.max_error == std::numeric_limits< double >::infinity() );
+	std::vector< int > faces, offsets;
+	const int num_clusters = partition_mesh( V, F, max_cluster_faces, faces, offsets );
+	std::vector< char > shared;
+	find_shared_vertices( F, faces, offsets, V.rows(), shared );
+
+	// One cluster per task; each cluster's inner parallel stages run serially.
+	const double ratio = double( target_num_vertices )/V.rows();
+	std::vector< MeshCluster > clusters( num_clusters );
+	std::vector< double > cluster_errors( num_clusters, 0.0 );
+	parallel_for( num_clusters, [&]( const int c )
+	{
+		extract_cluster( V, F, TC, FT, &faces[ offsets[c] ], offsets[c+1] - offsets[c], shared, clusters[c] );
+		// A cluster that stops early just leaves more to the final pass.
+		decimate_cluster( clusters[c], ratio, seam_aware_degree, preserve_boundaries, pos_scale, uv_weight, options, cluster_errors[c] );
+	}, 1 );
+	std::vector< int >().swap( faces );
+	std::vector< char >().swap( shared );
+
+	Eigen::MatrixXd V_stitched, TC_stitched;
+	Eigen::MatrixXi F_stitched, FT_stitched;
+	stitch_clusters( clusters, V.rows(), TC.rows(), V_stitched, F_stitched, TC_stitched, FT_stitched );
+	std::vector< MeshCluster >().swap( clusters );
+
+	max_error = 0.0;
+	for( const double error : cluster_errors ) max_error = std::max( max_error, error );
+	if( stats ) {
+		stats->num_clusters = num_clusters;
+		stats->stitched_vertices = V_stitched.rows();
+	}
+
+	// The final pass, mostly over the cluster boundaries.
+	if( V_stitched.rows() <= target_num_vertices ) {
+		V_out = V_stitched;
+		F_out = F_stitched;
+		TC_out = TC_stitched;
+		FT_out = FT_stitched;
+		return true;
+	}
+	EdgeMap seam_edges;
+	find_seam_edges( V_stitched, TC_stitched, F_stitched, FT_stitched, seam_edges );
+	QuadricStore Vmetrics;
+	half_edge_qslim_5d( V_stitched, F_stitched, TC_stitched, FT_stitched, pos_scale, uv_weight, Vmetrics );
+	double final_error = 0.0;
+	const bool success = decimate_halfedge_5d(
+		V_stitched, F_stitched, TC_stitched, FT_stitched, seam_edges, Vmetrics, target_num_vertices, seam_aware_degree,
+		V_out, F_out, TC_out, FT_out, preserve_boundaries, pos_scale, uv_weight, final_error,
+		options, stats ? &stats->final_pass : nullptr );
+	max_error = std::max( max_error, final_error );
+	return success;
+}
@@ -0,0 +1,129 @@
+#ifndef CLUSTERED_DECIMATE_H
+#define CLUSTERED_DECIMATE_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "decimate.h"
+
+// Decimation of meshes too large for the per-edge state of
+// decimate_halfedge_5d() (edge flaps, quadrics, queue, placements) to fit in
+// memory at once:
+//   1. partition_mesh() splits the faces into spatially compact clusters.
+//   2. extract_cluster() cuts a cluster out as a mesh of its own, whose
+//      vertices shared with other clusters are locked, like seam vertices
+//      that no collapse may touch.
+//   3. decimate_cluster() decimates the inside of a cluster. Clusters don't
+//      depend on each other, so they can be decimated in parallel, or on
+//      other machines.
+//   4. stitch_clusters() joins the decimated clusters back along their
+//      untouched shared vertices.
+// decimate_clustered() does all of that, several clusters at a time, and then
+// decimates the stitched mesh, whose cluster boundaries are still at full
+// resolution, down to the target in a final pass. Only the clusters being
+// decimated and the stitched mesh need the per-edge state.
+
+// Splits the faces of (V,F) into clusters of at most max_cluster_faces faces
+// by halving the longest side of the bounding box of their centroids, at the
+// median, until they are small enough. The faces of cluster c are
+// faces[offsets[c]..offsets[c+1]). Returns the number of clusters.
+int partition_mesh(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	int max_cluster_faces,
+	std::vector< int > & faces,
+	std::vector< int > & offsets );
+
+// Sets shared[v] to 1 for the vertices used by faces of more than one
+// cluster of partition_mesh(), and to 0 for the others.
+void find_shared_vertices(
+	const Eigen::MatrixXi & F,
+	const std::vector< int > & faces,
+	const std::vector< int > & offsets,
+	int num_vertices,
+	std::vector< char > & shared );
+
+// A cluster cut out of a mesh.
+struct MeshCluster
+{
+	Eigen::MatrixXd V, TC;
+	Eigen::MatrixXi F, FT;
+	// The rows of V and TC of the whole mesh each row of V and TC is.
+	Eigen::VectorXi vertices, tcs;
+	// The rows of V shared with other clusters, which stay as they are.
+	std::vector< int > locked_vertices;
+};
+
+// Cuts the faces cluster_faces[0..num_faces) out of (V,F,TC,FT).
+void extract_cluster(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const int * cluster_faces,
+	int num_faces,
+	const std::vector< char > & shared,
+	MeshCluster & cluster );
+
+// Decimates the unlocked vertices of cluster in place, keeping the fraction
+// `ratio` of them, and updates its vertices and tcs. options.locked_vertices
+// is replaced by the locked vertices of the cluster. Returns what
+// decimate_halfedge_5d() returned.
+bool decimate_cluster(
+	MeshCluster & cluster,
+	double ratio,
+	int seam_aware_degree,
+	bool preserve_boundaries,
+	double pos_scale,
+	double uv_weight,
+	const DecimationOptions & options,
+	double & max_error );
+
+// Joins the clusters into one mesh, merging the vertices and texture
+// coordinates that are the same row of the whole mesh, which has
+// num_vertices vertices and num_tcs texture coordinates.
+void stitch_clusters(
+	const std::vector< MeshCluster > & clusters,
+	int num_vertices,
+	int num_tcs,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out );
+
+// What decimate_clustered() did.
+struct ClusteredDecimationStats
+{
+	int num_clusters = 0;
+	// The number of vertices after stitching the decimated clusters.
+	int stitched_vertices = 0;
+	// The final pass over the stitched mesh.
+	DecimationStats final_pass;
+};
+
+// Decimates (V,F,TC,FT) like decimate_halfedge_5d(), cluster by cluster, with
+// clusters of at most max_cluster_faces faces. options.lod_targets,
+// options.locked_vertices and a finite options.max_error aren't supported:
+// the final pass measures its error on the stitched mesh rather than on the
+// input, so it can't bound the error of the whole. Returns whether the target
+// was reached, like decimate_halfedge_5d(). max_error is the larger of the
+// errors of the clusters and of that pass.
+bool decimate_clustered(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	int target_num_vertices,
+	int max_cluster_faces,
+	int seam_aware_degree,
+	bool preserve_boundaries,
+	double pos_scale,
+	double uv_weight,
+	const DecimationOptions & options,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out,
+	double & max_error,
+	ClusteredDecimationStats * stats = nullptr );
+
+#endif
@@ -0,0 +1,60 @@
+## Checks that decimater runs which must write identical meshes do, by the
+## hashes of --hash. Run with cmake -P and
+##   DECIMATER  the decimater executable
+##   INPUT      the mesh to decimate
+##   WORK_DIR   a directory for the outputs
+##   CHECK      replay: the levels of lods match replays of a collapse log
+##              threads: --threads 1 matches --threads THREADS, as is and
+##              with --batch and --lazy
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+## Runs the decimater with the given arguments and appends the hashes it
+## prints, in order, to the list named out.
+function(run_hashes out)
+  execute_process(
+    COMMAND "${DECIMATER}" "${INPUT}" ${ARGN} --hash
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "decimater ${ARGN} failed (${result}):\n${output}${errors}")
+  endif()
+  string(REGEX MATCHALL "Mesh hash: [0-9a-f]+" lines "${output}")
+  set(hashes ${${out}})
+  foreach(line ${lines})
+    string(REPLACE "Mesh hash: " "" hash "${line}")
+    list(APPEND hashes ${hash})
+  endforeach()
+  set(${out} ${hashes} PARENT_SCOPE)
+endfunction()
+
+function(expect_equal what expected actual)
+  if(NOT "${expected}" STREQUAL "${actual}")
+    message(FATAL_ERROR "${what}: ${actual} instead of ${expected}")
+  endif()
+  message(STATUS "${what}: ${actual}")
+endfunction()
+
+if(CHECK STREQUAL "replay")
+  set(lods)
+  run_hashes(lods lods 5000,2000 "${WORK_DIR}/lod.obj")
+  list(LENGTH lods num_lods)
+  expect_equal("levels written" 2 ${num_lods})
+  run_hashes(ignored num-vertices 2000 "${WORK_DIR}/logged.obj" --collapse-log "${WORK_DIR}/collapses.log")
+  set(replays)
+  run_hashes(replays replay 5000 "${WORK_DIR}/replay-5000.obj" --collapse-log "${WORK_DIR}/collapses.log")
+  run_hashes(replays replay 2000 "${WORK_DIR}/replay-2000.obj" --collapse-log "${WORK_DIR}/collapses.log")
+  expect_equal("replays of the lods" "${lods}" "${replays}")
+elseif(CHECK STREQUAL "threads")
+  foreach(options "" "--batch;64" "--lazy")
+    set(serial)
+    run_hashes(serial percent-vertices 10 "${WORK_DIR}/serial.obj" --threads 1 ${options})
+    set(parallel)
+    run_hashes(parallel percent-vertices 10 "${WORK_DIR}/parallel.obj" --threads ${THREADS} ${options})
+    string(REPLACE ";" " " described "--threads ${THREADS} ${options}")
+    expect_equal("${described}" "${serial}" "${parallel}")
+  endforeach()
+else()
+  message(FATAL_ERROR "Unknown CHECK: ${CHECK}")
+endif()
@@ -1,59 +1,76 @@
-#include <igl/circulation.h>
-#include <igl/edge_collapse_is_valid.h>
 #include "collapse_edge_seam.h"
 #include "decimate.h"
 #include "neighbor_faces_and_boundary.h"
 #include "detect_foldover.h"
 #include "cost_and_placement.h"
+#include "parallel_for.h"
+#include "placement_solver.h"
+#include "instrumentation.h"
+#include "trace_events.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 
-bool try_collapse_5d_Edge(
+void CollapseInfo::clear()
+{
+	e = s = d = -1;
+	eflip = 0;
+	collapse_on_seam = d_on_seam = false;
+	s_tc = d_tc = -1;
+	bundle.clear();
+	nV2Fd.clear();
+	nV2Fs.clear();
+	e1 = e2 = -1;
+	kept_edges[0] = kept_edges[1] = -1;
+	renamed_edges.clear();
+	removed_faces[0] = removed_faces[1] = -1;
+	placed_tcs.clear();
+	tc_remaps.clear();
+}
+
+bool check_collapse_5d_edge(
 	const int e,
-    const placement_info_5d & new_placement, // vertex position, texture coordinate, metric
-    Eigen::MatrixXd & V,
-    Eigen::MatrixXi & F,
-    Eigen::MatrixXi & E,
-  	Eigen::VectorXi & EMAP,
-  	Eigen::MatrixXi & EF,
-  	Eigen::MatrixXi & EI,
-    Eigen::MatrixXd & TC, // TODO: Texture coordinates
-    Eigen::MatrixXi & FT, // TODO: Texture coordinates per face.
-    Eigen::MatrixXd & V_scaled,
-    Eigen::MatrixXd & TC_scaled,
-    EdgeMap & seam_edges, // TODO: A set of edges in V for vertices which lie on edges which should be preserved.
-    MapV5d & Vmetrics, // TODO: The per-vertex data.
-    int & a_e1,
-    int & a_e2,
+    const placement_info_5d & new_placement,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXi & E,
+    const Eigen::VectorXi & EMAP,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXd & TC,
+    const Eigen::MatrixXi & FT,
+    const SeamFlags & seams,
     bool preserve_boundaries,
-    double pos_scale,
-    double uv_weight)
+    CollapseInfo & info,
+    const FaceUVOrientations * orientations)
 {
-// Assign this to 0 rather than, say, -1 so that deleted elements will get
-	// draw as degenerate elements at vertex 0 (which should always exist and
-	// never get collapsed to anything else since it is the smallest index)
 	using namespace Eigen;
 	using namespace std;
 
-	// Helper function to replace edge and associate information with NULL
-	const auto & kill_edge = [&E,&EI,&EF](const int e)
-	{
-		E(e,0) = DUV_COLLAPSE_EDGE_NULL;
-		E(e,1) = DUV_COLLAPSE_EDGE_NULL;
-		EF(e,0) = DUV_COLLAPSE_EDGE_NULL;
-		EF(e,1) = DUV_COLLAPSE_EDGE_NULL;
-		EI(e,0) = DUV_COLLAPSE_EDGE_NULL;
-		EI(e,1) = DUV_COLLAPSE_EDGE_NULL;
-	};
-
 	const int eflip = E(e,0)>E(e,1);
 	// source and destination
 	const int s = eflip?E(e,1):E(e,0);
 	const int d = eflip?E(e,0):E(e,1);
-	const bool collapse_on_seam = contains_edge( seam_edges, s, d );
+	const bool collapse_on_seam = seams.is_seam_edge( e );
+	DECIMATE_COUNT( COLLAPSE_ATTEMPTS );
+
+	info.clear();
+	const std::vector<int> & nV2Fd = info.nV2Fd;
+	const std::vector<int> & nV2Fs = info.nV2Fs;
+	{
+		DECIMATE_TRACE_SCOPE( circulation_trace, "circulation" );
+		// Important to grab neighbors of d before monkeying with edges
+		circulation_faces(e,!eflip,EMAP,EF,EI,info.nV2Fd);
+		// We need the neighbors of s in case d is a seam "corner".
+		circulation_faces(e, eflip,EMAP,EF,EI,info.nV2Fs);
+		DECIMATE_TRACE_EDGE( circulation_trace, e, int( nV2Fd.size() + nV2Fs.size() ), collapse_on_seam );
+	}
 
 	// If this edge is a boundary edge and we want to preserve them, don't collapse.
 	if( preserve_boundaries && collapse_on_seam) {
-		const auto& faces = igl::circulation(e, true, EMAP, EF, EI);
-		if (faces.size() < 2) return false; // Should not happen on a closed mesh.
+		if (nV2Fd.size() < 2) { // Should not happen on a closed mesh.
+			DECIMATE_COUNT( REJECTED_BOUNDARY );
+			return false;
+		}
 		// A boundary edge will have one half-edge that has different UVs than the other.
 		// However, a simpler check is to see if one of the faces is an "infinity" face.
 		// We can't know the infinity vertex index here easily without more plumbing.
@@ -67,6 +84,7 @@ bool try_collapse_5d_Edge(
 		Bundle bundle = get_half_edge_bundle( e, E, EF, EI, F, FT );
 		if (bundle.size() < 2) {
 			// This is a boundary edge for sure.
+			DECIMATE_COUNT( REJECTED_BOUNDARY );
 			return false;
 		}
 
@@ -75,6 +93,7 @@ bool try_collapse_5d_Edge(
 			if((bundle[1].p[0].vi == s && bundle[0].p[0].tci == bundle[1].p[0].tci && bundle[0].p[1].tci == bundle[1].p[1].tci) ||
 			   (bundle[1].p[0].vi == d && bundle[0].p[0].tci == bundle[1].p[1].tci && bundle[0].p[1].tci == bundle[1].p[0].tci))
 			{
+				DECIMATE_COUNT( REJECTED_BOUNDARY );
 				return false;
 			}
 		} else {
@@ -82,27 +101,33 @@ bool try_collapse_5d_Edge(
 			if((bundle[1].p[0].vi == d && bundle[0].p[0].tci == bundle[1].p[0].tci && bundle[0].p[1].tci == bundle[1].p[1].tci) ||
 			   (bundle[1].p[0].vi == s && bundle[0].p[0].tci == bundle[1].p[1].tci && bundle[0].p[1].tci == bundle[1].p[0].tci))
 			{
+				DECIMATE_COUNT( REJECTED_BOUNDARY );
 				return false;
 			}
 		}
 	}
 
 	// If both endpoints are on seams, but there is no seam between them, reject it.
-	if( seam_edges.count( s ) && seam_edges.count( d ) && !collapse_on_seam ) {
+	if( seams.is_seam_vertex( s ) && seams.is_seam_vertex( d ) && !collapse_on_seam ) {
+	    DECIMATE_COUNT( REJECTED_SEAM_CORNER );
 	    return false;
 	}
 
 	// Link condition
-	if(!igl::edge_collapse_is_valid(e,F,E,EMAP,EF,EI) )
+	bool link_condition = false;
 	{
+		DECIMATE_TRACE_SCOPE( link_trace, "edge_collapse_is_valid" );
+		DECIMATE_TRACE_EDGE( link_trace, e, int( nV2Fd.size() + nV2Fs.size() ), collapse_on_seam );
+		link_condition = edge_collapse_is_valid(F,nV2Fs,nV2Fd,info.link_s,info.link_d);
+	}
+	if( !link_condition )
+	{
+		DECIMATE_COUNT( REJECTED_LINK_CONDITION );
 		return false;
 	}
-	// Important to grab neighbors of d before monkeying with edges
-	const std::vector<int> nV2Fd = igl::circulation(e,!eflip,EMAP,EF,EI);
-	// We need the neighbors of s in case d is a seam "corner".
-	const std::vector<int> nV2Fs = igl::circulation(e, eflip,EMAP,EF,EI);
 
-	Bundle bundle = get_half_edge_bundle( e, E, EF, EI, F, FT );
+	info.bundle = get_half_edge_bundle( e, E, EF, EI, F, FT );
+	const Bundle & bundle = info.bundle;
     assert( bundle.size() == 2 );
 
 	// 	sGet s_tc and d_tc by looking at F via EF/EI.
@@ -120,15 +145,24 @@ bool try_collapse_5d_Edge(
 	// test fold-over
 	const bool disable_boundary_foldover = true;
 	if( disable_boundary_foldover && !collapse_on_seam ) {
+		// The orientation of a face tells which side of the edge opposite d or
+		// s the corner at d or s is on; the new texture coordinate must be on
+		// the same side.
+		const auto & face_orientation = [&]( const int f )
+		{
+			if( !orientations || !orientations->enabled ) return face_uv_orientation( TC, FT, f );
+			assert( std::isnan( orientations->values[f] ) || orientations->values[f] == face_uv_orientation( TC, FT, f ) );
+			return orientations->values[f];
+		};
 		for(int i=1; i<nV2Fd.size()-1; i++) {
 			const int f = nV2Fd[i];
 			for(int v=0; v<3; v++) {
 				if( F(f,v) == d ) {
-					RowVectorXd uv = TC.row(FT(f,v));
-					RowVectorXd uv1 = TC.row(FT(f,(v+1)%3));
-					RowVectorXd uv2 = TC.row(FT(f,(v+2)%3));
-					if( !two_points_on_same_side( uv1, uv2, uv, new_placement.tcs[0] ) /*&&
+					const RowVector2d uv1 = TC.row(FT(f,(v+1)%3));
+					const RowVector2d uv2 = TC.row(FT(f,(v+2)%3));
+					if( !on_same_side_as_corner( face_orientation( f ), uv1, uv2, new_placement.tcs[0] ) /*&&
 						 contains_edge( seam_edges, F(f,(v+1)%3), F(f,(v+2)%3) )*/) {
+						 DECIMATE_COUNT( REJECTED_FOLDOVER );
 						 return false;
 					}
 				}
@@ -138,11 +172,11 @@ bool try_collapse_5d_Edge(
 			const int f = nV2Fs[i];
 			for(int v=0; v<3; v++) {
 				if( F(f,v) == s ) {
-					RowVectorXd uv = TC.row(FT(f,v));
-					RowVectorXd uv1 = TC.row(FT(f,(v+1)%3));
-					RowVectorXd uv2 = TC.row(FT(f,(v+2)%3));
-					if( !two_points_on_same_side( uv1, uv2, uv, new_placement.tcs[0] ) /*&&
+					const RowVector2d uv1 = TC.row(FT(f,(v+1)%3));
+					const RowVector2d uv2 = TC.row(FT(f,(v+2)%3));
+					if( !on_same_side_as_corner( face_orientation( f ), uv1, uv2, new_placement.tcs[0] ) /*&&
 						 contains_edge( seam_edges, F(f,(v+1)%3), F(f,(v+2)%3) )*/) {
+						 DECIMATE_COUNT( REJECTED_FOLDOVER );
 						 return false;
 					}
 				}
@@ -152,62 +186,87 @@ bool try_collapse_5d_Edge(
 
 	// The following implementation strongly relies on s<d
 	assert(s<d && "s should be less than d");
+	info.e = e;
+	info.s = s;
+	info.d = d;
+	info.eflip = eflip;
+	info.collapse_on_seam = collapse_on_seam;
+	info.d_on_seam = seams.is_seam_vertex( d );
+	info.s_tc = s_tc;
+	info.d_tc = d_tc;
+	return true;
+}
+
+void collapse_connectivity_5d_edge(
+    CollapseInfo & info,
+    const placement_info_5d & new_placement,
+    Eigen::MatrixXd & V,
+    Eigen::MatrixXi & F,
+    Eigen::MatrixXi & E,
+    Eigen::VectorXi & EMAP,
+    Eigen::MatrixXi & EF,
+    Eigen::MatrixXi & EI,
+    Eigen::MatrixXd & TC,
+    Eigen::MatrixXi & FT,
+    FaceUVOrientations * orientations)
+{
+	using namespace Eigen;
+	using namespace std;
+	DECIMATE_COUNT( COLLAPSES );
+
+	// Helper function to replace edge and associate information with NULL
+	const auto & kill_edge = [&E,&EI,&EF](const int e)
+	{
+		E(e,0) = DUV_COLLAPSE_EDGE_NULL;
+		E(e,1) = DUV_COLLAPSE_EDGE_NULL;
+		EF(e,0) = DUV_COLLAPSE_EDGE_NULL;
+		EF(e,1) = DUV_COLLAPSE_EDGE_NULL;
+		EI(e,0) = DUV_COLLAPSE_EDGE_NULL;
+		EI(e,1) = DUV_COLLAPSE_EDGE_NULL;
+	};
+
+	const int e = info.e;
+	const int eflip = info.eflip;
+	const int s = info.s;
+	const int d = info.d;
+	const bool collapse_on_seam = info.collapse_on_seam;
+	const int s_tc = info.s_tc;
+	const int d_tc = info.d_tc;
+	const Bundle & bundle = info.bundle;
+	const std::vector<int> & nV2Fd = info.nV2Fd;
+	const std::vector<int> & nV2Fs = info.nV2Fs;
+
 	// Preserve seams.
 	// We can handle the case when (s, d) is a seam edge.
 	if( collapse_on_seam )
 	{
 		assert( new_placement.tcs.size() == 2 );
-		assert( new_placement.metrics.size() == 2 );
 		// move source and destination to midpoint
-		V.row(s) = new_placement.p / pos_scale;
-		V.row(d) = new_placement.p / pos_scale;
-		V_scaled.row(s) = new_placement.p;
-		V_scaled.row(d) = new_placement.p;
+		V.row(s) = new_placement.p;
+		V.row(d) = new_placement.p;
 		// Update UV coordinates of the edge endpoints here. If both edge endpoints are on the seam, return false (see above). If one of the edge endpoints is on the seam, we should be able to handle it preserving that endpoint and collapsing the other one.
 		int he0_ts = bundle[0].p[0].tci;
 		int he0_td = bundle[0].p[1].tci;
         if( bundle[0].p[0].vi == d ) 	std::swap( he0_ts, he0_td );
-		TC.row(he0_ts) = new_placement.tcs[0] / uv_weight;
-		TC.row(he0_td) = new_placement.tcs[0] / uv_weight;
-		TC_scaled.row(he0_ts) = new_placement.tcs[0];
-		TC_scaled.row(he0_td) = new_placement.tcs[0];
+		TC.row(he0_ts) = new_placement.tcs[0];
+		TC.row(he0_td) = new_placement.tcs[0];
 		int he1_ts = bundle[1].p[0].tci;
 		int he1_td = bundle[1].p[1].tci;
         if( bundle[1].p[0].vi == d ) 	std::swap( he1_ts, he1_td );
-		TC.row(he1_ts) = new_placement.tcs[1] / uv_weight;
-		TC.row(he1_td) = new_placement.tcs[1] / uv_weight;
-		TC_scaled.row(he1_ts) = new_placement.tcs[1];
-		TC_scaled.row(he1_td) = new_placement.tcs[1];
-		// Update the per-vertex metric.
-        // Move the other d metrics to s.
-		Vmetrics[d].erase(he0_td);
-		Vmetrics[d].erase(he1_td);
-		Vmetrics[s].insert(Vmetrics[d].begin(), Vmetrics[d].end());
-		Vmetrics.erase(d);
-		Vmetrics[s][he0_ts] = new_placement.metrics[0];
-		Vmetrics[s][he1_ts] = new_placement.metrics[1];
+		TC.row(he1_ts) = new_placement.tcs[1];
+		TC.row(he1_td) = new_placement.tcs[1];
+		info.placed_tcs.push_back( he0_ts );
+		info.placed_tcs.push_back( he1_ts );
 	}
 	else {
 		assert( new_placement.tcs.size() == 1 );
-		assert( new_placement.metrics.size() == 1 );
 		// move source and destination to midpoint
-		V.row(s) = new_placement.p / pos_scale;
-		V.row(d) = new_placement.p / pos_scale;
-		V_scaled.row(s) = new_placement.p;
-		V_scaled.row(d) = new_placement.p;
+		V.row(s) = new_placement.p;
+		V.row(d) = new_placement.p;
 		// Update UV coordinates of the edge endpoints here. If both edge endpoints are on the seam, return false (see above). If one of the edge endpoints is on the seam, we should be able to handle it preserving that endpoint and collapsing the other one.
-		TC.row(s_tc) = new_placement.tcs[0] / uv_weight;
-		TC.row(d_tc) = new_placement.tcs[0] / uv_weight;
-		TC_scaled.row(s_tc) = new_placement.tcs[0];
-		TC_scaled.row(d_tc) = new_placement.tcs[0];
-		// Update the per-vertex metric.
-		// Move the other d metrics to s.
-		assert(bundle[0].p[0] == bundle[1].p[0] || bundle[0].p[0] == bundle[1].p[1]);
-		assert(bundle[0].p[1] == bundle[1].p[0] || bundle[0].p[1] == bundle[1].p[1]);
-		Vmetrics[d].erase(d_tc);
-		Vmetrics[s].insert(Vmetrics[d].begin(), Vmetrics[d].end());
-		Vmetrics.erase(d);
-		Vmetrics[s][s_tc] = new_placement.metrics[0];
+		TC.row(s_tc) = new_placement.tcs[0];
+		TC.row(d_tc) = new_placement.tcs[0];
+		info.placed_tcs.push_back( s_tc );
 	}
 
 	// finally, reindex faces and edges incident on d. Do this last so asserts
@@ -254,6 +313,7 @@ bool try_collapse_5d_Edge(
 		d_pair[side] = bundle[side].p[1-e_vi];
 		// Kill e1
 		kill_edge(e1);
+		info.removed_faces[side] = f;
 		// Kill f
 		F(f,0) = DUV_COLLAPSE_EDGE_NULL;
 		F(f,1) = DUV_COLLAPSE_EDGE_NULL;
@@ -273,8 +333,9 @@ bool try_collapse_5d_Edge(
 		// remap e2 from d to s
 		E(e2,0) = E(e2,0)==d ? s : E(e2,0);
 		E(e2,1) = E(e2,1)==d ? s : E(e2,1);
-		if(side==0)	a_e1 = e1;
-		else		a_e2 = e1;
+		if(side==0)	info.e1 = e1;
+		else		info.e2 = e1;
+		info.kept_edges[side] = e2;
 	}
 
 	// Loop over face neighborhood of d.
@@ -295,6 +356,8 @@ bool try_collapse_5d_Edge(
 				assert(E(EMAP(f+m*((v+2)%3)),flip2) == d
 					|| E(EMAP(f+m*((v+2)%3)),flip2) == s);
 				E(EMAP(f+m*((v+2)%3)),flip2) = s;
+				info.renamed_edges.push_back( EMAP(f+m*((v+1)%3)) );
+				info.renamed_edges.push_back( EMAP(f+m*((v+2)%3)) );
 				F(f,v) = s;
 				// Update FT to point to the other endpoint.
 				// If d is on the seam, some F neighbors won't be FT neighbors. Only update FT entries
@@ -313,7 +376,7 @@ bool try_collapse_5d_Edge(
                 //         FTC is also augmented with a vertex to infinity.
                 // if( f < FT.rows() )
                 {
-                    assert( seam_edges.count(d) or FT(f,v) == d_tc );
+                    assert( info.d_on_seam or FT(f,v) == d_tc );
                     if( !collapse_on_seam ) {
                         if( FT(f,v) == d_tc ) FT(f,v) = s_tc;
                     }
@@ -326,9 +389,27 @@ bool try_collapse_5d_Edge(
 		}
 	}
 
+	// Each renamed edge was seen from both of its faces, and the faces across
+	// e1 and e2 also saw the kept edges.
+	std::vector<int> & renamed = info.renamed_edges;
+	std::sort( renamed.begin(), renamed.end() );
+	renamed.erase( std::unique( renamed.begin(), renamed.end() ), renamed.end() );
+	for( int side = 0; side < 2; ++side ) {
+		renamed.erase( std::remove( renamed.begin(), renamed.end(), info.kept_edges[side] ), renamed.end() );
+	}
+
+	if( !collapse_on_seam ) {
+		info.tc_remaps.push_back( std::make_pair( d_tc, s_tc ) );
+	}
+	else {
+		info.tc_remaps.push_back( std::make_pair( d_pair[0].tci, s_pair[0].tci ) );
+		if( d_pair[1].tci != d_pair[0].tci ) info.tc_remaps.push_back( std::make_pair( d_pair[1].tci, s_pair[1].tci ) );
+	}
+
 	// Check for seam corners.
 	const bool seam_corner = d_pair[0].tci == d_pair[1].tci;
 	if( collapse_on_seam && seam_corner ) {
+		info.tc_remaps.push_back( std::make_pair( s_pair[1].tci, s_pair[0].tci ) );
 		for(int i=1; i<nV2Fs.size()-1; i++)
 		{
 			const int f = nV2Fs[i];
@@ -339,20 +420,266 @@ bool try_collapse_5d_Edge(
 		}
 	}
 
-	// If 's' was a seam vertex and 'd' wasn't, we don't need to do anything. d was removed.
-	// If 'd' was a seam vertex and 's' wasn't, we need to rename 'd' to 's'.
-	if( seam_edges.count(d) && !seam_edges.count(s) ) rename_vertex( seam_edges, d, s );
-	// If 's' and 'd' were both seam vertices but (s,d) is not a seam edge, we have a problem.
-	assert( !( seam_edges.count(d) && seam_edges.count(s) && !contains_edge( seam_edges, d, s ) ) );
-	// If (s,d) is a seam_edge, collapse it 'd' to 's'.
-	if( contains_edge( seam_edges, d, s ) ) 		::collapse_edge( seam_edges, d, s );
-
 	// Finally, "remove" this edge and its information
 	kill_edge(e);
 
+	if( orientations && orientations->enabled ) {
+		orientations->update( TC, FT, nV2Fd.data(), int( nV2Fd.size() ) );
+		orientations->update( TC, FT, nV2Fs.data(), int( nV2Fs.size() ) );
+	}
+}
+
+void collapse_metrics_and_seams_5d_edge(
+    const CollapseInfo & info,
+    const Eigen::MatrixXi & E,
+    SeamFlags & seams,
+    QuadricStore & Vmetrics)
+{
+	const int s = info.s;
+	const int d = info.d;
+	const Bundle & bundle = info.bundle;
+
+	// Update the per-vertex metric.
+	// Move the other d metrics to s.
+	if( info.collapse_on_seam )
+	{
+		int he0_ts = bundle[0].p[0].tci;
+		int he0_td = bundle[0].p[1].tci;
+        if( bundle[0].p[0].vi == d ) 	std::swap( he0_ts, he0_td );
+		int he1_ts = bundle[1].p[0].tci;
+		int he1_td = bundle[1].p[1].tci;
+        if( bundle[1].p[0].vi == d ) 	std::swap( he1_ts, he1_td );
+		const Quadric5d q0 = Vmetrics.at(s, he0_ts) + Vmetrics.at(d, he0_td);
+		const Quadric5d q1 = Vmetrics.at(s, he1_ts) + Vmetrics.at(d, he1_td);
+		Quadric8d n0, n1;
+		if( Vmetrics.has_normals() ) {
+			n0 = Vmetrics.normal_quadric(s, he0_ts) + Vmetrics.normal_quadric(d, he0_td);
+			n1 = Vmetrics.normal_quadric(s, he1_ts) + Vmetrics.normal_quadric(d, he1_td);
+		}
+		Vmetrics.erase(d, he0_td);
+		Vmetrics.erase(d, he1_td);
+		Vmetrics.move_wedges(d, s);
+		Vmetrics.set(s, he0_ts, q0);
+		Vmetrics.set(s, he1_ts, q1);
+		if( Vmetrics.has_normals() ) {
+			Vmetrics.set_normal_quadric(s, he0_ts, n0);
+			Vmetrics.set_normal_quadric(s, he1_ts, n1);
+		}
+	}
+	else {
+		assert(bundle[0].p[0] == bundle[1].p[0] || bundle[0].p[0] == bundle[1].p[1]);
+		assert(bundle[0].p[1] == bundle[1].p[0] || bundle[0].p[1] == bundle[1].p[1]);
+		const Quadric5d q = Vmetrics.at(s, info.s_tc) + Vmetrics.at(d, info.d_tc);
+		Quadric8d n;
+		if( Vmetrics.has_normals() ) n = Vmetrics.normal_quadric(s, info.s_tc) + Vmetrics.normal_quadric(d, info.d_tc);
+		Vmetrics.erase(d, info.d_tc);
+		Vmetrics.move_wedges(d, s);
+		Vmetrics.set(s, info.s_tc, q);
+		if( Vmetrics.has_normals() ) Vmetrics.set_normal_quadric(s, info.s_tc, n);
+	}
+
+	// If 's' and 'd' were both seam vertices but (s,d) is not a seam edge, we have a problem.
+	assert( !( seams.is_seam_vertex(d) && seams.is_seam_vertex(s) && !info.collapse_on_seam ) );
+	// The seam edges of 'd' become seam edges of 's'.
+	const int removed_edges[2] = { info.e1, info.e2 };
+	seams.collapse_edge( info.e, s, d, removed_edges, info.kept_edges, info.renamed_edges, E );
+}
+
+bool try_collapse_5d_Edge(
+	const int e,
+    const placement_info_5d & new_placement, // vertex position, texture coordinate, metric
+    Eigen::MatrixXd & V,
+    Eigen::MatrixXi & F,
+    Eigen::MatrixXi & E,
+  	Eigen::VectorXi & EMAP,
+  	Eigen::MatrixXi & EF,
+  	Eigen::MatrixXi & EI,
+    Eigen::MatrixXd & TC, // TODO: Texture coordinates
+    Eigen::MatrixXi & FT, // TODO: Texture coordinates per face.
+    SeamFlags & seams, // The edges of E which should be preserved.
+    QuadricStore & Vmetrics, // TODO: The per-vertex data.
+    int & a_e1,
+    int & a_e2,
+    bool preserve_boundaries)
+{
+	DECIMATE_TRACE_SCOPE( trace, "try_collapse_5d_Edge" );
+	CollapseInfo info;
+	const bool valid = check_collapse_5d_edge(e,new_placement,F,E,EMAP,EF,EI,TC,FT,seams,preserve_boundaries,info);
+	DECIMATE_TRACE_EDGE( trace, e, int( info.nV2Fd.size() + info.nV2Fs.size() ), seams.is_seam_edge( e ) );
+	if( !valid ) return false;
+	collapse_connectivity_5d_edge(info,new_placement,V,F,E,EMAP,EF,EI,TC,FT);
+	collapse_metrics_and_seams_5d_edge(info,E,seams,Vmetrics);
+	a_e1 = info.e1;
+	a_e2 = info.e2;
 	return true;
 }
 
+namespace
+{
+	// Number of edges update_edge_costs() hands to one thread.
+	enum { PARALLEL_UPDATE_BLOCK = 4*PLACEMENT_BATCH_SIZE };
+}
+
+void update_edge_costs(
+    const int * edges,
+    const int n,
+    const Eigen::MatrixXi & E,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXd & V,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXd & TC,
+    const Eigen::MatrixXi & FT,
+    const SeamFlags & seams,
+    const QuadricStore & Vmetrics,
+    int seam_aware_degree,
+    double pos_scale,
+    double uv_weight,
+    PriorityQueue & Q,
+    std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
+    DecimationWorkspace & workspace)
+{
+	DECIMATE_TRACE_SCOPE( trace, "update_edge_costs" );
+	DECIMATE_TRACE_COUNT( trace, n );
+	if( n == 1 ) DECIMATE_TRACE_EDGE( trace, edges[0], -1, seams.is_seam_edge( edges[0] ) );
+	std::vector< double > & costs = workspace.costs;
+	std::vector< placement_info_5d > & places = workspace.placements;
+	if( int( costs.size() ) < n ) {
+		costs.resize( n );
+		places.resize( n );
+	}
+	// compute cost and potential placement
+	if( n <= PARALLEL_UPDATE_BLOCK )
+	{
+		cost_and_placement_qslim5d_halfedge_batch(edges,n,E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,costs.data(),places.data());
+	}
+	else
+	{
+		// Only batch collapses update this many edges at once.
+		const int num_blocks = ( n + PARALLEL_UPDATE_BLOCK - 1 ) / PARALLEL_UPDATE_BLOCK;
+		parallel_for( num_blocks, [&]( const int block )
+		{
+			const int first = block * PARALLEL_UPDATE_BLOCK;
+			const int m = std::min( int( PARALLEL_UPDATE_BLOCK ), n - first );
+			cost_and_placement_qslim5d_halfedge_batch(edges+first,m,E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,&costs[first],&places[first]);
+		}, 1 );
+	}
+	for( int i = 0; i < n; ++i )
+	{
+		const int ei = edges[i];
+		// Replace in queue
+		Q.update(ei,costs[i]);
+		C.at(ei) = places[i];
+		if( lazy.enabled ) lazy.evaluated[ei] = lazy.version[ei];
+	}
+	lazy.evaluations += n;
+}
+
+void refresh_queue_top(
+    const Eigen::MatrixXi & E,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXd & V,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXd & TC,
+    const Eigen::MatrixXi & FT,
+    const SeamFlags & seams,
+    const QuadricStore & Vmetrics,
+    int seam_aware_degree,
+    double pos_scale,
+    double uv_weight,
+    PriorityQueue & Q,
+    std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
+    DecimationWorkspace & workspace)
+{
+	while( !Q.empty() && lazy.is_stale( Q.top().second ) )
+	{
+		const int e = Q.top().second;
+		update_edge_costs(&e,1,E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
+	}
+}
+
+namespace
+{
+	// Appends the edges of the faces [first,last) that have not been
+	// collapsed to edges.
+	template< typename FaceIt >
+	void append_live_edges(
+		FaceIt first,
+		FaceIt last,
+		const Eigen::MatrixXi & F,
+		const Eigen::MatrixXi & E,
+		const Eigen::VectorXi & EMAP,
+		std::vector< int > & edges )
+	{
+		for( ; first != last; ++first )
+		{
+			const int n = *first;
+			if(F(n,0) != DUV_COLLAPSE_EDGE_NULL &&
+			   F(n,1) != DUV_COLLAPSE_EDGE_NULL &&
+			   F(n,2) != DUV_COLLAPSE_EDGE_NULL)
+			{
+				for(int v = 0;v<3;v++)
+				{
+					// get edge id
+					const int ei = EMAP(v*F.rows()+n);
+					if( E(ei,0) != DUV_COLLAPSE_EDGE_NULL && E(ei,1) != DUV_COLLAPSE_EDGE_NULL )
+					{
+						edges.push_back( ei );
+					}
+				}
+			}
+		}
+	}
+
+	// Updates the edges around collapses, which may contain duplicates:
+	// recomputes them, or with lazy updates marks them stale.
+	void update_affected_edges(
+		std::vector< int > & affected_edges,
+		const Eigen::MatrixXi & E,
+		const Eigen::MatrixXi & EF,
+		const Eigen::MatrixXi & EI,
+		const Eigen::MatrixXd & V,
+		const Eigen::MatrixXi & F,
+		const Eigen::MatrixXd & TC,
+		const Eigen::MatrixXi & FT,
+		const SeamFlags & seams,
+		const QuadricStore & Vmetrics,
+		int seam_aware_degree,
+		double pos_scale,
+		double uv_weight,
+		PriorityQueue & Q,
+		std::vector< placement_info_5d > & C,
+		LazyEdgeUpdates & lazy,
+		DecimationWorkspace & workspace )
+	{
+		// Because faces share edges, every affected edge appears twice.
+		// Remove the duplicates, then update all of them at once.
+		std::sort( affected_edges.begin(), affected_edges.end() );
+		affected_edges.erase( std::unique( affected_edges.begin(), affected_edges.end() ), affected_edges.end() );
+
+		if( lazy.enabled )
+		{
+			// Only mark the edges stale. Edges with infinite cost would never
+			// reach the top of the queue again, so those are recomputed now.
+			int num_now = 0;
+			for( auto ei : affected_edges )
+			{
+				++lazy.version[ei];
+				++lazy.deferred;
+				if( !Q.contains(ei) || Q.cost(ei) == std::numeric_limits<double>::infinity() )
+				{
+					affected_edges[num_now++] = ei;
+				}
+			}
+			affected_edges.resize( num_now );
+		}
+		update_edge_costs(affected_edges.data(),int( affected_edges.size() ),E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
+	}
+}
+
 bool collapse_edge_with_uv(
     Eigen::MatrixXd & V,
     Eigen::MatrixXi & F,
@@ -362,98 +689,241 @@ bool collapse_edge_with_uv(
     Eigen::MatrixXi & EI,
     Eigen::MatrixXd & TC, //  Texture coordinates
     Eigen::MatrixXi & FT, //  Texture coordinates per face.
-    EdgeMap & seam_edges, //  A set of indices into V or TC for vertices which lie on edges which should be preserved.
-    MapV5d & Vmetrics, //  The per-vertex data.
+    SeamFlags & seams, // The edges of E which should be preserved.
+    QuadricStore & Vmetrics, //  The per-vertex data.
     int seam_aware_degree,
-    std::set<std::pair<double,int> > & Q,
-    std::vector<std::set<std::pair<double,int> >::iterator > & Qit,
+    PriorityQueue & Q,
     std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
     int & e,
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
-    Eigen::MatrixXd & V_scaled,
-    Eigen::MatrixXd & TC_scaled)
+    double cost_limit,
+    DecimationWorkspace & workspace,
+    CollapseLog * log)
 {
   	using namespace std;
   	using namespace Eigen;
-  	using namespace igl;
+	DECIMATE_TRACE_SCOPE( trace, "collapse_edge_with_uv" );
+	refresh_queue_top(E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
 	if(Q.empty())
 	{
 		// no edges to collapse
 		return false;
 	}
-  	std::pair<double,int> p = *(Q.begin());
-  	if(p.first == std::numeric_limits<double>::infinity())
+  	std::pair<double,int> p = Q.top();
+  	if(p.first == std::numeric_limits<double>::infinity() || p.first > cost_limit)
   	{
     	// min cost edge is infinite cost
     	return false;
 	}
-	Q.erase(Q.begin());
+	Q.pop();
 	e = p.second;
-	Qit[e] = Q.end();
-
-	// Get the one-ring of faces as N.
-	std::unordered_set<int> N;
-	std::vector<int> Ne = circulation(e, true,EMAP,EF,EI);
-	N.insert( Ne.begin(), Ne.end() );
-	Ne = circulation(e,false,EMAP,EF,EI);
-	N.insert( Ne.begin(), Ne.end() );
-
-	int e1,e2;
-	const bool collapsed =
-    	try_collapse_5d_Edge(e,C.at(e),V,F,E,EMAP,EF,EI,TC,FT,V_scaled, TC_scaled,seam_edges,Vmetrics,e1,e2, preserve_boundaries, pos_scale, uv_weight);
+
+	CollapseInfo & info = workspace.info;
+	const bool collapsed = check_collapse_5d_edge(e,C.at(e),F,E,EMAP,EF,EI,TC,FT,seams,preserve_boundaries,info,&workspace.uv_orientations);
+	DECIMATE_TRACE_EDGE( trace, e, int( info.nV2Fd.size() + info.nV2Fs.size() ), seams.is_seam_edge( e ) );
 	if(collapsed)
 	{
+		collapse_connectivity_5d_edge(info,C.at(e),V,F,E,EMAP,EF,EI,TC,FT,&workspace.uv_orientations);
+		collapse_metrics_and_seams_5d_edge(info,E,seams,Vmetrics);
+		if( log ) log->records.push_back( make_collapse_record( info, V, TC, pos_scale, uv_weight, std::sqrt( std::max( 0.0, p.first ) ) / pos_scale ) );
 		// Erase the two, other collapsed edges
-		Q.erase(Qit[e1]);
-		Qit[e1] = Q.end();
-		Q.erase(Qit[e2]);
-		Qit[e2] = Q.end();
-		// update local neighbors
-		// loop over original face neighbors
-		std::unordered_set< int > affected_edges;
-		for(auto n : N)
+		Q.erase(info.e1);
+		Q.erase(info.e2);
+		// update local neighbors, the faces around d and s
+		std::vector< int > & affected_edges = workspace.affected_edges;
+		affected_edges.clear();
+		append_live_edges(info.nV2Fd.begin(),info.nV2Fd.end(),F,E,EMAP,affected_edges);
+		append_live_edges(info.nV2Fs.begin(),info.nV2Fs.end(),F,E,EMAP,affected_edges);
+		update_affected_edges(affected_edges,E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
+	} else
+	{
+		// reinsert with infinite weight (the provided cost function must **not**
+		// have given this un-collapsable edge inf cost already)
+		Q.update(e,std::numeric_limits<double>::infinity());
+	}
+	return collapsed;
+}
+
+namespace
+{
+	// Marks the vertices and texture coordinates of the faces around edge e as
+	// claimed by this round. Returns false, claiming nothing, if one of them
+	// already is. The vertex and texture coordinate at infinity are shared by
+	// all the faces connected to them and are left out; -1 if there are none.
+	bool claim_one_ring(
+		const int e,
+		const Eigen::MatrixXi & F,
+		const Eigen::VectorXi & EMAP,
+		const Eigen::MatrixXi & EF,
+		const Eigen::MatrixXi & EI,
+		const Eigen::MatrixXi & FT,
+		const int infinity_vertex,
+		const int infinity_tc,
+		IndependentSetState & state,
+		std::vector< int > & faces,
+		std::vector< int > & other_side )
+	{
+		circulation_faces(e,true,EMAP,EF,EI,faces);
+		circulation_faces(e,false,EMAP,EF,EI,other_side);
+		faces.insert( faces.end(), other_side.begin(), other_side.end() );
+
+		for( int pass = 0; pass < 2; ++pass )
 		{
-			if(F(n,0) != DUV_COLLAPSE_EDGE_NULL &&
-			   F(n,1) != DUV_COLLAPSE_EDGE_NULL &&
-			   F(n,2) != DUV_COLLAPSE_EDGE_NULL)
+			for( auto f : faces )
 			{
-				for(int v = 0;v<3;v++)
+				for( int k = 0; k < 3; ++k )
 				{
-					// get edge id
-					const int ei = EMAP(v*F.rows()+n);
-					// Because faces share edges, recomputing here would recompute
-					// every affected edge twice. Instead, build a set< int > of edge
-					// indices, and iterate over it once.
-					affected_edges.insert( ei );
+					const int v = F(f,k);
+					const int tc = FT(f,k);
+					if( pass == 0 )
+					{
+						if( v != infinity_vertex && state.vertex_round[v] == state.round ) return false;
+						if( tc != infinity_tc && state.tc_round[tc] == state.round ) return false;
+					}
+					else
+					{
+						if( v != infinity_vertex ) state.vertex_round[v] = state.round;
+						if( tc != infinity_tc ) state.tc_round[tc] = state.round;
+					}
 				}
 			}
 		}
+		return true;
+	}
+}
+
+int collapse_independent_edges(
+    int max_collapses,
+    double tolerance,
+    double cost_limit,
+    Eigen::MatrixXd & V,
+    Eigen::MatrixXi & F,
+    Eigen::MatrixXi & E,
+    Eigen::VectorXi & EMAP,
+    Eigen::MatrixXi & EF,
+    Eigen::MatrixXi & EI,
+    Eigen::MatrixXd & TC,
+    Eigen::MatrixXi & FT,
+    SeamFlags & seams,
+    QuadricStore & Vmetrics,
+    int seam_aware_degree,
+    PriorityQueue & Q,
+    std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
+    IndependentSetState & state,
+    std::vector< double > & collapsed_costs,
+    bool preserve_boundaries,
+    double pos_scale,
+    double uv_weight,
+    DecimationWorkspace & workspace,
+    CollapseLog * log)
+{
+	const double inf = std::numeric_limits<double>::infinity();
+	DECIMATE_TRACE_SCOPE( trace, "collapse_independent_edges" );
+
+	refresh_queue_top(E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
+	if( Q.empty() || Q.top().first == inf || Q.top().first > cost_limit ) return 0;
+
+	if( int( state.vertex_round.size() ) != V.rows() ) state.vertex_round.assign( V.rows(), 0 );
+	if( int( state.tc_round.size() ) != TC.rows() ) state.tc_round.assign( TC.rows(), 0 );
+	++state.round;
+	const int infinity_vertex = V.row( V.rows()-1 ).minCoeff() == inf ? int( V.rows() )-1 : -1;
+	const int infinity_tc = TC.row( TC.rows()-1 ).minCoeff() == inf ? int( TC.rows() )-1 : -1;
+
+	const double top_cost = Q.top().first;
+	const double max_cost = std::min( top_cost + tolerance * std::max( top_cost, state.max_cost ), cost_limit );
+
+	// Pick the candidates in cost order. Edges whose one-ring overlaps the
+	// one-ring of an earlier candidate wait for a later round, and stale edges
+	// are recomputed at the end of this one.
+	std::vector< int > & candidates = workspace.candidates;
+	std::vector< double > & candidate_costs = workspace.candidate_costs;
+	std::vector< int > & candidate_faces = workspace.candidate_faces;
+	std::vector< int > & candidate_face_offsets = workspace.candidate_face_offsets;
+	std::vector< std::pair< double, int > > & postponed = workspace.postponed;
+	std::vector< int > & affected_edges = workspace.affected_edges;
+	std::vector< int > & faces = workspace.faces[0];
+	candidates.clear();
+	candidate_costs.clear();
+	candidate_faces.clear();
+	candidate_face_offsets.assign( 1, 0 );
+	postponed.clear();
+	affected_edges.clear();
+	const int max_scanned = 4 * max_collapses;
+	for( int scanned = 0; scanned < max_scanned && int( candidates.size() ) < max_collapses && !Q.empty(); ++scanned )
+	{
+		const std::pair< double, int > p = Q.top();
+		if( p.first > max_cost ) break;
+		const int e = p.second;
+		const bool at_infinity = E(e,0) == infinity_vertex || E(e,1) == infinity_vertex;
+		// Collapses involving the vertex at infinity are done on their own.
+		if( at_infinity && !candidates.empty() ) break;
+		Q.pop();
+		if( lazy.is_stale( e ) )
+		{
+			affected_edges.push_back( e );
+			continue;
+		}
+		if( !claim_one_ring( e, F, EMAP, EF, EI, FT, infinity_vertex, infinity_tc, state, faces, workspace.faces[1] ) )
+		{
+			postponed.push_back( p );
+			continue;
+		}
+		candidates.push_back( e );
+		candidate_costs.push_back( p.first );
+		candidate_faces.insert( candidate_faces.end(), faces.begin(), faces.end() );
+		candidate_face_offsets.push_back( int( candidate_faces.size() ) );
+		if( at_infinity ) break;
+	}
+	for( const auto & p : postponed ) Q.update( p.second, p.first );
+
+	const int n = int( candidates.size() );
+	std::vector< CollapseInfo > & infos = workspace.infos;
+	std::vector< char > & valid = workspace.valid;
+	if( int( infos.size() ) < n ) infos.resize( n );
+	valid.resize( n );
+	// The one-rings are disjoint, so the checks and the connectivity updates
+	// read and write different rows of the mesh.
+	parallel_for( n, [&]( const int i )
+	{
+		const int e = candidates[i];
+		valid[i] = check_collapse_5d_edge(e,C.at(e),F,E,EMAP,EF,EI,TC,FT,seams,preserve_boundaries,infos[i],&workspace.uv_orientations);
+		if( valid[i] ) collapse_connectivity_5d_edge(infos[i],C.at(e),V,F,E,EMAP,EF,EI,TC,FT,&workspace.uv_orientations);
+	}, 1 );
 
-		for( auto ei : affected_edges )
+	// Vmetrics has hash maps and seams is shared by neighboring collapses, so
+	// these updates run one by one.
+	int num_collapsed = 0;
+	for( int i = 0; i < n; ++i )
+	{
+		const int e = candidates[i];
+		if( !valid[i] )
 		{
-			if( E(ei,0) != DUV_COLLAPSE_EDGE_NULL && E(ei,1) != DUV_COLLAPSE_EDGE_NULL )
-			{
-				// erase old entry
-				Q.erase(Qit[ei]);
-				Qit[ei] = Q.end();
-				// compute cost and potential placement
-				double cost;
-				placement_info_5d place;
-				Bundle b = get_half_edge_bundle( ei, E, EF, EI, F, FT );
-				cost_and_placement_qslim5d_halfedge(b,V_scaled,F,TC_scaled,FT,seam_edges,Vmetrics,seam_aware_degree,pos_scale,uv_weight,cost,place);
-				// Replace in queue
-				Qit[ei] = Q.insert(std::pair<double,int>(cost,ei)).first;
-				C.at(ei) = place;
-			}
+			Q.update( e, inf );
+			continue;
 		}
-	} else
+		collapse_metrics_and_seams_5d_edge(infos[i],E,seams,Vmetrics);
+		if( log ) log->records.push_back( make_collapse_record( infos[i], V, TC, pos_scale, uv_weight, std::sqrt( std::max( 0.0, candidate_costs[i] ) ) / pos_scale ) );
+		Q.erase( infos[i].e1 );
+		Q.erase( infos[i].e2 );
+		append_live_edges(candidate_faces.begin()+candidate_face_offsets[i],candidate_faces.begin()+candidate_face_offsets[i+1],F,E,EMAP,affected_edges);
+		collapsed_costs.push_back( candidate_costs[i] );
+		state.max_cost = std::max( state.max_cost, candidate_costs[i] );
+		++num_collapsed;
+	}
+
+	// Stale candidates may have been collapsed since.
+	int num_live = 0;
+	for( auto ei : affected_edges )
 	{
-		// reinsert with infinite weight (the provided cost function must **not**
-		// have given this un-collapsable edge inf cost already)
-		p.first = std::numeric_limits<double>::infinity();
-		Qit[e] = Q.insert(p).first;
+		if( E(ei,0) != DUV_COLLAPSE_EDGE_NULL && E(ei,1) != DUV_COLLAPSE_EDGE_NULL ) affected_edges[num_live++] = ei;
 	}
-	return collapsed;
+	affected_edges.resize( num_live );
+	update_affected_edges(affected_edges,E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
+
+	DECIMATE_TRACE_COUNT( trace, num_collapsed );
+	return num_collapsed;
 }
@@ -6,6 +6,9 @@
 #include <unordered_set>
 #include <utility> // std::swap
 #include "decimate.h"
+#include "collapse_log.h"
+#include "seam_flags.h"
+#include "detect_foldover.h"
 
 // Assumes (V,F) is a closed manifold mesh (except for previouslly collapsed
 // faces which should be set to: 
@@ -21,7 +24,8 @@
 ///  p  dim list of vertex position where to place merged vertex
 // Inputs/Outputs:
 //   V  #V by dim list of vertex positions, lesser index of E(e,:) will be set
-//     to midpoint of edge.
+//     to midpoint of edge. Here and below, V and TC are scaled by pos_scale
+//     and uv_weight, like the placements (see prepare_decimate_halfedge_5d()).
 //   F  #F by 3 list of face indices into V.
 //   E  #E by 2 list of edge indices into V.
 //   EMAP #F*3 list of indices into E, mapping each directed edge to unique
@@ -37,6 +41,113 @@
 // Returns true if edge was collapsed
 #define DUV_COLLAPSE_EDGE_NULL -1
 
+// try_collapse_5d_Edge() is also available in three steps, so that collapses
+// of edges far enough apart can be checked and applied concurrently:
+//   1. check_collapse_5d_edge() runs all the checks and only reads the mesh.
+//   2. collapse_connectivity_5d_edge() updates V, TC, F, FT, E, EMAP, EF and
+//      EI, writing only to rows of the one-ring of the edge.
+//   3. collapse_metrics_and_seams_5d_edge() updates Vmetrics and seams.
+// What step 1 found out is kept in a CollapseInfo for the other two. Given
+// FaceUVOrientations, step 1 reads the orientations of the faces from it and
+// step 2 updates them.
+struct CollapseInfo
+{
+	int e = -1;
+	// d is collapsed into s, s < d.
+	int s = -1;
+	int d = -1;
+	int eflip = 0;
+	bool collapse_on_seam = false;
+	bool d_on_seam = false;
+	int s_tc = -1;
+	int d_tc = -1;
+	Bundle bundle;
+	// The faces around d and s.
+	std::vector<int> nV2Fd;
+	std::vector<int> nV2Fs;
+	// Scratch storage of the link condition: the vertices around s and d.
+	std::vector<int> link_s;
+	std::vector<int> link_d;
+	// Set by step 2: the two other edges removed by the collapse.
+	int e1 = -1;
+	int e2 = -1;
+	// Set by step 2: the edges e1 and e2 were merged into, and the other edges
+	// which ended at d and now end at s.
+	int kept_edges[2] = { -1, -1 };
+	std::vector<int> renamed_edges;
+	// Set by step 2: the two faces removed, the texture coordinates placed at
+	// new_placement.tcs and the (from,to) texture coordinates merged, in the
+	// order FT was updated.
+	int removed_faces[2] = { -1, -1 };
+	InlineVector<int,2> placed_tcs;
+	InlineVector< std::pair<int,int>, 3 > tc_remaps;
+
+	// Resets everything for another collapse, keeping the storage of the
+	// vectors.
+	void clear();
+};
+
+// Scratch storage of the collapse loop, kept from one collapse to the next.
+// Once the vectors have grown to the largest one-ring, collapsing an edge and
+// updating the edges around it doesn't allocate.
+struct DecimationWorkspace
+{
+	// The collapse being done by collapse_edge_with_uv().
+	CollapseInfo info;
+	// The edges around the collapses to update.
+	std::vector<int> affected_edges;
+	// The new costs and placements in update_edge_costs().
+	std::vector<double> costs;
+	std::vector<placement_info_5d> placements;
+	// The candidates of collapse_independent_edges(). The faces around
+	// candidate i are candidate_faces[candidate_face_offsets[i]..[i+1]).
+	std::vector<int> candidates;
+	std::vector<double> candidate_costs;
+	std::vector<int> candidate_faces;
+	std::vector<int> candidate_face_offsets;
+	std::vector< std::pair<double,int> > postponed;
+	std::vector<CollapseInfo> infos;
+	std::vector<char> valid;
+	std::vector<int> faces[2];
+	// Unlike the above, kept from one collapse to the next: the cached UV
+	// orientations, when DecimationOptions::cache_uv_orientations is set.
+	FaceUVOrientations uv_orientations;
+};
+
+bool check_collapse_5d_edge(
+	const int e,
+    const placement_info_5d & new_placement,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXi & E,
+    const Eigen::VectorXi & EMAP,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXd & TC,
+    const Eigen::MatrixXi & FT,
+    const SeamFlags & seams,
+    bool preserve_boundaries,
+    CollapseInfo & info,
+    const FaceUVOrientations * orientations = nullptr);
+
+void collapse_connectivity_5d_edge(
+    CollapseInfo & info,
+    const placement_info_5d & new_placement,
+    Eigen::MatrixXd & V,
+    Eigen::MatrixXi & F,
+    Eigen::MatrixXi & E,
+    Eigen::VectorXi & EMAP,
+    Eigen::MatrixXi & EF,
+    Eigen::MatrixXi & EI,
+    Eigen::MatrixXd & TC,
+    Eigen::MatrixXi & FT,
+    FaceUVOrientations * orientations = nullptr);
+
+void collapse_metrics_and_seams_5d_edge(
+    const CollapseInfo & info,
+    const Eigen::MatrixXi & E,
+    SeamFlags & seams,
+    QuadricStore & Vmetrics);
+
 bool try_collapse_5d_Edge(
 	const int e,
     const placement_info_5d & new_placement, // vertex position, texture coordinate, metric
@@ -48,16 +159,58 @@ bool try_collapse_5d_Edge(
     Eigen::MatrixXi & EI,
     Eigen::MatrixXd & TC, // TODO: Texture coordinates
     Eigen::MatrixXi & FT, // TODO: Texture coordinates per face.
-    Eigen::MatrixXd & V_scaled,
-    Eigen::MatrixXd & TC_scaled,
-    EdgeMap & seam_edges, // TODO: A set of edges in V for vertices which lie on edges which should be preserved.
-    MapV5d & Vmetrics, // TODO: The per-vertex data.
+    SeamFlags & seams, // The edges of E which should be preserved.
+    QuadricStore & Vmetrics, // TODO: The per-vertex data.
     int & a_e1,
     int & a_e2,
-    bool preserve_boundaries,
-    double pos_scale,
-    double uv_weight);
+    bool preserve_boundaries);
         
+// Recomputes the cost and placement of the edges edges[0..n), none of which
+// may have been collapsed, and replaces them in Q and C. The edges are no
+// longer stale afterwards.
+void update_edge_costs(
+    const int * edges,
+    const int n,
+    const Eigen::MatrixXi & E,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXd & V,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXd & TC,
+    const Eigen::MatrixXi & FT,
+    const SeamFlags & seams,
+    const QuadricStore & Vmetrics,
+    int seam_aware_degree,
+    double pos_scale,
+    double uv_weight,
+    PriorityQueue & Q,
+    std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
+    DecimationWorkspace & workspace);
+
+// With lazy updates, recomputes stale edges at the top of Q until the edge at
+// the top is up to date. Does nothing otherwise.
+void refresh_queue_top(
+    const Eigen::MatrixXi & E,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXd & V,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXd & TC,
+    const Eigen::MatrixXi & FT,
+    const SeamFlags & seams,
+    const QuadricStore & Vmetrics,
+    int seam_aware_degree,
+    double pos_scale,
+    double uv_weight,
+    PriorityQueue & Q,
+    std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
+    DecimationWorkspace & workspace);
+
+// Collapses the cheapest collapsible edge of Q, or returns false if there is
+// none or it costs more than cost_limit. Appends the collapse to log unless it
+// is null.
 bool collapse_edge_with_uv(
     Eigen::MatrixXd & V,
     Eigen::MatrixXi & F,
@@ -67,17 +220,72 @@ bool collapse_edge_with_uv(
     Eigen::MatrixXi & EI,
     Eigen::MatrixXd & TC, // TODO: Texture coordinates
     Eigen::MatrixXi & FT, // TODO: Texture coordinates per face.
-    EdgeMap & seam_edges, // TODO: A set of edges in V for vertices which lie on edges which should be preserved.
-    MapV5d & Vmetrics, // TODO: The per-vertex data.
+    SeamFlags & seams, // The edges of E which should be preserved.
+    QuadricStore & Vmetrics, // TODO: The per-vertex data.
     int seam_aware_degree,
-    std::set<std::pair<double,int> > & Q,
-    std::vector<std::set<std::pair<double,int> >::iterator > & Qit,
+    PriorityQueue & Q,
     std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
     int & e,
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
-    Eigen::MatrixXd & V_scaled,
-    Eigen::MatrixXd & TC_scaled);
+    double cost_limit,
+    DecimationWorkspace & workspace,
+    CollapseLog * log);
+
+// The bookkeeping of collapse_independent_edges() between rounds.
+struct IndependentSetState
+{
+	// The round that last claimed each vertex and texture coordinate.
+	std::vector<int> vertex_round;
+	std::vector<int> tc_round;
+	int round = 0;
+	// The largest cost collapsed so far.
+	double max_cost = 0.0;
+};
+
+// One round of batch collapses. Takes up to max_collapses edges from the top
+// of Q whose one-rings share no vertex or texture coordinate, checks and
+// collapses them concurrently, and then updates the edges around them, which
+// gives the same mesh as collapsing them one by one in that order. Only edges
+// costing at most
+//     min( top + tolerance * max( top, state.max_cost ), cost_limit )
+// are taken, where top is the cost of the edge at the top of Q, so with
+// tolerance 0 all the edges collapsed cost the same as the top one. That is
+// the same cost level as collapsing edges one by one, not always the same
+// edges: there, collapsing one tied edge may change the cost of another
+// before it is taken.
+//
+// Appends the costs of the edges collapsed to collapsed_costs, and their
+// records to log unless it is null, and returns how
+// many were collapsed, which is 0 if Q is empty or its top edge has infinite
+// cost or costs more than cost_limit, but may also be 0 if all the candidates
+// failed their checks.
+int collapse_independent_edges(
+    int max_collapses,
+    double tolerance,
+    double cost_limit,
+    Eigen::MatrixXd & V,
+    Eigen::MatrixXi & F,
+    Eigen::MatrixXi & E,
+    Eigen::VectorXi & EMAP,
+    Eigen::MatrixXi & EF,
+    Eigen::MatrixXi & EI,
+    Eigen::MatrixXd & TC,
+    Eigen::MatrixXi & FT,
+    SeamFlags & seams,
+    QuadricStore & Vmetrics,
+    int seam_aware_degree,
+    PriorityQueue & Q,
+    std::vector< placement_info_5d > & C,
+    LazyEdgeUpdates & lazy,
+    IndependentSetState & state,
+    std::vector< double > & collapsed_costs,
+    bool preserve_boundaries,
+    double pos_scale,
+    double uv_weight,
+    DecimationWorkspace & workspace,
+    CollapseLog * log);
 
 #endif
@@ -0,0 +1,234 @@
+#include "collapse_log.h"
+#include "collapse_edge_seam.h"
+#include "decimate.h"
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	const char COLLAPSE_LOG_MAGIC[4] = { 'S', 'A', 'C', 'L' };
+	// Version 2 added the scales of the decimation.
+	const int32_t COLLAPSE_LOG_VERSION = 2;
+
+	template< typename T >
+	void write_value( std::ostream & out, const T & value )
+	{
+		out.write( reinterpret_cast< const char* >( &value ), sizeof( T ) );
+	}
+
+	template< typename T >
+	bool read_value( std::istream & in, T & value )
+	{
+		in.read( reinterpret_cast< char* >( &value ), sizeof( T ) );
+		return bool( in );
+	}
+
+	// Follows the merges of index i to the index it ended up as.
+	int find_merged( std::vector<int> & parent, int i )
+	{
+		int root = i;
+		while( parent[root] != root ) root = parent[root];
+		while( parent[i] != root )
+		{
+			const int next = parent[i];
+			parent[i] = root;
+			i = next;
+		}
+		return root;
+	}
+}
+
+CollapseRecord make_collapse_record(
+	const CollapseInfo & info,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXd & TC,
+	double pos_scale,
+	double uv_weight,
+	double error )
+{
+	CollapseRecord record;
+	record.e = info.e;
+	record.s = info.s;
+	record.d = info.d;
+	record.removed_faces[0] = info.removed_faces[0];
+	record.removed_faces[1] = info.removed_faces[1];
+	record.p = V.row( info.s ) / pos_scale;
+	record.placed_tcs.assign( info.placed_tcs.begin(), info.placed_tcs.end() );
+	for( auto tc : info.placed_tcs ) record.uvs.push_back( TC.row( tc ) / uv_weight );
+	record.tc_remaps.assign( info.tc_remaps.begin(), info.tc_remaps.end() );
+	record.error = error;
+	return record;
+}
+
+bool write_collapse_log( const std::string & path, const CollapseLog & log )
+{
+	std::ofstream out( path, std::ios::binary );
+	if( !out ) return false;
+
+	out.write( COLLAPSE_LOG_MAGIC, sizeof( COLLAPSE_LOG_MAGIC ) );
+	write_value( out, COLLAPSE_LOG_VERSION );
+	write_value( out, int32_t( log.num_vertices ) );
+	write_value( out, int32_t( log.num_tcs ) );
+	write_value( out, int32_t( log.num_faces ) );
+	write_value( out, log.pos_scale );
+	write_value( out, log.uv_weight );
+	write_value( out, int32_t( log.records.size() ) );
+	for( const auto & record : log.records )
+	{
+		assert( record.placed_tcs.size() == record.uvs.size() );
+		write_value( out, int32_t( record.e ) );
+		write_value( out, int32_t( record.s ) );
+		write_value( out, int32_t( record.d ) );
+		write_value( out, int32_t( record.removed_faces[0] ) );
+		write_value( out, int32_t( record.removed_faces[1] ) );
+		for( int k = 0; k < 3; ++k ) write_value( out, record.p(k) );
+		write_value( out, record.error );
+		write_value( out, uint8_t( record.placed_tcs.size() ) );
+		write_value( out, uint8_t( record.tc_remaps.size() ) );
+		for( size_t i = 0; i < record.placed_tcs.size(); ++i )
+		{
+			write_value( out, int32_t( record.placed_tcs[i] ) );
+			write_value( out, record.uvs[i](0) );
+			write_value( out, record.uvs[i](1) );
+		}
+		for( const auto & remap : record.tc_remaps )
+		{
+			write_value( out, int32_t( remap.first ) );
+			write_value( out, int32_t( remap.second ) );
+		}
+	}
+	return bool( out );
+}
+
+bool read_collapse_log( const std::string & path, CollapseLog & log )
+{
+	std::ifstream in( path, std::ios::binary );
+	if( !in ) return false;
+
+	char magic[4];
+	int32_t version = 0, num_vertices = 0, num_tcs = 0, num_faces = 0, num_records = 0;
+	in.read( magic, sizeof( magic ) );
+	if( !in || std::memcmp( magic, COLLAPSE_LOG_MAGIC, sizeof( magic ) ) != 0 ) return false;
+	if( !read_value( in, version ) || version < 1 || version > COLLAPSE_LOG_VERSION ) return false;
+	if( !read_value( in, num_vertices ) || !read_value( in, num_tcs ) || !read_value( in, num_faces ) ) return false;
+	double pos_scale = 1.0, uv_weight = 1.0;
+	if( version >= 2 && ( !read_value( in, pos_scale ) || !read_value( in, uv_weight ) ) ) return false;
+	if( !read_value( in, num_records ) || num_records < 0 ) return false;
+
+	log.num_vertices = num_vertices;
+	log.num_tcs = num_tcs;
+	log.num_faces = num_faces;
+	log.pos_scale = pos_scale;
+	log.uv_weight = uv_weight;
+	log.records.clear();
+	log.records.reserve( num_records );
+	for( int32_t r = 0; r < num_records; ++r )
+	{
+		CollapseRecord record;
+		int32_t e, s, d, f0, f1;
+		uint8_t num_placed, num_remaps;
+		if( !read_value( in, e ) || !read_value( in, s ) || !read_value( in, d ) || !read_value( in, f0 ) || !read_value( in, f1 ) ) return false;
+		for( int k = 0; k < 3; ++k ) if( !read_value( in, record.p(k) ) ) return false;
+		if( !read_value( in, record.error ) || !read_value( in, num_placed ) || !read_value( in, num_remaps ) ) return false;
+		record.e = e;
+		record.s = s;
+		record.d = d;
+		record.removed_faces[0] = f0;
+		record.removed_faces[1] = f1;
+		for( int i = 0; i < num_placed; ++i )
+		{
+			int32_t tc;
+			Eigen::RowVector2d uv;
+			if( !read_value( in, tc ) || !read_value( in, uv(0) ) || !read_value( in, uv(1) ) ) return false;
+			record.placed_tcs.push_back( tc );
+			record.uvs.push_back( uv );
+		}
+		for( int i = 0; i < num_remaps; ++i )
+		{
+			int32_t from, to;
+			if( !read_value( in, from ) || !read_value( in, to ) ) return false;
+			record.tc_remaps.push_back( std::make_pair( int( from ), int( to ) ) );
+		}
+		log.records.push_back( record );
+	}
+	return true;
+}
+
+void replay_collapse_log(
+	const CollapseLog & log,
+	int num_collapses,
+	const Eigen::MatrixXd & OV,
+	const Eigen::MatrixXi & OF,
+	const Eigen::MatrixXd & OTC,
+	const Eigen::MatrixXi & OFT,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out,
+	double & max_error )
+{
+	assert( log.num_vertices == OV.rows() );
+	assert( log.num_tcs == OTC.rows() );
+	assert( log.num_faces == OF.rows() );
+	num_collapses = std::min( num_collapses, int( log.records.size() ) );
+
+	// The input as it comes out of the working copy if no collapse moves it,
+	// like prepare_decimate_halfedge_5d() and clean_mesh() scale it. The
+	// records are already unscaled.
+	Eigen::MatrixXd V = OV;
+	Eigen::MatrixXi F = OF;
+	Eigen::MatrixXd TC = OTC;
+	Eigen::MatrixXi FT = OFT;
+	if( log.pos_scale != 1.0 ) {
+		V = OV * log.pos_scale;
+		V /= log.pos_scale;
+	}
+	if( log.uv_weight != 1.0 ) {
+		TC = OTC * log.uv_weight;
+		TC /= log.uv_weight;
+	}
+	// One more index for the vertex and texture coordinate at infinity, which
+	// aren't part of the input.
+	std::vector<int> vertex_parent( OV.rows() + 1 );
+	std::vector<int> tc_parent( OTC.rows() + 1 );
+	for( int i = 0; i < int( vertex_parent.size() ); ++i ) vertex_parent[i] = i;
+	for( int i = 0; i < int( tc_parent.size() ); ++i ) tc_parent[i] = i;
+
+	max_error = 0.0;
+	for( int r = 0; r < num_collapses; ++r )
+	{
+		const CollapseRecord & record = log.records[r];
+		assert( find_merged( vertex_parent, record.d ) == record.d );
+		vertex_parent[record.d] = record.s;
+		if( record.s < OV.rows() ) V.row( record.s ) = record.p;
+		for( size_t i = 0; i < record.placed_tcs.size(); ++i )
+		{
+			if( record.placed_tcs[i] < OTC.rows() ) TC.row( record.placed_tcs[i] ) = record.uvs[i];
+		}
+		for( const auto & remap : record.tc_remaps )
+		{
+			assert( find_merged( tc_parent, remap.first ) == remap.first );
+			if( remap.first != remap.second ) tc_parent[remap.first] = remap.second;
+		}
+		for( int side = 0; side < 2; ++side )
+		{
+			const int f = record.removed_faces[side];
+			if( f >= 0 && f < OF.rows() ) F.row( f ).setConstant( DUV_COLLAPSE_EDGE_NULL );
+		}
+		max_error = std::max( max_error, record.error );
+	}
+
+	for( int f = 0; f < F.rows(); ++f )
+	{
+		if( F(f,0) == DUV_COLLAPSE_EDGE_NULL ) continue;
+		for( int k = 0; k < 3; ++k )
+		{
+			F(f,k) = find_merged( vertex_parent, F(f,k) );
+			FT(f,k) = find_merged( tc_parent, FT(f,k) );
+		}
+	}
+	clean_mesh( V, F, TC, FT, F.rows(), 1.0, 1.0, V_out, F_out, TC_out, FT_out );
+}
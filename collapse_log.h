@@ -0,0 +1,86 @@
+#ifndef COLLAPSE_LOG_H
+#define COLLAPSE_LOG_H
+
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+#include <utility>
+
+struct CollapseInfo;
+
+// One edge collapse of a decimation, with everything needed to repeat it on
+// the input mesh: vertex d is merged into vertex s, which moves to p, the two
+// faces are removed, texture coordinates placed_tcs take the values uvs, and
+// then every face corner using texture coordinate tc_remaps[i].first uses
+// tc_remaps[i].second instead. All indices are into the mesh
+// decimate_halfedge_5d() works on, which is the input mesh plus, if it has a
+// boundary, a vertex, a texture coordinate and faces at infinity after the
+// input's own.
+struct CollapseRecord
+{
+	int e = -1;
+	int s = -1;
+	int d = -1;
+	int removed_faces[2] = { -1, -1 };
+	Eigen::RowVector3d p;
+	std::vector<int> placed_tcs;
+	std::vector<Eigen::RowVector2d> uvs;
+	std::vector< std::pair<int,int> > tc_remaps;
+	// The geometric error of the collapse, like decimate_halfedge_5d()'s
+	// max_geometric_error.
+	double error = 0.0;
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+// The collapses of one decimation, in order, and the size of its input mesh.
+// pos_scale and uv_weight are those of the decimation, whose working copy of
+// the input they round; logs written before they were recorded read as 1.
+struct CollapseLog
+{
+	int num_vertices = 0;
+	int num_tcs = 0;
+	int num_faces = 0;
+	double pos_scale = 1.0;
+	double uv_weight = 1.0;
+	std::vector<CollapseRecord> records;
+};
+
+// Makes the record of a collapse after collapse_connectivity_5d_edge() applied
+// it to V and TC, which are scaled by pos_scale and uv_weight.
+CollapseRecord make_collapse_record(
+	const CollapseInfo & info,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXd & TC,
+	double pos_scale,
+	double uv_weight,
+	double error );
+
+// Writes or reads the binary collapse log: a header with the input mesh size
+// followed by the records, in the byte order of the machine that wrote it.
+// Both return false if the file can't be written or isn't a collapse log.
+bool write_collapse_log( const std::string & path, const CollapseLog & log );
+bool read_collapse_log( const std::string & path, CollapseLog & log );
+
+// Rebuilds the mesh the decimation of (V,F,TC,FT) produced after the first
+// num_collapses records of `log`, like clean_mesh() on the decimater's
+// working copy, bit for bit: the rows no collapse placed go through the same
+// scaling by log.pos_scale and log.uv_weight and back. The input must be the
+// mesh the log was recorded for.
+//
+// Outputs:
+//   max_error  the largest error of the collapses replayed
+void replay_collapse_log(
+	const CollapseLog & log,
+	int num_collapses,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out,
+	double & max_error );
+
+#endif
@@ -18,20 +18,136 @@
 #include <chrono>
 
 #include "cost_and_placement.h"
-#include "eiquadprog.h"
+#include "placement_solver.h"
 #include "neighbor_faces_and_boundary.h"
+#include "instrumentation.h"
 
 namespace {
 	const double eps = 1e-8;
 	enum SOLVER_TYPE {
 		IGL_SOLVER = 0,
-		EIQUADPROG
-	} solver = EIQUADPROG;
+		EIQUADPROG,
+		// The fixed-size solvers of placement_solver.h, falling back to
+		// eiquadprog if they fail.
+		CLOSED_FORM
+	};
+	// Read-only, so that costs can be evaluated from several threads.
+	const SOLVER_TYPE solver = CLOSED_FORM;
 }
 	
 const double DINF = std::numeric_limits<double>::infinity();
 // #define DEBUG_MODE
 
+namespace {
+	// How cost_and_placement_qslim5d_halfedge() treats an edge.
+	enum EdgeKind {
+		// The edge must not be collapsed, its cost is DINF.
+		UNCOLLAPSIBLE_EDGE,
+		// case 1: the edge is on a seam.
+		SEAM_EDGE,
+		// case 2 and 3: both sides have the same wedges.
+		INTERIOR_EDGE
+	};
+
+	EdgeKind classify_edge(
+		const int e,
+		const Bundle & b,
+		const Eigen::MatrixXd & V,
+		const SeamFlags & seams )
+	{
+		// If one of the endpoints is the special vertex at infinity, don't touch it.
+		const bool has_infinity_vertex = V.row( V.rows()-1 ).minCoeff() == DINF;
+		if( has_infinity_vertex 
+		  	&& (/* F(b[0].fi, b[0].ki) == V.rows()-1 
+		   		|| F(b[1].fi, b[1].ki) == V.rows()-1
+		   		||*/ b[0].p[0].vi == V.rows()-1
+		   		|| b[0].p[1].vi == V.rows()-1) ) {
+			return UNCOLLAPSIBLE_EDGE;
+		}
+
+		// two vertex indices on one side of b
+		const int vi[2] = {b[0].p[0].vi, b[0].p[1].vi};
+		if( seams.is_locked_vertex( vi[0] ) || seams.is_locked_vertex( vi[1] ) ) return UNCOLLAPSIBLE_EDGE;
+		// If vi[0] and vi[1] are on seams, but (vi[0], vi[1]) is not, return infinite cost.
+		if( seams.is_seam_edge( e ) ) return SEAM_EDGE;
+		if( seams.is_seam_vertex( vi[0] ) && seams.is_seam_vertex( vi[1] ) ) {
+			return UNCOLLAPSIBLE_EDGE;
+		}
+		return INTERIOR_EDGE;
+	}
+
+	// Stores the problem of the INTERIOR_EDGE b in lane l of batch.
+	void gather_interior_edge(
+		const Bundle & b,
+		const Eigen::MatrixXd & V,
+		const Eigen::MatrixXd & TC,
+		const SeamFlags & seams,
+		const QuadricStore & Vmetrics,
+		PlacementBatch5d & batch,
+		const int l )
+	{
+		// new metric is the summation of the collapsed vertices' metrics
+		assert( b[0].p[0] == b[1].p[1] && b[0].p[1] == b[1].p[0] );
+		const int vi[2] = {b[0].p[0].vi, b[0].p[1].vi};
+		const int tci[2] = {b[0].p[0].tci, b[0].p[1].tci};
+
+		// case 2: If one vertex is on a seam, it will stay fixed. Make it the
+		// first wedge of the batch, which is where fixed placements go.
+		// case 3: no attachment to seam, solve.
+		int first = 0;
+		batch.fixed(l) = 0;
+		for(int end=0; end<2; end++) {
+			if(seams.is_seam_vertex(vi[end]) && !seams.is_seam_vertex(vi[1-end])) {
+				first = end;
+				batch.fixed(l) = 1;
+				break;
+			}
+		}
+		// With normals, the first side gets the reduced quadric of the merged
+		// wedge and the second none, so that the batch's sum is that quadric.
+		const Quadric5d normal_q = Vmetrics.has_normals() ? Vmetrics.merged(vi[0], tci[0], vi[1], tci[1]) : Quadric5d();
+		for(int side=0; side<2; side++) {
+			const int end = (first + side) % 2;
+			const Quadric5d q = !Vmetrics.has_normals() ? Vmetrics.at(vi[end], tci[end]) : side == 0 ? normal_q : Quadric5d();
+			for(int k=0; k<21; k++) batch.q[side][k](l) = q.c[k];
+			for(int i=0; i<3; i++) batch.p[side][i](l) = V(vi[end], i);
+			for(int i=0; i<2; i++) batch.p[side][3+i](l) = TC(tci[end], i);
+		}
+	}
+
+	// Reads the result of lane l of the solved batch.
+	void scatter_interior_edge(
+		const PlacementBatch5d & batch,
+		const int l,
+		double & cost,
+		placement_info_5d & new_placement )
+	{
+		Quadric5d new_quadric;
+		for(int k=0; k<21; k++) new_quadric.c[k] = batch.quadric[k](l);
+
+		PlacementVector6d Z;
+		Z << batch.x[0](l), batch.x[1](l), batch.x[2](l), batch.x[3](l), batch.x[4](l), 1;
+		cost = batch.cost(l);
+		if( !batch.fixed(l) && ( solver != CLOSED_FORM || batch.failed(l) ) ) {
+			PlacementVector6d mid;
+			mid.setOnes();
+			for(int i=0; i<5; i++) mid(i) = (batch.p[0][i](l) + batch.p[1][i](l))/2;
+			PlacementMatrix6d G;
+			PlacementVector6d g0;
+			placement_qp_5d(new_quadric,mid,G,g0);
+			solve_placement_5d_quadprog(G,g0,Z);
+			DECIMATE_COUNT( QUADPROG_SOLVES );
+			cost = new_quadric.evaluate(Z);
+		}
+
+		// set UV coordinates to be the middle point
+		assert( std::isfinite(Z(0)) && std::isfinite(Z(1)) && std::isfinite(Z(2)) && std::isfinite(Z(3)) && std::isfinite(Z(4)));
+		new_placement.p = Z.head(3).transpose();
+		new_placement.tcs.clear();
+		new_placement.tcs.push_back( Z.segment(3,2).transpose() );
+	}
+}
+
 // get plane from three points, and express it as ax + by + cz + d = 0. 
 // return coefficients a,b,c,d as result
 Eigen::Vector4d face_from_three_points (
@@ -49,13 +165,14 @@ Eigen::Vector4d face_from_three_points (
 }
 
 void cost_and_placement_qslim5d_halfedge (
+	const int e,
 	const Bundle & b,
 	const Eigen::MatrixXd & V,
 	const Eigen::MatrixXi & F,
 	const Eigen::MatrixXd & TC,
 	const Eigen::MatrixXi & FT,
-	const EdgeMap & seam_edges,
-	const MapV5d & Vmetrics,
+	const SeamFlags & seams,
+	const QuadricStore & Vmetrics,
 	const int seam_aware_degree,
 	double pos_scale,
 	double uv_weight,
@@ -66,40 +183,39 @@ void cost_and_placement_qslim5d_halfedge (
 	using namespace Eigen;
 	using namespace std;
 
-	// If one of the endpoints is the special vertex at infinity, don't touch it.
 	assert( b.size() == 2 );		//  each edge has two half-edge
-	const bool has_infinity_vertex = V.row( V.rows()-1 ).minCoeff() == DINF;
-	if( has_infinity_vertex 
-	  	&& (/* F(b[0].fi, b[0].ki) == V.rows()-1 
-	   		|| F(b[1].fi, b[1].ki) == V.rows()-1
-	   		||*/ b[0].p[0].vi == V.rows()-1
-	   		|| b[0].p[1].vi == V.rows()-1) ) {
-		cost = DINF;
-		return;
+	switch( classify_edge( e, b, V, seams ) ) {
+		case UNCOLLAPSIBLE_EDGE:
+			cost = DINF;
+			return;
+		case INTERIOR_EDGE: {
+			/// case 2 and 3
+			PlacementBatch5d batch;
+			gather_interior_edge( b, V, TC, seams, Vmetrics, batch, 0 );
+			solve_placement_batch_5d( batch );
+			DECIMATE_COUNT( CLOSED_FORM_SOLVES );
+			scatter_interior_edge( batch, 0, cost, new_placement );
+			return;
+		}
+		case SEAM_EDGE:
+			break;
 	}
-		
-	solver = EIQUADPROG;
-	MatrixXd new_metric;
-	
+
 	// two vertex indices on one side of b
 	const int vi[2] = {b[0].p[0].vi, b[0].p[1].vi};
-	// If vi[0] and vi[1] are in seam_edges, but (vi[0], vi[1]) is not, return infinite cost.
-	if( seam_edges.count( vi[0] ) && seam_edges.count( vi[1] ) && !contains_edge( seam_edges, vi[0], vi[1] ) ) {
-	    cost = DINF;
-	    return;
-	}
 	
 	/// case 1: 
-	// (vi[0], vi[1]) in seam_edges, compute each half edge
-	if( contains_edge( seam_edges, vi[0], vi[1] ) ) {
+	// (vi[0], vi[1]) is a seam edge, compute each half edge
+	if( seams.is_seam_edge( e ) ) {
 		VertexBundle b_p0[2];		// two Vertex5d for both sides at one end
 		VertexBundle b_p1[2];		// two Vertex5d for both sides at the other end
-		MatrixXd m[2];				// two metrics
+		Quadric5d q[2];				// two metrics
+		Quadric5d::Matrix m[2];
 		for(int side=0; side<2; side++) {
 			b_p0[side] = b[side].p[0];
 			b_p1[side] = b[side].p[1];
-			m[side] = Vmetrics.at(b_p0[side].vi).at(b_p0[side].tci) 
-					+ Vmetrics.at(b_p1[side].vi).at(b_p1[side].tci);
+			q[side] = Vmetrics.merged(b_p0[side].vi, b_p0[side].tci, b_p1[side].vi, b_p1[side].tci);
+			m[side] = q[side].matrix();
 		}
 		
 		// TODO: Check that the seam edges are collinear with
@@ -132,13 +248,15 @@ void cost_and_placement_qslim5d_halfedge (
 		// for each end of one side, search its neighbor seam edges to check if anyone is collinear with b's uvs 
 		for(int end=0; end<2; end++) {
 			// An end is free only if it has exactly two neighboring seam edges
-			if(seam_edges.at(vi[end]).size() != 2)	continue;
-			for(auto vj : seam_edges.at(vi[end])) {		// all the neighboring seam vertices.
+			if(seams.valence(vi[end]) != 2)	continue;
+			for(int n=0; n<2; n++) {		// all the neighboring seam vertices.
+				const int vj = seams.neighbor(vi[end], n);
 				// test if exist one vertex which has two uvs collinear with both sides of b's uvs 
 				if( vj == vi[1-end] )	continue;
                 double ratio[2] = {DINF, DINF};
-				for(auto item : Vmetrics.at(vj)) {		// all the tci for one neighboring seam vertex.
-					int tcj = item.first;
+				const int * tcjs = Vmetrics.wedges(vj);
+				for(int k=0; k<Vmetrics.num_wedges(vj); k++) {		// all the tci for one neighboring seam vertex.
+					int tcj = tcjs[k];
 					if(is_collinear(tcj, b_p0[0].tci, b_p1[0].tci)) {
 						ratio[0] = edge_ratio(tcj, b_p0[0].tci, b_p1[0].tci);
 					}
@@ -167,9 +285,8 @@ void cost_and_placement_qslim5d_halfedge (
 			if( !is_free[end] ) {
 				cost = 0;
 				new_placement.tcs.resize(2);
-				new_placement.metrics.resize(2);
 				for(int side=0; side<2; side++) {
-					RowVectorXd v(6);
+					Eigen::Matrix<double,1,6> v;
 					v.setOnes();
 					assert(b[side].p[end].vi == vi[end] || b[side].p[end].vi == vi[1-end]);
 					v.head(3) = V.row(vi[end]);
@@ -177,61 +294,34 @@ void cost_and_placement_qslim5d_halfedge (
 					cost += v*m[side]*v.transpose();
 					new_placement.p = v.head(3);
 					new_placement.tcs[side] = v.segment(3,2);
-					new_placement.metrics[side] = m[side];
 				}
 				return;
 			}
 		}
 		// Finally, if both ends are free. Collapse the edge to a point on the seam.
 		// And the uv on both sides should be proportional.
-		VectorXd Z;
 		// The unknowns are x,y,z,u0,v0,u1,v1,1
-		MatrixXd G(8,8);
-		G.setZero();
+		PlacementMatrix8d G;
+		PlacementVector8d Z;
 		// combine both sides' metric of b
-		if( solver == EIQUADPROG ) {
+		if( solver == CLOSED_FORM || solver == EIQUADPROG ) {
 			// build new metric
-			G.block(0,0,3,3) = m[0].block(0,0,3,3) + m[1].block(0,0,3,3);
-			G.block(3,0,2,3) = m[0].block(3,0,2,3);
-			G.block(0,3,3,2) = m[0].block(0,3,3,2);
-			G.block(3,3,2,2) = m[0].block(3,3,2,2);
-			G.block(5,0,2,3) = m[1].block(3,0,2,3);
-			G.block(0,5,3,2) = m[1].block(0,3,3,2);
-			G.block(5,5,2,2) = m[1].block(3,3,2,2);
-			RowVectorXd b(7);	// b is the linear term in combined metric
-			b.segment(0,3) = m[0].block(5,0,1,3) + m[1].block(5,0,1,3);
-			b.segment(3,2) = m[0].block(5,3,1,2);
-			b.segment(5,2) = m[1].block(5,3,1,2);
-			G.block(7,0,1,7) = b;
-			G.block(0,7,7,1) = b.transpose();
-			G(7,7) = m[0](5,5) + m[1](5,5);
-			
-			// regularizer
-			const double w = 1e-6;
-			MatrixXd reg(8,8);
-			reg.setIdentity();
-			G.block(0,0,8,8) = G.block(0,0,8,8) + w*reg;
-			VectorXd g0(8);
-			g0.setOnes();
-			g0.segment(0,3) = (V.row(b_p0[0].vi)+V.row(b_p1[0].vi))/2;
-			g0.segment(3,2) = (TC.row(b_p0[0].tci)+TC.row(b_p1[0].tci))/2;
-			g0.segment(5,2) = (TC.row(b_p0[1].tci)+TC.row(b_p1[1].tci))/2;
-			g0 = -w*g0;
+			PlacementVector8d mid;
+			mid.setOnes();
+			mid.segment(0,3) = (V.row(b_p0[0].vi)+V.row(b_p1[0].vi))/2;
+			mid.segment(3,2) = (TC.row(b_p0[0].tci)+TC.row(b_p1[0].tci))/2;
+			mid.segment(5,2) = (TC.row(b_p0[1].tci)+TC.row(b_p1[1].tci))/2;
+			PlacementVector8d g0;
+			seam_placement_qp_5d(q,mid,G,g0);
 			
 			// Add the constraint that uv0 and uv1 stay on the same uv-space line
 			// and the new position should have the same parameter along each edge.
-			// equality constraints:
-			// x(7) - 1 = 0
-			// (x(3) - b0_u0) - t(b0_u1 - b0_u0) = 0
-			// (x(4) - b0_v0) - t(b0_v1 - b0_v0) = 0
-			// (x(5) - b1_u0) - t(b1_u1 - b1_u0) = 0
-			// (x(6) - b1_v0) - t(b1_v1 - b1_v0) = 0
 			// Original code start
 			// RowVector2d vec[2] = {TC.row(b_p1[0].tci) - TC.row(b_p0[0].tci),
 			// 					  TC.row(b_p1[1].tci) - TC.row(b_p0[1].tci)};
 			// assert( vec[0].norm() != 0 && vec[1].norm() != 0 );
 			// Original code end
-			RowVector2d vec[2] = {TC.row(b_p1[0].tci) - TC.row(b_p0[0].tci),
+			Vector2d vec[2] = {TC.row(b_p1[0].tci) - TC.row(b_p0[0].tci),
                       TC.row(b_p1[1].tci) - TC.row(b_p0[1].tci)};
 
 			// Check for zero-length UV edges and return infinite cost
@@ -244,130 +334,79 @@ void cost_and_placement_qslim5d_halfedge (
 						<< std::endl;
 				
 				// Return infinite cost to prevent this edge from being collapsed
+				DECIMATE_COUNT( REJECTED_ZERO_LENGTH_UV );
 				cost = DINF;
 				return;
 			}
 			// New code end
-			MatrixXd CE(8,4);
-			VectorXd ce0(4);
-			CE.setZero();
-			CE(7,0) = 1.0;
-			ce0(0) = -1;
-			if( vec[0](0) != 0 ) {		 // t = (x(3) - b0_u0)/(b0_u1 - b0_u0)
-				CE(3,1) = -vec[0](1);
-				CE(4,1) = vec[0](0);
-				ce0(1) = vec[0](1)*TC.row(b_p0[0].tci)(0) - vec[0](0)*TC.row(b_p0[0].tci)(1);
-				CE(3,2) = -vec[1](0);
-				CE(5,2) = vec[0](0);
-				ce0(2) = vec[1](0)*TC.row(b_p0[0].tci)(0) - vec[0](0)*TC.row(b_p0[1].tci)(0);
-				CE(3,3) = -vec[1](1);
-				CE(6,3) = vec[0](0);
-				ce0(3) = vec[1](1)*TC.row(b_p0[0].tci)(0) - vec[0](0)*TC.row(b_p0[1].tci)(1);
-			}
-			else {						// t = (x(4) - b0_v0)/(b0_v1 - b0_v0)
-				assert( vec[0](1) != 0 );
-				CE(4,1) = -vec[0](0);
-				CE(3,1) = vec[0](1);
-				ce0(1) = vec[0](0)*TC.row(b_p0[0].tci)(1) - vec[0](1)*TC.row(b_p0[0].tci)(0);
-				CE(4,2) = -vec[1](0);
-				CE(5,2) = vec[0](1);
-				ce0(2) = vec[1](0)*TC.row(b_p0[0].tci)(1) - vec[0](1)*TC.row(b_p0[1].tci)(0);
-				CE(4,3) = -vec[1](1);
-				CE(6,3) = vec[0](1);
-				ce0(3) = vec[1](1)*TC.row(b_p0[0].tci)(1) - vec[0](1)*TC.row(b_p0[1].tci)(1);
-			}
-			
-			// inequality constraints:
-			// t >= 0 && t <= 1
-			MatrixXd CI(8,2);
-			VectorXd ci0(2);
-			CI.setZero();
-			if( vec[0](0) != 0 ) {
-				double sign = vec[0](0) > 0 ? 1 : -1;
-				CI(3,0) = sign;
-				ci0(0) = -sign*TC.row(b_p0[0].tci)(0);
-				CI(3,1) = -sign;
-				ci0(1) = sign*(TC.row(b_p0[0].tci)(0)+vec[0](0));
-			}
-			else {
-				double sign = vec[0](1) > 0 ? 1 : -1;
-				CI(4,0) = sign;
-				ci0(0) = -sign*TC.row(b_p0[0].tci)(1);
-				CI(4,1) = -sign;
-				ci0(1) = sign*(TC.row(b_p0[0].tci)(1)+vec[0](1));
+			const Vector2d uv[2] = {TC.row(b_p0[0].tci), TC.row(b_p0[1].tci)};
+			if( solver == CLOSED_FORM ) DECIMATE_COUNT( CLOSED_FORM_SOLVES );
+			if( solver != CLOSED_FORM
+			    || !solve_seam_placement_5d(G,g0,uv[0],vec[0],uv[1],vec[1],Z) ) {
+				solve_seam_placement_5d_quadprog(G,g0,uv[0],vec[0],uv[1],vec[1],Z);
+				DECIMATE_COUNT( QUADPROG_SOLVES );
 			}
-			
-			solve_quadprog(G,g0,CE,ce0,CI,ci0,Z);
 		} else {
 			assert( false && "Unknown solver type" );
 		}
 			// set UV coordinates to be the middle point
 		assert( isfinite(Z(0)) && isfinite(Z(1)) && isfinite(Z(2)) 
 		     && isfinite(Z(3)) && isfinite(Z(4)) && isfinite(Z(5)) && isfinite(Z(6)));
-		new_placement.p = Z.head(3);
-		new_placement.tcs = {Z.segment(3,2), Z.segment(5,2)};
-		new_placement.metrics = {m[0], m[1]};
-		RowVectorXd v = Z;
+		new_placement.p = Z.head(3).transpose();
+		new_placement.tcs.resize(2);
+		new_placement.tcs[0] = Z.segment(3,2).transpose();
+		new_placement.tcs[1] = Z.segment(5,2).transpose();
+		const Eigen::Matrix<double,1,8> v = Z.transpose();
 		// Multiply by one half because we added two energy terms, shall we?
 		cost = v*G*v.transpose();
 				
 		return;
 	}
+}
 
-	/// case 2:
-	// new metric is the summation of the collapsed vertices' metrics
-	assert( b[0].p[0] == b[1].p[1] && b[0].p[1] == b[1].p[0] );
-	const int tci[2] = {b[0].p[0].tci, b[0].p[1].tci};
-	new_metric = Vmetrics.at(vi[0]).at(tci[0]) + Vmetrics.at(vi[1]).at(tci[1]);
-	assert( new_metric.transpose() == new_metric ); // all the metrics are symmetric
-	
-	// If one vertex is on a seam, it will stay fixed. Use Q as the cost.
-	for(int end=0; end<2; end++) {
-		if(seam_edges.count(vi[end]) && !seam_edges.count(vi[1-end])) {
-			RowVectorXd v(6);
-			v.setOnes();
-			v.head(3) = V.row(vi[end]);
-			v.segment(3,2) = TC.row(tci[end]);
-			cost = v*new_metric*v.transpose();
-			new_placement.p = V.row(vi[end]);
-			new_placement.tcs = { TC.row(tci[end]) };
-			new_placement.metrics = { new_metric };
-			return;
-		} 
-	}
-	
-	/// case 3: no attachment to seam	
-	// solve 
-	VectorXd Z;
-	if( solver == EIQUADPROG ) {
-		const double w = 1e-6;
-		MatrixXd G = new_metric;
-		// regularizer
-		MatrixXd reg(6,6);
-		reg.setIdentity();
-		G = G + w*reg;
-		MatrixXd CE(6,1);
-		CE.setZero();
-		CE(5,0) = 1.0;
-		VectorXd g0(6), ce0(1);
-		g0.setOnes();
-		g0.segment(0,3) = (V.row(vi[0])+V.row(vi[1]))/2;
-		g0.segment(3,2) = (TC.row(tci[0])+TC.row(tci[1]))/2;
-		g0 = -w*g0;
-		ce0 << -1;
-		MatrixXd CI;
-		VectorXd ci0;
-		solve_quadprog(G,g0,CE,ce0,CI,ci0,Z);
-	} else {
-		assert( false && "Unknown solver type" );
-	}
-
-	// set UV coordinates to be the middle point
-	assert( isfinite(Z(0)) && isfinite(Z(1)) && isfinite(Z(2)) && isfinite(Z(3)) && isfinite(Z(4)));
-	new_placement.p = Z.head(3);
-	new_placement.tcs = {Z.segment(3,2)};
-	new_placement.metrics = {new_metric};
-	RowVectorXd v = Z;
-	cost = v*new_metric*v.transpose();
+void cost_and_placement_qslim5d_halfedge_batch (
+	const int * edges,
+	const int n,
+	const Eigen::MatrixXi & E,
+	const Eigen::MatrixXi & EF,
+	const Eigen::MatrixXi & EI,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const SeamFlags & seams,
+	const QuadricStore & Vmetrics,
+	const int seam_aware_degree,
+	double pos_scale,
+	double uv_weight,
+	double *                costs,
+	placement_info_5d *     placements
+	)
+{
+	PlacementBatch5d batch;
+	// lane_index[l] is the index into edges of the edge in lane l.
+	int lane_index[PLACEMENT_BATCH_SIZE];
+	int num_lanes = 0;
+	const auto & flush = [&]()
+	{
+		solve_placement_batch_5d( batch );
+		DECIMATE_COUNT_N( CLOSED_FORM_SOLVES, num_lanes );
+		for( int l = 0; l < num_lanes; ++l ) {
+			scatter_interior_edge( batch, l, costs[lane_index[l]], placements[lane_index[l]] );
+		}
+		// Lanes past num_lanes keep their old, still valid, problems.
+		num_lanes = 0;
+	};
 
-}
\ No newline at end of file
+	for( int i = 0; i < n; ++i ) {
+		const Bundle b = get_half_edge_bundle( edges[i], E, EF, EI, F, FT );
+		if( classify_edge( edges[i], b, V, seams ) != INTERIOR_EDGE ) {
+			cost_and_placement_qslim5d_halfedge(edges[i],b,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,costs[i],placements[i]);
+			continue;
+		}
+		gather_interior_edge( b, V, TC, seams, Vmetrics, batch, num_lanes );
+		lane_index[num_lanes++] = i;
+		if( num_lanes == PLACEMENT_BATCH_SIZE ) flush();
+	}
+	if( num_lanes > 0 ) flush();
+}
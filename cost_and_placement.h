@@ -5,15 +5,18 @@
 #include <unordered_set>
 #include <set>
 #include "decimate.h"	
+#include "seam_flags.h"
   
+// e is the index into E of the edge whose half edges are b.
 void cost_and_placement_qslim5d_halfedge (
-	const Bundle & e,
+	const int e,
+	const Bundle & b,
 	const Eigen::MatrixXd & V,
 	const Eigen::MatrixXi & F,
 	const Eigen::MatrixXd & TC,
 	const Eigen::MatrixXi & FT,
-	const EdgeMap & seam_edges,
-	const MapV5d & Vmetrics,
+	const SeamFlags & seams,
+	const QuadricStore & Vmetrics,
 	const int seam_aware_degree,
 	double pos_scale,
 	double uv_weight,
@@ -21,4 +24,28 @@ void cost_and_placement_qslim5d_halfedge (
 	placement_info_5d &     new_placement
 	);
 
+// Computes cost_and_placement_qslim5d_halfedge() for the edges edges[0..n)
+// into costs[0..n) and placements[0..n). None of the edges may have been
+// collapsed. Edges away from seams are evaluated PLACEMENT_BATCH_SIZE at a
+// time with solve_placement_batch_5d(), the others one by one. Either way the
+// results are the same as calling cost_and_placement_qslim5d_halfedge().
+void cost_and_placement_qslim5d_halfedge_batch (
+	const int * edges,
+	const int n,
+	const Eigen::MatrixXi & E,
+	const Eigen::MatrixXi & EF,
+	const Eigen::MatrixXi & EI,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const SeamFlags & seams,
+	const QuadricStore & Vmetrics,
+	const int seam_aware_degree,
+	double pos_scale,
+	double uv_weight,
+	double *                costs,
+	placement_info_5d *     placements
+	);
+
 #endif
@@ -7,10 +7,16 @@
 #include <igl/seam_edges.h>
 #include <igl/writeOBJ.h>
 #include <iostream>
-#include <chrono>
-#include <igl/hausdorff.h>
 #include <igl/seam_edges.h>
 #include "cost_and_placement.h"
+#include "parallel_for.h"
+#include "placement_solver.h"
+#include "allocation_counter.h"
+#include "instrumentation.h"
+#include "seam_aware_decimator.h"
+#include "edge_topology.h"
+#include <algorithm>
+#include <functional>
 
 void clean_mesh(
 	const Eigen::MatrixXd & V,
@@ -18,11 +24,15 @@ void clean_mesh(
 	const Eigen::MatrixXd & TC,
 	const Eigen::MatrixXi & FT,
 	const int nF,
+	double pos_scale,
+	double uv_weight,
 	Eigen::MatrixXd & V_out,
 	Eigen::MatrixXi & F_out,
 	Eigen::MatrixXd & TC_out,
-	Eigen::MatrixXi & FT_out) 
+	Eigen::MatrixXi & FT_out,
+	DecimationOrigins * origins) 
 {
+	PhaseTimer timer( CLEAN_MESH_PHASE );
 	using namespace Eigen;
 	using namespace igl;
 	MatrixXi F2(nF,3);
@@ -49,7 +59,48 @@ void clean_mesh(
 	FT2.conservativeResize(m,FT2.cols());
 	VectorXi _1;
 	remove_unreferenced(V,F2,V_out,F_out,_1);
+	if( pos_scale != 1.0 ) V_out /= pos_scale;
+	if( origins ) {
+		origins->vertices.resize( V_out.rows() );
+		for( int i = 0; i < _1.size(); ++i ) if( _1(i) != -1 ) origins->vertices( _1(i) ) = i;
+	}
 	remove_unreferenced(TC,FT2,TC_out,FT_out,_1);
+	if( uv_weight != 1.0 ) TC_out /= uv_weight;
+	if( origins ) {
+		origins->tcs.resize( TC_out.rows() );
+		for( int i = 0; i < _1.size(); ++i ) if( _1(i) != -1 ) origins->tcs( _1(i) ) = i;
+	}
+}
+
+double unit_area_position_scale(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F)
+{
+	const double TARGET_AVG_AREA = 1.0; 
+
+	double total_area = 0.0;
+	for (int i = 0; i < F.rows(); ++i) {
+		const Eigen::Vector3d v0 = V.row(F(i, 0));
+		const Eigen::Vector3d v1 = V.row(F(i, 1));
+		const Eigen::Vector3d v2 = V.row(F(i, 2));
+		total_area += 0.5 * ((v1 - v0).cross(v2 - v0)).norm();
+	}
+
+	const double avg_area = (F.rows() > 0) ? (total_area / F.rows()) : 0.0;
+	return (avg_area > 1e-12) ? sqrt(TARGET_AVG_AREA / avg_area) : 1.0;
+}
+
+void find_seam_edges(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXi & FT,
+	EdgeMap & seam_edges)
+{
+	EdgeTopology topology;
+	build_edge_topology( F, TC, FT, V.rows(), topology );
+	seam_edges.clear();
+	insert_edges_of_kind( topology, ANY_SEAM_EDGE, seam_edges );
 }
 
 void prepare_decimate_halfedge_5d(
@@ -58,12 +109,13 @@ void prepare_decimate_halfedge_5d(
     const Eigen::MatrixXd & OTC,
     const Eigen::MatrixXi & OFT,
     EdgeMap & seam_edges,
-    MapV5d & Vmetrics,
+    QuadricStore & Vmetrics,
     int & target_num_vertices,
     const int seam_aware_degree,
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
+    const std::vector< int > & locked_vertices,
     // output
     Eigen::MatrixXd & V,
 	Eigen::MatrixXi & F,
@@ -74,114 +126,70 @@ void prepare_decimate_halfedge_5d(
 	Eigen::MatrixXi & EF,
 	Eigen::MatrixXi & EI,
     PriorityQueue & Q,
-	std::vector<PriorityQueue::iterator > & Qit,
-	std::vector< placement_info_5d > & C
+	std::vector< placement_info_5d > & C,
+	SeamFlags & seams,
+	const EdgeTopology * topology
 	)
 {
 	using namespace Eigen;
 	using namespace std;
 	using namespace igl;
 	
-	if( preserve_boundaries ) {
-		Eigen::MatrixXi E_b, EF_b, EI_b;
-		Eigen::VectorXi EMAP_b;
-		igl::edge_flaps(OF, E_b, EMAP_b, EF_b, EI_b);
-		for(int i = 0; i < E_b.rows(); ++i) {
-			if(EF_b(i, 1) == -1) {
-				const int v1 = E_b(i, 0);
-				const int v2 = E_b(i, 1);
-				insert_edge(seam_edges, v1, v2);
-			}
-		}
+	// Working copies, closed with a vertex, a texture coordinate and faces at
+	// infinity.
+	EdgeTopology built;
+	if( !topology ) {
+		build_edge_topology( OF, OTC, OFT, OV.rows(), built );
+		topology = &built;
 	}
-
-	// Working copies
-	V = OV;
-	F = OF;
-	igl::connect_boundary_to_infinity(OV,OF,V,F);
-	const bool has_infinity_vertex = V.row( V.rows()-1 ).minCoeff() == std::numeric_limits<double>::infinity();
-	if( has_infinity_vertex )	target_num_vertices++;
-	TC = OTC;
-	FT = OFT;
-	
-	// priorityQueue
-	edge_flaps(F,E,EMAP,EF,EI);
-	
-	if( has_infinity_vertex ){
-        // Let's add infinity faces to FT and an infinity vertex to TC.
-        // We are doing this with intimate knowledge of how connect_boundary_to_infinity()
-        // works.
-        
-        /// 1 Add a texture coordinate at infinity to TC with a zero quadric.
-        /// 2 Iterate over newly added faces in F (the bottom ones that aren't in OF).
-        /// 3 Find the edge between the two non-infinite vertices.
-        /// 4 Find the original face opposite this edge.
-        /// 5 Add a corresponding new face to FT referencing the same texture coordinates as
-        ///   the same vertices in the opposite face, connected to the texture coordinate
-        ///   at infinity.
-        
-        /// 1
-        TC.conservativeResize( OTC.rows() + 1, Eigen::NoChange );
-        auto inf = std::numeric_limits<double>::infinity();
-        TC.row( OTC.rows() ).setConstant( inf );
-        // Add a zero quadric.
-        Vmetrics[OV.rows()][OTC.rows()].setZero( 6,6 );
-        
-        
-        // Allocate space for the new faces added by step 5.
-        FT.conservativeResize( F.rows(), Eigen::NoChange );
-        
-        /// 2
-        for( int fi = OF.rows(); fi < F.rows(); ++fi ) {
-            // In connect_boundary_to_infinity(), the new face always has the infinity
-            // vertex last.
-            const int fi_vinf = 2;
-            assert( F( fi, fi_vinf ) == OV.rows() );
-            /// 3
-            // The edge is in EMAP across from the infinity vertex in the face.
-            const int e = EMAP( fi_vinf*F.rows() + fi );
-            // Make sure this is the right edge; one side should point to `fi`.
-            assert( EF(e,0) == fi || EF(e,1) == fi );
-            /// 4
-            // Get the opposite face index.
-            const int fi_opp =
-                EF(e,0) == fi
-                ? EF(e,1)
-                : EF(e,0)
-                ;
-            // Find the index of fi's vertex fi_vinf + 1 in fi_opp.
-            int fi_opp_v1 = 0;
-            for( ; fi_opp_v1 < 3; ++fi_opp_v1 ) {
-                if( F( fi_opp, fi_opp_v1 ) == F( fi, ( fi_vinf + 1 ) % 3 ) ) break;
-            }
-            assert( fi_opp_v1 < 3 );
-            // Since fi and fi_opp have the opposite orientation,
-            // the other vertex we want, fi_vinf + 2, is at (fi_opp_v1-1).
-            const int fi_opp_v2 = ( fi_opp_v1 - 1 + 3 ) % 3;
-            
-            /// 5
-            FT( fi, fi_vinf ) = OTC.rows();
-            FT( fi, ( fi_vinf+1 ) % 3 ) = FT( fi_opp, fi_opp_v1 );
-            FT( fi, ( fi_vinf+2 ) % 3 ) = FT( fi_opp, fi_opp_v2 );
-        }
-    }
+	if( preserve_boundaries ) insert_edges_of_kind( *topology, MESH_BOUNDARY_EDGE, seam_edges );
+	V.resize( OV.rows() + 1, OV.cols() );
+	V.topRows( OV.rows() ) = OV * pos_scale;
+	V.row( OV.rows() ).setConstant( std::numeric_limits<double>::infinity() );
+	target_num_vertices++;
+	TC.resize( OTC.rows() + 1, OTC.cols() );
+	TC.topRows( OTC.rows() ) = OTC * uv_weight;
+	TC.row( OTC.rows() ).setConstant( std::numeric_limits<double>::infinity() );
+	// The texture coordinate at infinity has a zero quadric.
+	Vmetrics.resize( V.rows(), TC.rows() );
+	Vmetrics.set( OV.rows(), OTC.rows(), Quadric5d() );
+	if( topology == &built ) {
+		F.swap( built.F );
+		FT.swap( built.FT );
+		E.swap( built.E );
+		EF.swap( built.EF );
+		EI.swap( built.EI );
+		EMAP.swap( built.EMAP );
+	}
+	else {
+		F = topology->F;
+		FT = topology->FT;
+		E = topology->E;
+		EF = topology->EF;
+		EI = topology->EI;
+		EMAP = topology->EMAP;
+	}
+	seams.build( seam_edges, E, V.rows() );
+	for( auto v : locked_vertices ) seams.lock_vertex( v );
     
-	Qit.resize(E.rows());
 	// If an edge were collapsed, we'd collapse it to these points:
 	C.resize( E.rows() );
 
-	Eigen::MatrixXd V_scaled = V * pos_scale;
-	Eigen::MatrixXd TC_scaled = TC * uv_weight;
-	
-	for ( int e=0; e<E.rows(); e++ )
+	// Every edge's cost is independent of the others, so compute them all in
+	// parallel and build the queue in one step afterwards. The queue orders
+	// ties by edge index, so the result doesn't depend on the thread count.
+	// Each task evaluates a block of consecutive edges as one batch.
+	std::vector< double > costs( E.rows(), -31337 );
+	std::vector< int > edges( E.rows() );
+	for( int e = 0; e < E.rows(); ++e ) edges[e] = e;
+	const int block_size = 16*PLACEMENT_BATCH_SIZE;
+	parallel_for( ( E.rows() + block_size - 1 )/block_size, [&]( const int block )
 	{
-		double cost = -31337;
-		placement_info_5d new_placement;
-		Bundle b = get_half_edge_bundle( e, E, EF, EI, F, FT );
-		cost_and_placement_qslim5d_halfedge(b,V_scaled,F,TC_scaled,FT,seam_edges,Vmetrics,seam_aware_degree,pos_scale,uv_weight,cost,new_placement);
-		C.at(e) = new_placement;
-		Qit[e] = Q.insert(std::pair<double,int>(cost,e)).first;
-	}
+		const int first = block*block_size;
+		const int n = std::min( block_size, int( E.rows() ) - first );
+		cost_and_placement_qslim5d_halfedge_batch(&edges[first],n,E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,&costs[first],&C[first]);
+	} );
+	Q.build( costs );
 	assert( Q.size() == E.rows() );
 }
 
@@ -195,18 +203,19 @@ bool collapse_one_edge(
 	Eigen::MatrixXi & E,
 	Eigen::MatrixXi & EF,
 	Eigen::MatrixXi & EI,
-    EdgeMap & seam_edges,
-    MapV5d & Vmetrics,
+    SeamFlags & seams,
+    QuadricStore & Vmetrics,
     const int seam_aware_degree,
 	PriorityQueue & Q, 
-	std::vector<PriorityQueue::iterator > & Qit, 
 	std::vector< placement_info_5d > & C, 
+	LazyEdgeUpdates & lazy,
 	int & prev_e,
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
-    Eigen::MatrixXd & V_scaled,
-    Eigen::MatrixXd & TC_scaled
+    double cost_limit,
+    DecimationWorkspace & workspace,
+    CollapseLog * log
 	)
 {
 	using namespace std;
@@ -220,17 +229,22 @@ bool collapse_one_edge(
 		{
 			break;
 		}
-		if(Q.begin()->first == std::numeric_limits<double>::infinity())
+		if(Q.top().first == std::numeric_limits<double>::infinity() || Q.top().first > cost_limit)
 		{
 			// min cost edge is infinite cost
 			break;
 		}
 
-		if(collapse_edge_with_uv(V,F,E,EMAP,EF,EI,TC,FT,seam_edges,Vmetrics,seam_aware_degree,Q,Qit,C,e, preserve_boundaries, pos_scale, uv_weight, V_scaled, TC_scaled))
+		if(collapse_edge_with_uv(V,F,E,EMAP,EF,EI,TC,FT,seams,Vmetrics,seam_aware_degree,Q,C,lazy,e, preserve_boundaries, pos_scale, uv_weight, cost_limit, workspace, log))
 		{
 			success = true;
 			break;
 		} 
+		else if(!Q.empty() && Q.top().first > cost_limit)
+		{
+			// The refreshed top edge costs too much.
+			break;
+		}
 		else if(prev_e == e) 
 		{
 			assert(false && "Edge collapse no progress... bad stopping condition?");
@@ -248,7 +262,7 @@ bool decimate_halfedge_5d(
     const Eigen::MatrixXd & OTC,
     const Eigen::MatrixXi & OFT,
     EdgeMap & seam_edges,
-    MapV5d & Vmetrics,
+    QuadricStore & Vmetrics,
     int target_num_vertices,
     const int seam_aware_degree,
     Eigen::MatrixXd & V_out,
@@ -258,66 +272,57 @@ bool decimate_halfedge_5d(
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
-    double& max_error
+    double& max_error,
+    const DecimationOptions & options,
+    DecimationStats * stats,
+    std::vector< DecimationSnapshot > * lods,
+    CollapseLog * log,
+    DecimationOrigins * origins,
+    const EdgeTopology * topology,
+    Eigen::MatrixXd * CN_out,
+    Eigen::MatrixXi * FN_out
     )
 {
-	using namespace Eigen;
-	using namespace std;
-	using namespace igl;	
-	
-	Eigen::MatrixXd V;
-	Eigen::MatrixXi F;
-	Eigen::MatrixXd TC;
-	Eigen::MatrixXi FT;
-	Eigen::VectorXi EMAP;
-	Eigen::MatrixXi E;
-	Eigen::MatrixXi EF;
-	Eigen::MatrixXi EI;
-	PriorityQueue Q;
-	std::vector<PriorityQueue::iterator > Qit;
-	std::vector< placement_info_5d > C;
-	prepare_decimate_halfedge_5d(OV,OF,OTC,OFT,seam_edges,Vmetrics,target_num_vertices,seam_aware_degree,preserve_boundaries,
-			pos_scale, uv_weight, V,F,TC,FT,EMAP,E,EF,EI,Q,Qit,C);
-	
-	Eigen::MatrixXd V_scaled = V * pos_scale;
-	Eigen::MatrixXd TC_scaled = TC * uv_weight;
+	std::vector< int > lod_targets = options.lod_targets;
+	std::sort( lod_targets.begin(), lod_targets.end(), std::greater< int >() );
+	if( lods ) lods->clear();
+
+	SeamAwareDecimator decimator;
+	decimator.prepare(OV,OF,OTC,OFT,seam_edges,Vmetrics,seam_aware_degree,preserve_boundaries,pos_scale,uv_weight,options,log,topology);
 
-	int prev_e = -1;
+	const auto & snapshot = [&]( const int lod_target )
+	{
+		DecimationSnapshot level;
+		level.target_num_vertices = lod_target;
+		level.max_geometric_error = decimator.max_error();
+		decimator.extract(level.V,level.F,level.TC,level.FT,nullptr,&level.CN,&level.FN);
+		lods->push_back( std::move( level ) );
+	};
+	const long long allocations_before = heap_allocation_count();
+	// Levels below the target are never reached, and the decimation may stop
+	// before some; those get the final mesh.
 	bool clean_finish = true;
-	int remain_vertices=V.rows();
-	double current_max_error = 0.0;
-	
-	int next_output_target = V.rows();
-	int suffix = 0;
-	while(remain_vertices > target_num_vertices)
-	{		
-		if(Q.empty())
-		{
-			break;
-		}
-		const double cost = Q.begin()->first;
-		if(cost == std::numeric_limits<double>::infinity())
-		{
-			// min cost edge is infinite cost
-			break;
-		}
-		
-		bool collapse_success = collapse_one_edge(V,F,TC,FT,EMAP,E,EF,EI,seam_edges,Vmetrics,seam_aware_degree,Q,Qit,C,prev_e, preserve_boundaries, pos_scale, uv_weight, V_scaled, TC_scaled);
-		if(!collapse_success) {
-			clean_finish = false;
-			break;
+	size_t next_lod = 0;
+	if( lods ) {
+		for( ; next_lod < lod_targets.size() && lod_targets[next_lod] >= target_num_vertices; ++next_lod ) {
+			clean_finish = decimator.collapse_until( lod_targets[next_lod] );
+			if( decimator.num_vertices() > lod_targets[next_lod] ) break;
+			snapshot( lod_targets[next_lod] );
 		}
-
-		const double error = sqrt(std::max(0.0, cost)) / pos_scale;
-		current_max_error = std::max(current_max_error, error);
-
-		remain_vertices--;
+	}
+	if( next_lod == lod_targets.size() || !lods || lod_targets[next_lod] < target_num_vertices ) clean_finish = decimator.collapse_until( target_num_vertices );
+	const long long allocations_after = heap_allocation_count();
+	if( lods ) {
+		while( next_lod < lod_targets.size() ) snapshot( lod_targets[next_lod++] );
 	}
 
-	max_error = current_max_error;
-	// remove all DUV_COLLAPSE_EDGE_NULL faces
-	clean_mesh(V,F,TC,FT,OF.rows(),V_out,F_out,TC_out,FT_out);
+	max_error = decimator.max_error();
+	decimator.seam_edges( seam_edges );
+	if( stats ) {
+		*stats = decimator.stats();
+		stats->heap_allocations = allocations_before < 0 ? -1 : allocations_after - allocations_before;
+	}
+	decimator.extract(V_out,F_out,TC_out,FT_out,origins,CN_out,FN_out);
 	return clean_finish;
-	
 }
     
@@ -4,18 +4,164 @@
 #include <igl/point_mesh_squared_distance.h>
 #include <Eigen/Core>
 #include <vector>
+#include <limits>
 #include <unordered_set>
 #include <unordered_map>
 #include <set>
 #include "half_edge.h"
+#include "edge_queue.h"
+#include "collapse_log.h"
+#include "seam_flags.h"
 
+// Where an edge collapses to: one texture coordinate per wedge of the merged
+// vertex, i.e. two for seam edges and one otherwise. The metric of each new
+// wedge is the sum of the metrics of the two wedges merged into it, which the
+// collapse adds up itself.
 struct placement_info_5d {
-	Eigen::RowVectorXd p;
-	std::vector<Eigen::RowVectorXd> tcs;
-	std::vector<Eigen::MatrixXd>    metrics;
+	Eigen::RowVector3d p;
+	InlineVector<Eigen::RowVector2d,2> tcs;
 };
 
-typedef std::set<std::pair<double,int> > PriorityQueue;
+// See collapse_edge_seam.h.
+struct DecimationWorkspace;
+// See edge_topology.h.
+struct EdgeTopology;
+
+// Edge collapse queue. Define DECIMATE_USE_SET_QUEUE to fall back to the
+// original std::set based queue, e.g. for A/B benchmarks.
+#ifdef DECIMATE_USE_SET_QUEUE
+typedef SetQueue PriorityQueue;
+#else
+typedef IndexedHeapQueue PriorityQueue;
+#endif
+
+// Optional behavior of decimate_halfedge_5d().
+struct DecimationOptions
+{
+	// After a collapse, only mark the surrounding edges stale instead of
+	// recomputing their cost and placement. A stale edge keeps its old cost in
+	// the queue and is recomputed once it reaches the top. The edge collapsed is
+	// always up to date, but the collapse order may differ slightly.
+	bool lazy_updates = false;
+	// Keep the UV orientation of every face, updated after each collapse, so
+	// that the fold-over test of a collapse only compares signs. Costs a
+	// double per face; the collapses are the same either way.
+	bool cache_uv_orientations = false;
+	// Store the quadric of every wedge in single precision, which halves the
+	// memory of the quadrics; summing and evaluating them stays in double.
+	// Each collapse rounds the sum it stores, so the costs and the result
+	// differ slightly from double precision.
+	bool single_precision_quadrics = false;
+	// Once fewer than this fraction of the rows of the working mesh are still
+	// live, drop the collapsed vertices, texture coordinates, faces and edges
+	// and renumber the rest in the same order, so that the collapses keep
+	// working on dense arrays. The collapses and the output are the same
+	// either way. 0 never compacts; neither does recording a CollapseLog,
+	// whose records use the original numbering.
+	double compaction_threshold = 0.25;
+	// Renumber the working mesh in spatial_mesh_order() (see mesh_order.h)
+	// before building its edges, so that the collapses touch rows that are
+	// close by in memory even if the input's order is arbitrary. The output
+	// is in that order too, unless restore_input_order is set, but its
+	// DecimationOrigins refer to the input. The collapses may break ties
+	// differently. Not done while recording a CollapseLog, which needs the
+	// input's numbering.
+	bool spatial_order = false;
+	// Output the vertices, texture coordinates and faces in the relative
+	// order of the rows of the input they come from.
+	bool restore_input_order = false;
+	// Order edges of equal cost by a hash of the positions of their endpoints
+	// before their ids, so that which of them collapses first doesn't depend
+	// on how the edges are numbered. The output never depends on the thread
+	// count; the rest of a collapse, e.g. which endpoint is kept, still
+	// depends on the numbering, so the same mesh in another row order may
+	// still decimate differently.
+	bool stable_ties = false;
+	// Collapse up to this many edges per round, concurrently. The edges of a
+	// round are low-cost edges whose neighborhoods don't overlap; 1 collapses
+	// strictly in cost order.
+	int batch_size = 1;
+	// How far above the cheapest edge the edges of a round may cost, relative
+	// to the larger of that cost and the largest cost collapsed so far.
+	double batch_tolerance = 0.1;
+	// Vertex counts to snapshot the mesh at on the way to the target, for
+	// levels of detail. Any order; counts below the target are never reached.
+	std::vector< int > lod_targets;
+	// Stop before the first collapse whose geometric error, the quantity
+	// max_geometric_error reports, would exceed this. The target number of
+	// vertices still applies, as a floor.
+	double max_error = std::numeric_limits< double >::infinity();
+	// Vertices of V that no collapse may remove or move, e.g. the vertices a
+	// cluster shares with its neighbors (see clustered_decimate.h). The edges
+	// around them get infinite cost.
+	std::vector< int > locked_vertices;
+};
+
+// Which vertex and texture coordinate of the input each row of V_out and
+// TC_out of decimate_halfedge_5d() comes from: V_out.row(i) is what became of
+// V.row(vertices(i)), which was kept by every collapse that merged into it,
+// and likewise for tcs. Locked vertices keep their position exactly.
+struct DecimationOrigins
+{
+	Eigen::VectorXi vertices;
+	Eigen::VectorXi tcs;
+};
+
+// The mesh when decimate_halfedge_5d() reached one of
+// DecimationOptions::lod_targets, like the final V_out, F_out, TC_out, FT_out
+// and max_geometric_error. If the decimation stopped early, the remaining
+// levels get the final mesh.
+struct DecimationSnapshot
+{
+	int target_num_vertices = 0;
+	double max_geometric_error = 0.0;
+	Eigen::MatrixXd V;
+	Eigen::MatrixXi F;
+	Eigen::MatrixXd TC;
+	Eigen::MatrixXi FT;
+	// The normals, if the quadrics carry them (see half_edge_qslim_8d()).
+	Eigen::MatrixXd CN;
+	Eigen::MatrixXi FN;
+};
+
+// What decimate_halfedge_5d() did.
+struct DecimationStats
+{
+	// Cost and placement evaluations after the initial ones.
+	long long cost_evaluations = 0;
+	// Evaluations lazy updates avoided, i.e. how many more evaluations
+	// recomputing every edge around every collapse would have done.
+	long long saved_evaluations = 0;
+	// Heap allocations made while collapsing edges, including those of the
+	// optional outputs; -1 unless built with DECIMATE_COUNT_ALLOCATIONS. The
+	// collapses themselves only allocate while the scratch storage grows.
+	long long heap_allocations = -1;
+	// Whether the decimation stopped at DecimationOptions::max_error.
+	bool reached_max_error = false;
+	// How many times the working mesh was compacted (see
+	// DecimationOptions::compaction_threshold).
+	int compactions = 0;
+};
+
+// The version stamps behind DecimationOptions::lazy_updates. version[e] is
+// bumped every time the neighborhood of edge e changes, and evaluated[e] is
+// the version C[e] and the cost of e in the queue were computed for.
+struct LazyEdgeUpdates
+{
+	bool enabled = false;
+	std::vector< int > version;
+	std::vector< int > evaluated;
+	// Edges marked stale, each of which eager updates would have recomputed.
+	long long deferred = 0;
+	long long evaluations = 0;
+
+	void resize( int num_edges )
+	{
+		version.assign( num_edges, 0 );
+		evaluated.assign( num_edges, 0 );
+	}
+	bool is_stale( int e ) const { return enabled && version[e] != evaluated[e]; }
+};
 
   // Assumes (V,F) is a manifold mesh (possibly with boundary) Collapses edges
   // until desired number of faces is achieved. This uses default edge cost and
@@ -48,7 +194,15 @@ typedef std::set<std::pair<double,int> > PriorityQueue;
   //     based on current state. Guaranteed to be called after _successfully_
   //     collapsing edge e removing edges (e,e1,e2) and faces (f1,f2):
   //     bool should_stop =
-  //       stopping_condition(V,F,E,EMAP,EF,EI,Q,Qit,C,e,e1,e2,f1,f2);
+  //       stopping_condition(V,F,E,EMAP,EF,EI,Q,C,e,e1,e2,f1,f2);
+  //
+  // Optional outputs:
+  //   lods  one snapshot per options.lod_targets, from most to fewest vertices
+  //   log   every collapse, see replay_collapse_log()
+//   origins  where each output vertex and texture coordinate comes from
+//   topology  build_edge_topology() of the input, if the caller has it already
+//   CN_out, FN_out  the normals of the output if Vmetrics carries them (see
+//     half_edge_qslim_8d()), with FN_out indexing CN_out like FT_out TC_out
 
 bool decimate_halfedge_5d(
     const Eigen::MatrixXd & V,
@@ -56,7 +210,7 @@ bool decimate_halfedge_5d(
     const Eigen::MatrixXd & TC,
     const Eigen::MatrixXi & FT,
     EdgeMap & seam_edges,
-    MapV5d & Vmetrics,
+    QuadricStore & Vmetrics,
     int target_num_vertices,
     const int seam_aware_degree,
     Eigen::MatrixXd & V_out,
@@ -66,32 +220,69 @@ bool decimate_halfedge_5d(
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
-    double& max_geometric_error
+    double& max_geometric_error,
+    const DecimationOptions & options = DecimationOptions(),
+    DecimationStats * stats = nullptr,
+    std::vector< DecimationSnapshot > * lods = nullptr,
+    CollapseLog * log = nullptr,
+    DecimationOrigins * origins = nullptr,
+    const EdgeTopology * topology = nullptr,
+    Eigen::MatrixXd * CN_out = nullptr,
+    Eigen::MatrixXi * FN_out = nullptr
     );
     
+// Removes the collapsed faces among the first nF faces, and the vertices and
+// texture coordinates no longer used, dividing the positions by pos_scale and
+// the texture coordinates by uv_weight. origins, unless it is null, gets the
+// rows of V and TC the remaining ones are.
 void clean_mesh(
 	const Eigen::MatrixXd & V,
 	const Eigen::MatrixXi & F,
 	const Eigen::MatrixXd & TC,
 	const Eigen::MatrixXi & FT,
 	const int nF,
+	double pos_scale,
+	double uv_weight,
 	Eigen::MatrixXd & V_out,
 	Eigen::MatrixXi & F_out,
 	Eigen::MatrixXd & TC_out,
-	Eigen::MatrixXi & FT_out);
+	Eigen::MatrixXi & FT_out,
+	DecimationOrigins * origins = nullptr);
+
+// The scale of positions that makes the average area of the faces of (V,F)
+// 1, which balances the position and UV terms of the metrics; 1 for
+// degenerate meshes.
+double unit_area_position_scale(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F);
+
+// Collects the seam, boundary and fold-over edges igl::seam_edges() finds,
+// as pairs of vertex indices, which is what decimate_halfedge_5d() keeps.
+// See build_edge_topology(), which this runs.
+void find_seam_edges(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXi & FT,
+	EdgeMap & seam_edges);
 	
+// Builds the working mesh of (OV,OF,OTC,OFT), closed with a vertex, a texture
+// coordinate and faces at infinity, its edges and the queue of their costs.
+// V and TC are scaled by pos_scale and uv_weight, the space the collapses
+// work in; clean_mesh() scales them back.
 void prepare_decimate_halfedge_5d(
 	const Eigen::MatrixXd & OV,
     const Eigen::MatrixXi & OF,
     const Eigen::MatrixXd & OTC,
     const Eigen::MatrixXi & OFT,
     EdgeMap & seam_edges,
-    MapV5d & Vmetrics,
+    QuadricStore & Vmetrics,
     int & target_num_vertices,
     const int seam_aware_degree,
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
+    const std::vector< int > & locked_vertices,
     // output
     Eigen::MatrixXd & V,
 	Eigen::MatrixXi & F,
@@ -102,9 +293,12 @@ void prepare_decimate_halfedge_5d(
 	Eigen::MatrixXi & EF,
 	Eigen::MatrixXi & EI,
     PriorityQueue & Q,
-	std::vector<PriorityQueue::iterator > & Qit,
-	std::vector< placement_info_5d > & C);
+	std::vector< placement_info_5d > & C,
+	SeamFlags & seams,
+	const EdgeTopology * topology = nullptr);
 	
+// Collapses the cheapest collapsible edge of Q, unless it costs more than
+// cost_limit. Returns false if no edge was collapsed.
 bool collapse_one_edge(
 	Eigen::MatrixXd & V,
     Eigen::MatrixXi & F,
@@ -114,21 +308,19 @@ bool collapse_one_edge(
 	Eigen::MatrixXi & E,
 	Eigen::MatrixXi & EF,
 	Eigen::MatrixXi & EI,
-    EdgeMap & seam_edges,
-    MapV5d & Vmetrics,
+    SeamFlags & seams,
+    QuadricStore & Vmetrics,
     const int seam_aware_degree,
 	PriorityQueue & Q, 
-	std::vector<PriorityQueue::iterator > & Qit, 
 	std::vector< placement_info_5d > & C, 
+	LazyEdgeUpdates & lazy,
 	int & prev_e,
     bool preserve_boundaries,
     double pos_scale,
     double uv_weight,
-    Eigen::MatrixXd & V_scaled,
-    Eigen::MatrixXd & TC_scaled);
-
-static std::unordered_set<int> interior_foldovers;
-static std::unordered_set<int> exterior_foldovers;
+    double cost_limit,
+    DecimationWorkspace & workspace,
+    CollapseLog * log);
 
 #endif
 
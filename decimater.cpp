@@ -1,5 +1,3 @@
-#include "igl/readOBJ.h"
-#include "igl/writeOBJ.h"
 // #include "igl/decimate.h"
 
 #include <Eigen/Core>
@@ -9,14 +7,25 @@
 #include <cstdlib> // exit()
 #include <iostream>
 #include <cassert>
+#include <cmath>
 #include <cstdio> // printf()
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
+#include <fstream>
+#include <mutex>
 
-#include <igl/seam_edges.h>
-#include <igl/edge_flaps.h>
 #include "decimate.h"
+#include "collapse_log.h"
+#include "mesh_io.h"
 #include "quadric_error_metric.h"
+#include "parallel_for.h"
+#include "instrumentation.h"
+#include "trace_events.h"
+#include "clustered_decimate.h"
+#include "batch_manifest.h"
+#include "edge_topology.h"
+#include "decimation_quality.h"
 #include <igl/writeDMAT.h>
 
 // An anonymous namespace. This hides these symbols from other modules.
@@ -24,18 +33,147 @@ namespace {
 
 void usage( const char* argv0 )
 {
-    std::cerr << "Usage: " << argv0 << " <path/to/input.obj> <command> <parameter> [<output.obj>] [options]" << std::endl << std::endl;
+    std::cerr << "Usage: " << argv0 << " <path/to/input.obj> <command> <parameter> [<output.obj>] [options]" << std::endl;
+    std::cerr << "       " << argv0 << " batch <manifest.txt> [options]" << std::endl;
+    std::cerr << "Meshes ending in .bmesh are read and written in the binary mesh format, outputs ending in .glb are written as glTF binaries, others as OBJ." << std::endl << std::endl;
     std::cerr << "Commands:" << std::endl;
     std::cerr << "  num-vertices <N>      Decimate to N vertices." << std::endl;
-    std::cerr << "  percent-vertices <P>  Decimate to P% of original vertices." << std::endl << std::endl;
+    std::cerr << "  percent-vertices <P>  Decimate to P% of original vertices." << std::endl;
+    std::cerr << "  max-error <eps>       Decimate as far as possible without the geometric error exceeding eps." << std::endl;
+    std::cerr << "  lods <N1,N2,...>      Decimate once, writing a level of detail at each of N1, N2, ... vertices." << std::endl;
+    std::cerr << "  replay <N>            Rebuild the level of detail with N vertices from a --collapse-log." << std::endl << std::endl;
     std::cerr << "Options:" << std::endl;
     std::cerr << "  --strict <degree>        Set seam awareness (0: NoUVShapePreserving, 1: UVShapePreserving, 2: Seamless (default))." << std::endl;
     std::cerr << "  --preserve-boundaries    Prevent boundary edges from being collapsed." << std::endl;
-    std::cerr << "  --uv-weight <weight>     Set weight for relative UV error weight (default: 1.0)." << std::endl << std::endl;
+    std::cerr << "  --uv-weight <weight>     Set weight for relative UV error weight (default: 1.0)." << std::endl;
+    std::cerr << "  --normal-weight <weight> Carry the input's normals through the quadrics with this weight and write them (default: 0, drop them)." << std::endl;
+    std::cerr << "  --weights <path>         Multiply the quadric of every face by the importance weights in this file (see mesh_io.h)." << std::endl;
+    std::cerr << "  --min-vertices <N>       For max-error, never decimate below N vertices (default: 1)." << std::endl;
+    std::cerr << "  --threads <N>            Use N threads for the parallel stages (default: one per core)." << std::endl;
+    std::cerr << "  --lazy                   Recompute edge costs only when they reach the top of the queue." << std::endl;
+    std::cerr << "  --cache-uv-orientations  Keep the UV orientation of every face for the fold-over test." << std::endl;
+    std::cerr << "  --float-quadrics         Store the quadrics in single precision, halving their memory." << std::endl;
+    std::cerr << "  --batch <N>              Collapse up to N independent edges per round, in parallel (default: 1)." << std::endl;
+    std::cerr << "  --batch-tolerance <t>    Relative cost range of the edges of a round (default: 0.1)." << std::endl;
+    std::cerr << "  --reorder                Renumber the mesh along a Morton curve before decimating, for memory locality." << std::endl;
+    std::cerr << "  --restore-order          With --reorder, output the mesh in the order of the input." << std::endl;
+    std::cerr << "  --stable-ties            Break ties between equal costs by the positions of the edges, not their numbering." << std::endl;
+    std::cerr << "  --compact <fraction>     Compact the working mesh when less than this fraction of it is left, 0 never (default: 0.25)." << std::endl;
+    std::cerr << "  --cluster-faces <N>      Decimate clusters of at most N faces separately, then the stitched mesh." << std::endl;
+    std::cerr << "  --collapse-log <path>    Write every collapse to this binary log, or read it for replay." << std::endl;
+    std::cerr << "  --stats <path.json>      Write the time of each phase and what the collapses did to this JSON file." << std::endl;
+    std::cerr << "  --trace <path.json>      Write a Chrome trace of every step of the collapse loop (needs DECIMATE_TRACING=ON)." << std::endl;
+    std::cerr << "  --trace-min-us <t>       Leave the steps shorter than t microseconds out of the trace (default: 0)." << std::endl;
+    std::cerr << "  --verify <samples>       Measure the Hausdorff, RMS and UV seam distances to the input with this many samples per mesh." << std::endl;
+    std::cerr << "  --hash                   Print a hash of every mesh written (see mesh_hash() in mesh_io.h)." << std::endl << std::endl;
     std::cerr << "If an output file is not specified, one is generated with the final geometric error in its name." << std::endl;
+    std::cerr << "For lods, the number of vertices is appended to the name of the output file." << std::endl;
+    std::cerr << "A batch manifest has one '<input> <N or P%> <strictness> <uv-weight> <output>' per line (see batch_manifest.h)." << std::endl;
     exit(-1);
 }
 
+// Stops tracing and writes the trace for --trace, unless path is empty.
+void write_trace( const std::string& path )
+{
+    if( path.empty() ) return;
+    stop_tracing();
+    if( !write_trace_json( path ) ) {
+        std::cerr << "ERROR: Could not write trace: " << path << std::endl;
+        exit(-1);
+    }
+    std::cout << "Wrote: " << path << " (" << num_trace_events() << " events";
+    if( num_dropped_trace_events() > 0 ) std::cout << ", " << num_dropped_trace_events() << " more dropped";
+    std::cout << ")" << std::endl;
+}
+
+// What --hash prints for a mesh written to path.
+std::string hash_line( const std::string& path, const Eigen::MatrixXd& V, const Eigen::MatrixXi& F, const Eigen::MatrixXd& CN, const Eigen::MatrixXi& FN, const Eigen::MatrixXd& TC, const Eigen::MatrixXi& FT )
+{
+    char hash[17];
+    snprintf( hash, sizeof( hash ), "%016llx", (unsigned long long)mesh_hash( V, F, CN, FN, TC, FT ) );
+    return std::string( "Mesh hash: " ) + hash + " " + path;
+}
+
+// The output path used when none is given on the command line.
+std::string default_output_path( const std::string& input_path, int num_vertices, double error )
+{
+    std::stringstream error_ss;
+    error_ss << std::fixed << std::setprecision(6) << error;
+    return pythonlike::os_path_splitext( input_path ).first + 
+                              "-decimated_to_" + std::to_string( num_vertices ) + 
+                              "_err_" + error_ss.str() + ( is_binary_mesh_path( input_path ) ? ".bmesh" : ".obj" );
+}
+
+// JSON has no infinity.
+std::string json_number( double x )
+{
+    if( !std::isfinite( x ) ) return "null";
+    std::ostringstream ss;
+    ss << std::setprecision( 9 ) << x;
+    return ss.str();
+}
+
+// Prints what measure_decimation_quality() found.
+void print_quality( const DecimationQuality& quality, std::ostream& out )
+{
+    out << "Hausdorff distance: " << quality.hausdorff() << " (input to output: " << quality.input_to_output_max
+        << ", output to input: " << quality.output_to_input_max << ")" << std::endl;
+    out << "RMS distance: input to output: " << quality.input_to_output_rms << ", output to input: " << quality.output_to_input_rms << std::endl;
+    out << "UV seam distance: max: " << quality.seam_uv_max << ", RMS: " << quality.seam_uv_rms << std::endl;
+    out << "# verification samples: " << quality.num_surface_samples << " on the surfaces, " << quality.num_seam_samples << " on the seams" << std::endl;
+}
+
+// Writes the instrumentation totals and stats of a run as a JSON object, and
+// the quality unless it is null.
+bool write_stats_json(
+    const std::string& path,
+    const std::string& command,
+    const Eigen::MatrixXd& V,
+    const Eigen::MatrixXi& F,
+    const Eigen::MatrixXd& V_out,
+    const Eigen::MatrixXi& F_out,
+    double max_error,
+    const DecimationStats& stats,
+    const DecimationQuality* quality
+    )
+{
+    std::ofstream out( path );
+    if( !out ) return false;
+    out << std::setprecision( 9 );
+    out << "{\n";
+    out << "  \"command\": \"" << command << "\",\n";
+    out << "  \"input\": { \"vertices\": " << V.rows() << ", \"faces\": " << F.rows() << " },\n";
+    out << "  \"output\": { \"vertices\": " << V_out.rows() << ", \"faces\": " << F_out.rows() << " },\n";
+    out << "  \"max_error\": " << max_error << ",\n";
+    out << "  \"cost_evaluations\": " << stats.cost_evaluations << ",\n";
+    out << "  \"saved_evaluations\": " << stats.saved_evaluations << ",\n";
+    out << "  \"heap_allocations\": " << stats.heap_allocations << ",\n";
+    out << "  \"compactions\": " << stats.compactions << ",\n";
+    out << "  \"reached_max_error\": " << ( stats.reached_max_error ? "true" : "false" ) << ",\n";
+    if( quality ) {
+        out << "  \"quality\": { \"hausdorff\": " << quality->hausdorff()
+            << ", \"input_to_output_max\": " << quality->input_to_output_max << ", \"input_to_output_rms\": " << quality->input_to_output_rms
+            << ", \"output_to_input_max\": " << quality->output_to_input_max << ", \"output_to_input_rms\": " << quality->output_to_input_rms
+            << ", \"seam_uv_max\": " << json_number( quality->seam_uv_max ) << ", \"seam_uv_rms\": " << json_number( quality->seam_uv_rms )
+            << ", \"surface_samples\": " << quality->num_surface_samples << ", \"seam_samples\": " << quality->num_seam_samples << " },\n";
+    }
+    out << "  \"instrumentation\": " << ( instrumentation_enabled() ? "true" : "false" ) << ",\n";
+    out << "  \"seconds\": {";
+    for( int p = 0; p < NUM_DECIMATION_PHASES; ++p ) {
+        const DecimationPhase phase = DecimationPhase( p );
+        out << ( p ? "," : "" ) << "\n    \"" << decimation_phase_name( phase ) << "\": " << phase_seconds( phase );
+    }
+    out << "\n  },\n";
+    out << "  \"counters\": {";
+    for( int c = 0; c < NUM_DECIMATION_COUNTERS; ++c ) {
+        const DecimationCounter counter = DecimationCounter( c );
+        out << ( c ? "," : "" ) << "\n    \"" << decimation_counter_name( counter ) << "\": " << counter_value( counter );
+    }
+    out << "\n  }\n";
+    out << "}\n";
+    return bool( out );
+}
+
 int count_seam_edge_num(const EdgeMap& seam_vertex_edges)
 {
 	int count = 0;
@@ -63,12 +201,20 @@ Input parameters:
     TC: The 2D texture coordinates of the input mesh (2 columns)
     F: Indices into `V` for the three vertices of each triangle.
     FTC: Indices into `TC` for the three vertices of each triangle.
+    CN: The normals of the input mesh (3 columns), possibly empty.
+    FN: Indices into `CN` for the three vertices of each triangle.
+    normal_weight: If positive and the input has normals, the weight of the
+                   normals in the quadrics, which then output them.
+    face_weights: If not null, the importance weight of every face of `F`,
+                  which multiplies its quadric.
 Output parameters:
     Vout: The 3D positions of the decimated mesh (3 columns),
           where #vertices is as close as possible to `target_num_vertices`)
     TCout: The texture coordinates of the decimated mesh (2 columns)
     Fout: Indices into `Vout` for the three vertices of each triangle.
     FTCout: Indices into `TCout` for the three vertices of each triangle.
+    CNout, FNout: The normals of the decimated mesh, or empty.
+    out: Where the progress messages go.
 Returns:
     True if the routine succeeded, false if an error occurred.
 Notes:
@@ -81,32 +227,33 @@ bool decimate_down_to(
     const Eigen::PlainObjectBase<DerivedF>& F,
     const Eigen::PlainObjectBase<DerivedT>& TC,
     const Eigen::PlainObjectBase<DerivedF>& FT,
+    const Eigen::MatrixXd& CN,
+    const Eigen::MatrixXi& FN,
     int target_num_vertices,
     Eigen::MatrixXd& V_out,
     Eigen::MatrixXi& F_out,
     Eigen::MatrixXd& TC_out,
     Eigen::MatrixXi& FT_out,
+    Eigen::MatrixXd& CN_out,
+    Eigen::MatrixXi& FN_out,
     int seam_aware_degree,
     bool preserve_boundaries,
 	double uv_weight,
-	double& max_error
+	double normal_weight,
+	const Eigen::VectorXd* face_weights,
+	double& max_error,
+	const DecimationOptions& options,
+	std::vector< DecimationSnapshot >* lods,
+	CollapseLog* log,
+	int max_cluster_faces,
+	DecimationStats& stats,
+	std::ostream& out
     )
 {
     assert( target_num_vertices > 0 );
     assert( target_num_vertices < V.rows() );
     
-	const double TARGET_AVG_AREA = 1.0; 
-
-    double total_area = 0.0;
-    for (int i = 0; i < F.rows(); ++i) {
-        const Eigen::Vector3d v0 = V.row(F(i, 0));
-        const Eigen::Vector3d v1 = V.row(F(i, 1));
-        const Eigen::Vector3d v2 = V.row(F(i, 2));
-        total_area += 0.5 * ((v1 - v0).cross(v2 - v0)).norm();
-    }
-
-    const double avg_area = (F.rows() > 0) ? (total_area / F.rows()) : 0.0;
-    const double pos_scale = (avg_area > 1e-12) ? sqrt(TARGET_AVG_AREA / avg_area) : 1.0;
+    const double pos_scale = unit_area_position_scale( V, F );
 
     /// 3D triangle mesh with UVs.
     // 3D
@@ -118,75 +265,58 @@ bool decimate_down_to(
     assert( FT.cols() == 3 );
     assert( FT.cols() == F.cols() );
     
+    assert( !face_weights || face_weights->size() == F.rows() );
+    
+    if( max_cluster_faces > 0 && F.rows() > max_cluster_faces ) {
+        ClusteredDecimationStats clustered_stats;
+        const bool success = decimate_clustered( V, F, TC, FT, target_num_vertices, max_cluster_faces, seam_aware_degree, preserve_boundaries, pos_scale, uv_weight, options,
+            V_out, F_out, TC_out, FT_out, max_error, &clustered_stats );
+        CN_out.resize( 0, 0 );
+        FN_out.resize( 0, 0 );
+        stats = clustered_stats.final_pass;
+        out << "# clusters: " << clustered_stats.num_clusters << std::endl;
+        out << "# vertices after stitching the clusters: " << clustered_stats.stitched_vertices << std::endl;
+        if( stats.reached_max_error ) out << "Stopped at " << V_out.rows() << " vertices: the next collapse would exceed the maximum error." << std::endl;
+        return success;
+    }
+    
     // Print information about seams.
-    Eigen::MatrixXi seams, boundaries, foldovers;
-    igl::seam_edges( V, TC, F, FT, seams, boundaries, foldovers );
+    PhaseTimer seam_detection_timer( SEAM_DETECTION_PHASE );
+    // The same topology serves to find the seams and to decimate.
+    EdgeTopology topology;
+    build_edge_topology( F, TC, FT, V.rows(), topology );
     
-    // Collect all vertex indices involved in seams.
-    std::unordered_set< int > seam_vertex_indices;
-    // Also collect the edges in terms of position vertex indices themselves.
+    // Collect the edges in terms of position vertex indices themselves.
     EdgeMap seam_vertex_edges;
-    {
-		for( int i = 0; i < seams.rows(); ++i ) {
-		    const int v1 = F( seams( i, 0 ),   seams( i, 1 ) );
-		    const int v2 = F( seams( i, 0 ), ( seams( i, 1 ) + 1 ) % 3 );
-			seam_vertex_indices.insert( v1 );
-			seam_vertex_indices.insert( v2 );
-			insert_edge( seam_vertex_edges, v1, v2 );
-			// The vertices on both sides should match:
-			assert( seam_vertex_indices.count( F( seams( i, 2 ),   seams( i, 3 ) ) ) );
-			assert( seam_vertex_indices.count( F( seams( i, 2 ), ( seams( i, 3 ) + 1 ) % 3 ) ) );
-		}
-		for( int i = 0; i < boundaries.rows(); ++i ) {
-		    const int v1 = F( boundaries( i, 0 ),   boundaries( i, 1 ) );
-		    const int v2 = F( boundaries( i, 0 ), ( boundaries( i, 1 ) + 1 ) % 3 );
-			seam_vertex_indices.insert( v1 );
-			seam_vertex_indices.insert( v2 );
-			insert_edge( seam_vertex_edges, v1, v2 );
-		}
-		for( int i = 0; i < foldovers.rows(); ++i ) {
-		    const int v1 = F( foldovers( i, 0 ),   foldovers( i, 1 ) );
-		    const int v2 = F( foldovers( i, 0 ), ( foldovers( i, 1 ) + 1 ) % 3 );
-			seam_vertex_indices.insert( v1 );
-			seam_vertex_indices.insert( v2 );
-			insert_edge( seam_vertex_edges, v1, v2 );
-			// The vertices on both sides should match:
-			assert( seam_vertex_indices.count( F( foldovers( i, 2 ),   foldovers( i, 3 ) ) ) );
-			assert( seam_vertex_indices.count( F( foldovers( i, 2 ), ( foldovers( i, 3 ) + 1 ) % 3 ) ) );
-		}
-	
-	    std::cout << "# seam vertices: " << seam_vertex_indices.size() << std::endl;		
-		std::cout << "# seam edges: " << count_seam_edge_num(seam_vertex_edges) << std::endl;
-
-        if( preserve_boundaries ) {
-            Eigen::MatrixXi E, EF, EI;
-            Eigen::VectorXi EMAP;
-            igl::edge_flaps(F, E, EMAP, EF, EI);
-            int boundary_edges_count = 0;
-            for(int i = 0; i < E.rows(); ++i) {
-                if(EF(i, 1) == -1) {
-                    const int v1 = E(i, 0);
-                    const int v2 = E(i, 1);
-                    seam_vertex_indices.insert(v1);
-                    seam_vertex_indices.insert(v2);
-                    insert_edge(seam_vertex_edges, v1, v2);
-                    boundary_edges_count++;
-                }
-            }
-            std::cout << "# boundary edges added: " << boundary_edges_count << std::endl;
-            std::cout << "# seam+boundary vertices: " << seam_vertex_indices.size() << std::endl;		
-            std::cout << "# seam+boundary edges: " << count_seam_edge_num(seam_vertex_edges) << std::endl;
-        }
+    insert_edges_of_kind( topology, ANY_SEAM_EDGE, seam_vertex_edges );
+    out << "# seam vertices: " << seam_vertex_edges.size() << std::endl;
+    out << "# seam edges: " << count_seam_edge_num(seam_vertex_edges) << std::endl;
+    if( preserve_boundaries ) {
+        const int boundary_edges_count = insert_edges_of_kind( topology, MESH_BOUNDARY_EDGE, seam_vertex_edges );
+        out << "# boundary edges added: " << boundary_edges_count << std::endl;
+        out << "# seam+boundary vertices: " << seam_vertex_edges.size() << std::endl;
+        out << "# seam+boundary edges: " << count_seam_edge_num(seam_vertex_edges) << std::endl;
     }
+    seam_detection_timer.stop();
   
     // Compute the per-vertex quadric error metric.
     std::vector< Eigen::MatrixXd > Q;
     bool success = false;
     Eigen::VectorXi J;
     
-	MapV5d hash_Q;
-	half_edge_qslim_5d(V,F,TC,FT,pos_scale, uv_weight, hash_Q);
-	std::cout << "computing initial metrics finished\n" << std::endl;
+	QuadricStore hash_Q;
+	{
+		PhaseTimer quadrics_timer( QUADRICS_PHASE );
+		if( normal_weight > 0 && CN.rows() > 0 && FN.rows() == F.rows() ) {
+			half_edge_qslim_8d(V,F,TC,FT,CN,FN,pos_scale, uv_weight, normal_weight, hash_Q, face_weights);
+			out << "# normals carried through the quadrics: " << CN.rows() << std::endl;
+		}
+		else {
+			if( normal_weight > 0 ) out << "WARNING: The input has no normals to carry through the quadrics." << std::endl;
+			half_edge_qslim_5d(V,F,TC,FT,pos_scale, uv_weight, hash_Q, face_weights);
+		}
+	}
+	out << "computing initial metrics finished\n" << std::endl;
 	success = decimate_halfedge_5d(
 		V, F,
 		TC, FT,
@@ -199,11 +329,91 @@ bool decimate_down_to(
 		preserve_boundaries,
 		pos_scale,
 		uv_weight,
-		max_error
+		max_error,
+		options,
+		&stats,
+		lods,
+		log,
+		nullptr,
+		&topology,
+		&CN_out,
+		&FN_out
 		);
-	std::cout << "#seams after decimation: " << count_seam_edge_num(seam_vertex_edges) << std::endl;
+	out << "#seams after decimation: " << count_seam_edge_num(seam_vertex_edges) << std::endl;
+	out << "# cost evaluations: " << stats.cost_evaluations;
+	if( options.lazy_updates ) out << " (" << stats.saved_evaluations << " saved by lazy updates)";
+	out << std::endl;
+	if( stats.reached_max_error ) out << "Stopped at " << V_out.rows() << " vertices: the next collapse would exceed the maximum error." << std::endl;
+	if( stats.heap_allocations >= 0 ) out << "# heap allocations while collapsing: " << stats.heap_allocations << std::endl;
     return success;
 }
+
+/*
+Decimates every job of a batch manifest, several at a time: each job reads,
+decimates and writes its own mesh, so the I/O of some jobs overlaps the
+decimation of others. Jobs are handed to threads one at a time as threads
+become free, so a few large meshes don't hold up the rest. The messages of
+each job are printed together once it is done. With verify_samples > 0, each
+output is measured against its input with measure_decimation_quality().
+Returns the number of jobs that failed.
+*/
+int decimate_batch(
+    const std::vector< BatchJob >& jobs,
+    bool preserve_boundaries,
+    const DecimationOptions& options,
+    double normal_weight,
+    int max_cluster_faces,
+    int verify_samples,
+    bool print_hash
+    )
+{
+    std::mutex print_mutex;
+    std::vector< char > failed( jobs.size(), 0 );
+    parallel_for( int( jobs.size() ), [&]( const int j )
+    {
+        const BatchJob& job = jobs[j];
+        std::ostringstream out;
+        const auto & fail = [&]( const std::string& message )
+        {
+            out << "ERROR: " << message << std::endl;
+            failed[j] = 1;
+        };
+        Eigen::MatrixXd V, TC, CN, V_out, TC_out, CN_out;
+        Eigen::MatrixXi F, FT, FN, F_out, FT_out, FN_out;
+        if( !read_mesh( job.input_path, V, TC, CN, F, FT, FN ) ) fail( "Could not read mesh: " + job.input_path );
+        else if( F.cols() != 3 || TC.rows() == 0 || FT.rows() != F.rows() ) fail( "Not a triangle mesh with texture coordinates: " + job.input_path );
+        else {
+            out << "Loaded a mesh with " << V.rows() << " vertices and " << F.rows() << " faces: " << job.input_path << std::endl;
+            const int target_num_vertices = job.target_for( V.rows() );
+            double final_error = 0.0;
+            if( target_num_vertices <= 0 ) fail( "Target number of vertices must be a positive integer." );
+            else if( target_num_vertices >= V.rows() ) {
+                out << "The target of " << target_num_vertices << " vertices isn't below the input's, copying it." << std::endl;
+                V_out = V; F_out = F; TC_out = TC; FT_out = FT; CN_out = CN; FN_out = FN;
+            }
+            else {
+                DecimationStats stats;
+                if( !decimate_down_to( V, F, TC, FT, CN, FN, target_num_vertices, V_out, F_out, TC_out, FT_out, CN_out, FN_out, job.seam_aware_degree, preserve_boundaries, job.uv_weight, normal_weight, nullptr, final_error, options,
+                        nullptr, nullptr, max_cluster_faces, stats, out ) ) {
+                    out << "WARNING: decimate_down_to() returned false (target number of vertices may have been unachievable)." << std::endl;
+                }
+            }
+            if( !failed[j] && verify_samples > 0 ) {
+                DecimationQuality quality;
+                measure_decimation_quality( V, F, TC, FT, V_out, F_out, TC_out, FT_out, verify_samples, quality );
+                print_quality( quality, out );
+            }
+            if( !failed[j] ) {
+                if( !write_mesh( job.output_path, V_out, F_out, CN_out, FN_out, TC_out, FT_out ) ) fail( "Could not write mesh: " + job.output_path );
+                else out << "Wrote: " << job.output_path << std::endl;
+                if( !failed[j] && print_hash ) out << hash_line( job.output_path, V_out, F_out, CN_out, FN_out, TC_out, FT_out ) << std::endl;
+            }
+        }
+        std::lock_guard< std::mutex > lock( print_mutex );
+        std::cout << "[" << ( j + 1 ) << "/" << jobs.size() << "] line " << job.line << ": " << job.input_path << std::endl << out.str() << std::endl;
+    }, 1 );
+    return int( std::count( failed.begin(), failed.end(), 1 ) );
+}
 }
 
 int main( int argc, char* argv[] ) {
@@ -217,16 +427,101 @@ int main( int argc, char* argv[] ) {
 	std::string uv_weight_str = "1.0";
 	pythonlike::get_optional_parameter(args, "--uv-weight", uv_weight_str);
 	const double uv_weight = pythonlike::strto<double>(uv_weight_str);
+	std::string normal_weight_str = "0";
+	pythonlike::get_optional_parameter(args, "--normal-weight", normal_weight_str);
+	const double normal_weight = pythonlike::strto<double>(normal_weight_str);
+	std::string weights_path;
+	pythonlike::get_optional_parameter(args, "--weights", weights_path);
+	std::string threads_str;
+	if( pythonlike::get_optional_parameter(args, "--threads", threads_str) ) {
+		set_num_threads( pythonlike::strto<int>(threads_str) );
+	}
     bool preserve_boundaries = false;
+    bool print_hash = false;
+    DecimationOptions options;
+	std::string collapse_log_path;
+	pythonlike::get_optional_parameter(args, "--collapse-log", collapse_log_path);
+	std::string stats_path;
+	pythonlike::get_optional_parameter(args, "--stats", stats_path);
+	std::string trace_path;
+	pythonlike::get_optional_parameter(args, "--trace", trace_path);
+	std::string trace_min_str = "0";
+	pythonlike::get_optional_parameter(args, "--trace-min-us", trace_min_str);
+	if( !trace_path.empty() && !tracing_enabled() ) {
+		std::cerr << "ERROR: --trace needs a build with DECIMATE_TRACING=ON." << std::endl;
+		usage( argv[0] );
+	}
+	std::string min_vertices_str = "1";
+	pythonlike::get_optional_parameter(args, "--min-vertices", min_vertices_str);
+	std::string cluster_faces_str = "0";
+	pythonlike::get_optional_parameter(args, "--cluster-faces", cluster_faces_str);
+	const int max_cluster_faces = pythonlike::strto<int>(cluster_faces_str);
+	std::string verify_str = "0";
+	const bool verify = pythonlike::get_optional_parameter(args, "--verify", verify_str);
+	const int verify_samples = pythonlike::strto<int>(verify_str);
+	if( verify && verify_samples <= 0 ) {
+		std::cerr << "ERROR: --verify needs a positive number of samples: " << verify_str << std::endl;
+		usage( argv[0] );
+	}
+	std::string batch_str;
+	if( pythonlike::get_optional_parameter(args, "--batch", batch_str) ) {
+		options.batch_size = pythonlike::strto<int>(batch_str);
+	}
+	std::string batch_tolerance_str;
+	if( pythonlike::get_optional_parameter(args, "--batch-tolerance", batch_tolerance_str) ) {
+		options.batch_tolerance = pythonlike::strto<double>(batch_tolerance_str);
+	}
+	std::string compact_str;
+	if( pythonlike::get_optional_parameter(args, "--compact", compact_str) ) {
+		options.compaction_threshold = pythonlike::strto<double>(compact_str);
+	}
     for (auto it = args.begin(); it != args.end(); ) {
         if (*it == "--preserve-boundaries") {
             preserve_boundaries = true;
             it = args.erase(it);
+        } else if (*it == "--lazy") {
+            options.lazy_updates = true;
+            it = args.erase(it);
+        } else if (*it == "--cache-uv-orientations") {
+            options.cache_uv_orientations = true;
+            it = args.erase(it);
+        } else if (*it == "--float-quadrics") {
+            options.single_precision_quadrics = true;
+            it = args.erase(it);
+        } else if (*it == "--reorder") {
+            options.spatial_order = true;
+            it = args.erase(it);
+        } else if (*it == "--restore-order") {
+            options.restore_input_order = true;
+            it = args.erase(it);
+        } else if (*it == "--stable-ties") {
+            options.stable_ties = true;
+            it = args.erase(it);
+        } else if (*it == "--hash") {
+            print_hash = true;
+            it = args.erase(it);
         } else {
             ++it;
         }
     }
     
+    if( args.size() == 2 && args[0] == "batch" ) {
+        if( !collapse_log_path.empty() || !stats_path.empty() || !weights_path.empty() || ( normal_weight > 0 && max_cluster_faces > 0 ) ) {
+            std::cerr << "ERROR: batch doesn't support --collapse-log, --stats, --weights or --normal-weight with --cluster-faces." << std::endl;
+            usage( argv[0] );
+        }
+        std::vector< BatchJob > jobs;
+        std::string error;
+        if( !read_batch_manifest( args[1], jobs, error ) ) {
+            std::cerr << "ERROR: " << error << std::endl;
+            usage( argv[0] );
+        }
+        if( !trace_path.empty() ) start_tracing( pythonlike::strto<double>(trace_min_str)*1e-6 );
+        const int num_failed = decimate_batch( jobs, preserve_boundaries, options, normal_weight, max_cluster_faces, verify_samples, print_hash );
+        write_trace( trace_path );
+        std::cout << "Decimated " << ( jobs.size() - num_failed ) << " of " << jobs.size() << " meshes." << std::endl;
+        return num_failed ? -1 : 0;
+    }
     if( args.size() != 3 && args.size() != 4 )	usage( argv[0] );
     std::string input_path, command, command_parameter;
     pythonlike::unpack( args.begin(), input_path, command, command_parameter );
@@ -235,8 +530,8 @@ int main( int argc, char* argv[] ) {
     // Does the input path exist?
     Eigen::MatrixXd V, TC, CN;
     Eigen::MatrixXi F, FT, FN;
-    if( !igl::readOBJ( input_path, V, TC, CN, F, FT, FN ) ) {
-        std::cerr << "ERROR: Could not read OBJ: " << input_path << std::endl;
+    if( !read_mesh( input_path, V, TC, CN, F, FT, FN ) ) {
+        std::cerr << "ERROR: Could not read mesh: " << input_path << std::endl;
         usage( argv[0] );
     }
 
@@ -244,7 +539,8 @@ int main( int argc, char* argv[] ) {
     
     // Get the target number of vertices.
     int target_num_vertices = 0;
-    if( command == "num-vertices" ) {
+    std::vector< int > lod_targets;
+    if( command == "num-vertices" || command == "replay" ) {
         // strto<> returns 0 upon failure, which is fine, since that is invalid input for us.
         target_num_vertices = pythonlike::strto< int >( command_parameter );
     }
@@ -255,20 +551,76 @@ int main( int argc, char* argv[] ) {
         // Ugh, printf() requires me to specify the types of integers versus longs.
         // printf( "%.2f%% of %d input vertices is %d output vertices.", percent, V.rows(), target_num_vertices );
     }
+    else if( command == "max-error" ) {
+        options.max_error = pythonlike::strto< double >( command_parameter );
+        if( !( options.max_error >= 0 ) ) {
+            std::cerr << "ERROR: The maximum error must be a non-negative number: " << command_parameter << std::endl;
+            usage( argv[0] );
+        }
+        target_num_vertices = pythonlike::strto< int >( min_vertices_str );
+    }
+    else if( command == "lods" ) {
+        std::string targets_str = command_parameter;
+        std::replace( targets_str.begin(), targets_str.end(), ',', ' ' );
+        lod_targets = pythonlike::strtovec< int >( targets_str );
+        if( lod_targets.empty() ) {
+            std::cerr << "ERROR: Expected a comma-separated list of vertex counts: " << command_parameter << std::endl;
+            usage( argv[0] );
+        }
+        for( auto target : lod_targets ) {
+            if( target <= 0 || target >= V.rows() ) {
+                std::cerr << "ERROR: Every level of detail must have a positive number of vertices smaller than the input's: " << target << std::endl;
+                usage( argv[0] );
+            }
+        }
+        target_num_vertices = *std::min_element( lod_targets.begin(), lod_targets.end() );
+        options.lod_targets = lod_targets;
+    }
     else {
         std::cerr << "ERROR: Unknown command: " << command << std::endl;
         usage( argv[0] );
     }
     
+    if( max_cluster_faces < 0 || ( max_cluster_faces > 0 && ( command == "lods" || command == "max-error" || !collapse_log_path.empty() || normal_weight > 0 || !weights_path.empty() ) ) ) {
+        std::cerr << "ERROR: --cluster-faces needs a positive number of faces, and doesn't support lods, max-error, --collapse-log, --normal-weight or --weights." << std::endl;
+        usage( argv[0] );
+    }
+    if( command == "replay" && normal_weight > 0 ) {
+        std::cerr << "ERROR: The collapse log has no normals to replay; drop --normal-weight." << std::endl;
+        usage( argv[0] );
+    }
+    if( command == "replay" && !weights_path.empty() ) {
+        std::cerr << "ERROR: A replay repeats the logged collapses, which the weights no longer change; drop --weights." << std::endl;
+        usage( argv[0] );
+    }
+    
+    // The importance weights, one per face.
+    Eigen::VectorXd face_weights;
+    if( !weights_path.empty() ) {
+        Eigen::VectorXd weights;
+        bool per_face = false;
+        if( !read_importance_weights( weights_path, weights, per_face ) ) {
+            std::cerr << "ERROR: Could not read importance weights: " << weights_path << std::endl;
+            usage( argv[0] );
+        }
+        if( weights.size() != ( per_face ? F.rows() : V.rows() ) ) {
+            std::cerr << "ERROR: The importance weights need one weight per " << ( per_face ? "face" : "vertex" ) << ": " << weights_path << std::endl;
+            return -1;
+        }
+        std::cout << "Loaded importance weights per " << ( per_face ? "face" : "vertex" ) << " from " << weights.minCoeff() << " to " << weights.maxCoeff() << ": " << weights_path << std::endl;
+        if( per_face ) face_weights.swap( weights );
+        else face_weights_from_vertices( F, weights, face_weights );
+    }
+    
     // Check that the target number of vertices is positive and fewer than the input number of vertices.
     if( target_num_vertices <= 0 ) {
         std::cerr << "ERROR: Target number of vertices must be a positive integer: " << argv[4] << std::endl;
         usage( argv[0] );
     }
     if( target_num_vertices >= V.rows() ) {
-    	std::string output_path = pythonlike::os_path_splitext( input_path ).first + "-decimated_to_" + std::to_string( V.rows() ) + "_vertices.obj";
-        if( !igl::writeOBJ( output_path, V, F, CN, FN, TC, FT ) ) {
-			std::cerr << "ERROR: Could not write OBJ: " << output_path << std::endl;
+    	std::string output_path = pythonlike::os_path_splitext( input_path ).first + "-decimated_to_" + std::to_string( V.rows() ) + "_vertices" + pythonlike::os_path_splitext( input_path ).second;
+        if( !write_mesh( output_path, V, F, CN, FN, TC, FT ) ) {
+			std::cerr << "ERROR: Could not write mesh: " << output_path << std::endl;
 			usage( argv[0] );
 		}
    		std::cout << "Wrote: " << output_path << std::endl;
@@ -290,25 +642,91 @@ int main( int argc, char* argv[] ) {
     Eigen::MatrixXd V_out, TC_out, CN_out;
     Eigen::MatrixXi F_out, FT_out, FN_out;
 	double final_error = 0.0;
-    const bool success = decimate_down_to( V, F, TC, FT, target_num_vertices, V_out, F_out, TC_out, FT_out, seam_aware_degree, preserve_boundaries, uv_weight, final_error );
-    if( !success ) {
-        std::cerr << "WARNING: decimate_down_to() returned false (target number of vertices may have been unachievable)." << std::endl;
-    }
-    
-    if ( !custom_output_path )
+    DecimationStats stats;
+    DecimationQuality quality;
+    reset_instrumentation();
+    if( !trace_path.empty() ) start_tracing( pythonlike::strto<double>(trace_min_str)*1e-6 );
+    // For lods, V_out is the level with the fewest vertices.
+    const auto & verify_output = [&]()
+    {
+        if( !verify ) return;
+        measure_decimation_quality( V, F, TC, FT, V_out, F_out, TC_out, FT_out, verify_samples, quality );
+        print_quality( quality, std::cout );
+    };
+    const auto & write_stats = [&]()
     {
-        std::stringstream error_ss;
-        error_ss << std::fixed << std::setprecision(6) << final_error;
-        output_path = pythonlike::os_path_splitext( input_path ).first + 
-                                  "-decimated_to_" + std::to_string( V_out.rows() ) + 
-                                  "_err_" + error_ss.str() + ".obj";
+        if( stats_path.empty() ) return;
+        if( !write_stats_json( stats_path, command, V, F, V_out, F_out, final_error, stats, verify ? &quality : nullptr ) ) {
+            std::cerr << "ERROR: Could not write stats: " << stats_path << std::endl;
+            usage( argv[0] );
+        }
+        std::cout << "Wrote: " << stats_path << std::endl;
+    };
+    if( command == "replay" ) {
+        if( collapse_log_path.empty() ) {
+            std::cerr << "ERROR: replay needs the --collapse-log of a previous run." << std::endl;
+            usage( argv[0] );
+        }
+        CollapseLog log;
+        if( !read_collapse_log( collapse_log_path, log ) ) {
+            std::cerr << "ERROR: Could not read collapse log: " << collapse_log_path << std::endl;
+            usage( argv[0] );
+        }
+        if( log.num_vertices != V.rows() || log.num_tcs != TC.rows() || log.num_faces != F.rows() ) {
+            std::cerr << "ERROR: The collapse log was recorded for a different mesh: " << collapse_log_path << std::endl;
+            return -1;
+        }
+        const int num_collapses = int( V.rows() ) - target_num_vertices;
+        if( num_collapses > int( log.records.size() ) ) {
+            std::cerr << "WARNING: The collapse log stops at " << ( V.rows() - log.records.size() ) << " vertices." << std::endl;
+        }
+        replay_collapse_log( log, num_collapses, V, F, TC, FT, V_out, F_out, TC_out, FT_out, final_error );
+        write_trace( trace_path );
+        verify_output();
+        write_stats();
     }
+    else {
+        CollapseLog log;
+        std::vector< DecimationSnapshot > lods;
+        const bool success = decimate_down_to( V, F, TC, FT, CN, FN, target_num_vertices, V_out, F_out, TC_out, FT_out, CN_out, FN_out, seam_aware_degree, preserve_boundaries, uv_weight, normal_weight, weights_path.empty() ? nullptr : &face_weights, final_error, options,
+            lod_targets.empty() ? nullptr : &lods, collapse_log_path.empty() ? nullptr : &log, max_cluster_faces, stats, std::cout );
+        if( !success ) {
+            std::cerr << "WARNING: decimate_down_to() returned false (target number of vertices may have been unachievable)." << std::endl;
+        }
+        write_trace( trace_path );
+        if( !collapse_log_path.empty() ) {
+            if( !write_collapse_log( collapse_log_path, log ) ) {
+                std::cerr << "ERROR: Could not write collapse log: " << collapse_log_path << std::endl;
+                usage( argv[0] );
+            }
+            std::cout << "Wrote: " << collapse_log_path << " (" << log.records.size() << " collapses)" << std::endl;
+        }
+        verify_output();
+        write_stats();
+        if( command == "lods" ) {
+            for( const auto & level : lods ) {
+                const std::string level_path = custom_output_path
+                    ? pythonlike::os_path_splitext( output_path ).first + "-" + std::to_string( level.target_num_vertices ) + pythonlike::os_path_splitext( output_path ).second
+                    : default_output_path( input_path, level.V.rows(), level.max_geometric_error );
+                if( !write_mesh( level_path, level.V, level.F, level.CN, level.FN, level.TC, level.FT ) ) {
+                    std::cerr << "ERROR: Could not write mesh: " << level_path << std::endl;
+                    usage( argv[0] );
+                }
+                std::cout << "Wrote: " << level_path << std::endl;
+                if( print_hash ) std::cout << hash_line( level_path, level.V, level.F, level.CN, level.FN, level.TC, level.FT ) << std::endl;
+            }
+            return 0;
+        }
+    }
+    
+    if ( !custom_output_path ) output_path = default_output_path( input_path, V_out.rows(), final_error );
 
-    if( !igl::writeOBJ( output_path, V_out, F_out, CN_out, FN_out, TC_out, FT_out ) ) {
-        std::cerr << "ERROR: Could not write OBJ: " << output_path << std::endl;
+    if( !write_mesh( output_path, V_out, F_out, CN_out, FN_out, TC_out, FT_out ) ) {
+        std::cerr << "ERROR: Could not write mesh: " << output_path << std::endl;
         usage( argv[0] );
     }
     std::cout << "Wrote: " << output_path << std::endl;
+    if( print_hash ) std::cout << hash_line( output_path, V_out, F_out, CN_out, FN_out, TC_out, FT_out ) << std::endl;
     
     return 0;
 }
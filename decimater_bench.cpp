@@ -0,0 +1,498 @@
+// Benchmarks of the stages of the decimation on procedurally generated
+// UV-mapped meshes (see procedural_mesh.h) from 10K faces up, with seams and
+// boundaries (atlas), seams only (torus) and a boundary only (plane).
+//
+// usage: decimater_bench [--max_faces=N] [--thresholds=path] [benchmark flags]
+//
+// Meshes have 10K, 100K, 1M, ... faces up to --max_faces (default 1M; the
+// benchmarks go up to 10M). The shuffled-* meshes are the same with their rows
+// in random order, like some exported meshes, to compare decimating them with
+// and without DecimationOptions::spatial_order (the .../reordered runs). The
+// decimate_quality benchmarks decimate with double and single precision
+// quadrics, reporting the distances of measure_decimation_quality() too. The
+// write_mesh benchmarks write the mesh as an OBJ with igl::writeOBJ() and
+// write_obj_parallel(), and as a glTF binary. Every benchmark reports
+// peak_rss_mb, the largest resident set size while it ran, and the ones that
+// collapse edges report collapses_per_second. Use the usual Google Benchmark
+// flags to select and record them, e.g.
+//     decimater_bench --benchmark_filter=decimate/atlas --benchmark_out=run.json --benchmark_out_format=json
+//
+// A thresholds file has lines
+//     <benchmark name> <counter> >= <value>
+//     <benchmark name> <counter> <= <value>
+// and blank lines or lines starting with '#'. The program returns 1 if a
+// benchmark that ran doesn't meet one of them, e.g.
+//     decimate/atlas/100000/10 collapses_per_second >= 200000
+//     decimate/atlas/100000/10 peak_rss_mb <= 300
+
+#include <benchmark/benchmark.h>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <igl/writeOBJ.h>
+
+#include "decimate.h"
+#include "collapse_edge_seam.h"
+#include "cost_and_placement.h"
+#include "quadric_error_metric.h"
+#include "procedural_mesh.h"
+#include "mesh_order.h"
+#include "decimation_quality.h"
+#include "mesh_io.h"
+
+namespace {
+	const int SEAM_AWARE_DEGREE = 2;
+	const double UV_WEIGHT = 1.0;
+	// Edges evaluated per iteration by the cost_and_placement benchmarks.
+	const int MAX_EVALUATED_EDGES = 4096;
+
+	// Resets the peak resident set size if the system allows it (Linux does
+	// through /proc/self/clear_refs), so that peak_rss_mb() is the peak since.
+	// Otherwise peak_rss_mb() stays the peak of the whole process.
+	void reset_peak_rss()
+	{
+		FILE * clear_refs = fopen( "/proc/self/clear_refs", "w" );
+		if( !clear_refs ) return;
+		fputs( "5", clear_refs );
+		fclose( clear_refs );
+	}
+
+	double peak_rss_mb()
+	{
+		std::ifstream status( "/proc/self/status" );
+		std::string line;
+		while( std::getline( status, line ) ) {
+			if( line.compare( 0, 6, "VmHWM:" ) == 0 ) return atof( line.c_str() + 6 )/1024.0;
+		}
+		struct rusage usage;
+		getrusage( RUSAGE_SELF, &usage );
+		return usage.ru_maxrss/1024.0;
+	}
+
+	// A generated mesh with what the decimater computes before decimating.
+	struct BenchMesh
+	{
+		ProceduralMeshKind kind = NUM_PROCEDURAL_MESH_KINDS;
+		int num_faces = 0;
+		bool shuffled = false;
+		Eigen::MatrixXd V, TC;
+		Eigen::MatrixXi F, FT;
+		double pos_scale = 1.0;
+		// The seam, boundary and foldover edges, as the decimater finds them.
+		EdgeMap seam_edges;
+		QuadricStore Vmetrics;
+	};
+
+	// The most recently used mesh. The benchmarks of a mesh are registered
+	// one after the other, so that each mesh is only generated once.
+	const BenchMesh & bench_mesh( ProceduralMeshKind kind, int num_faces, bool shuffled = false )
+	{
+		static BenchMesh mesh;
+		if( mesh.kind == kind && mesh.num_faces == num_faces && mesh.shuffled == shuffled ) return mesh;
+		mesh = BenchMesh();
+		mesh.kind = kind;
+		mesh.num_faces = num_faces;
+		mesh.shuffled = shuffled;
+		make_procedural_mesh( kind, num_faces, mesh.V, mesh.TC, mesh.F, mesh.FT );
+		if( shuffled ) {
+			// Fisher-Yates with a fixed seed, so that the order is always the same.
+			std::mt19937 random( 1 );
+			const auto & shuffle = [&]( std::vector< int > & order, int n )
+			{
+				order.resize( n );
+				for( int i = 0; i < n; ++i ) order[i] = i;
+				for( int i = n - 1; i > 0; --i ) std::swap( order[i], order[ random() % ( i + 1 ) ] );
+			};
+			MeshOrder order;
+			shuffle( order.vertices, int( mesh.V.rows() ) );
+			shuffle( order.tcs, int( mesh.TC.rows() ) );
+			shuffle( order.faces, int( mesh.F.rows() ) );
+			const Eigen::MatrixXd V = mesh.V, TC = mesh.TC;
+			const Eigen::MatrixXi F = mesh.F, FT = mesh.FT;
+			reorder_mesh( order, V, F, TC, FT, mesh.V, mesh.F, mesh.TC, mesh.FT );
+		}
+
+		// Same scaling as the decimater.
+		double total_area = 0.0;
+		for( int i = 0; i < mesh.F.rows(); ++i ) {
+			const Eigen::Vector3d v0 = mesh.V.row(mesh.F(i,0));
+			const Eigen::Vector3d v1 = mesh.V.row(mesh.F(i,1));
+			const Eigen::Vector3d v2 = mesh.V.row(mesh.F(i,2));
+			total_area += 0.5*((v1 - v0).cross(v2 - v0)).norm();
+		}
+		const double avg_area = mesh.F.rows() > 0 ? total_area/mesh.F.rows() : 0.0;
+		mesh.pos_scale = avg_area > 1e-12 ? sqrt(1.0/avg_area) : 1.0;
+
+		find_seam_edges( mesh.V, mesh.TC, mesh.F, mesh.FT, mesh.seam_edges );
+		half_edge_qslim_5d( mesh.V, mesh.F, mesh.TC, mesh.FT, mesh.pos_scale, UV_WEIGHT, mesh.Vmetrics );
+		return mesh;
+	}
+
+	// Everything collapse_one_edge() works on.
+	struct CollapseState
+	{
+		Eigen::MatrixXd V, TC;
+		Eigen::MatrixXi F, FT;
+		Eigen::VectorXi EMAP;
+		Eigen::MatrixXi E, EF, EI;
+		PriorityQueue Q;
+		std::vector< placement_info_5d > C;
+		SeamFlags seams;
+		EdgeMap seam_edges;
+		QuadricStore Vmetrics;
+		LazyEdgeUpdates lazy;
+		DecimationWorkspace workspace;
+		int target_num_vertices = 0;
+		int remain_vertices = 0;
+		int prev_e = -1;
+
+		// Copies the seam edges and quadrics of mesh, which prepare() changes.
+		void copy_inputs( const BenchMesh & mesh )
+		{
+			seam_edges = mesh.seam_edges;
+			Vmetrics = mesh.Vmetrics;
+		}
+		// Prepares mesh for collapsing it down to target, after copy_inputs().
+		void prepare( const BenchMesh & mesh, int target )
+		{
+			target_num_vertices = target;
+			prepare_decimate_halfedge_5d( mesh.V, mesh.F, mesh.TC, mesh.FT, seam_edges, Vmetrics, target_num_vertices, SEAM_AWARE_DEGREE, false,
+				mesh.pos_scale, UV_WEIGHT, std::vector< int >(), V, F, TC, FT, EMAP, E, EF, EI, Q, C, seams );
+			lazy = LazyEdgeUpdates();
+			remain_vertices = V.rows();
+			prev_e = -1;
+		}
+		bool collapse( const BenchMesh & mesh )
+		{
+			if( remain_vertices <= target_num_vertices ) return false;
+			if( !collapse_one_edge( V, F, TC, FT, EMAP, E, EF, EI, seams, Vmetrics, SEAM_AWARE_DEGREE, Q, C, lazy, prev_e, false,
+				mesh.pos_scale, UV_WEIGHT, std::numeric_limits< double >::infinity(), workspace, nullptr ) ) return false;
+			--remain_vertices;
+			return true;
+		}
+		// Whether e can be collapsed, i.e. doesn't end at the vertex at infinity.
+		bool is_finite_edge( int e ) const
+		{
+			const double inf = std::numeric_limits< double >::infinity();
+			return V.row( E(e,0) ).minCoeff() != inf && V.row( E(e,1) ).minCoeff() != inf;
+		}
+	};
+
+	void report_peak_rss( benchmark::State & state )
+	{
+		state.counters["peak_rss_mb"] = peak_rss_mb();
+	}
+
+	void BM_half_edge_qslim_5d( benchmark::State & state, ProceduralMeshKind kind, int num_faces )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces );
+		reset_peak_rss();
+		for( auto _ : state ) {
+			QuadricStore Vmetrics;
+			half_edge_qslim_5d( mesh.V, mesh.F, mesh.TC, mesh.FT, mesh.pos_scale, UV_WEIGHT, Vmetrics );
+			benchmark::DoNotOptimize( Vmetrics );
+		}
+		state.SetItemsProcessed( state.iterations()*mesh.F.rows() );
+		report_peak_rss( state );
+	}
+
+	enum MeshWriter { IGL_OBJ_WRITER, PARALLEL_OBJ_WRITER, GLB_WRITER };
+
+	// Writes the mesh to a temporary file in the working directory.
+	void BM_write_mesh( benchmark::State & state, ProceduralMeshKind kind, int num_faces, MeshWriter writer )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces );
+		const std::string path = "decimater_bench_" + std::to_string( getpid() ) + ( writer == GLB_WRITER ? ".glb" : ".obj" );
+		const Eigen::MatrixXd CN;
+		const Eigen::MatrixXi FN;
+		reset_peak_rss();
+		for( auto _ : state ) {
+			const bool written =
+				writer == IGL_OBJ_WRITER ? igl::writeOBJ( path, mesh.V, mesh.F, CN, FN, mesh.TC, mesh.FT ) :
+				writer == PARALLEL_OBJ_WRITER ? write_obj_parallel( path, mesh.V, mesh.F, CN, FN, mesh.TC, mesh.FT ) :
+				write_glb( path, mesh.V, mesh.F, CN, FN, mesh.TC, mesh.FT );
+			if( !written ) {
+				state.SkipWithError( "Couldn't write the mesh" );
+				break;
+			}
+		}
+		std::remove( path.c_str() );
+		state.SetItemsProcessed( state.iterations()*mesh.F.rows() );
+		report_peak_rss( state );
+	}
+
+	void BM_prepare_decimate_halfedge_5d( benchmark::State & state, ProceduralMeshKind kind, int num_faces )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces );
+		reset_peak_rss();
+		CollapseState collapse_state;
+		for( auto _ : state ) {
+			state.PauseTiming();
+			collapse_state.copy_inputs( mesh );
+			state.ResumeTiming();
+			collapse_state.prepare( mesh, 1 );
+			benchmark::DoNotOptimize( collapse_state.C.data() );
+		}
+		report_peak_rss( state );
+	}
+
+	// One collapse per iteration, preparing the mesh again, untimed, whenever
+	// half of its vertices have been collapsed.
+	void BM_collapse_one_edge( benchmark::State & state, ProceduralMeshKind kind, int num_faces )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces );
+		reset_peak_rss();
+		CollapseState collapse_state;
+		collapse_state.copy_inputs( mesh );
+		collapse_state.prepare( mesh, mesh.V.rows()/2 );
+		for( auto _ : state ) {
+			if( !collapse_state.collapse( mesh ) ) {
+				state.PauseTiming();
+				collapse_state.copy_inputs( mesh );
+				collapse_state.prepare( mesh, mesh.V.rows()/2 );
+				state.ResumeTiming();
+				if( !collapse_state.collapse( mesh ) ) {
+					state.SkipWithError( "No edge can be collapsed" );
+					break;
+				}
+			}
+		}
+		state.counters["collapses_per_second"] = benchmark::Counter( double( state.iterations() ), benchmark::Counter::kIsRate );
+		report_peak_rss( state );
+	}
+
+	// Evaluates the first MAX_EVALUATED_EDGES edges on seams, or away from
+	// them, per iteration.
+	void BM_cost_and_placement_qslim5d_halfedge( benchmark::State & state, ProceduralMeshKind kind, int num_faces, bool on_seam )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces );
+		reset_peak_rss();
+		CollapseState collapse_state;
+		collapse_state.copy_inputs( mesh );
+		collapse_state.prepare( mesh, 1 );
+		const CollapseState & s = collapse_state;
+		std::vector< int > edges;
+		std::vector< Bundle > bundles;
+		for( int e = 0; e < s.E.rows() && int( edges.size() ) < MAX_EVALUATED_EDGES; ++e ) {
+			if( !s.is_finite_edge( e ) ) continue;
+			const bool seam_edge = s.seams.is_seam_edge( e );
+			const bool interior_edge = !s.seams.is_seam_vertex( s.E(e,0) ) && !s.seams.is_seam_vertex( s.E(e,1) );
+			if( on_seam ? !seam_edge : !interior_edge ) continue;
+			edges.push_back( e );
+			bundles.push_back( get_half_edge_bundle( e, s.E, s.EF, s.EI, s.F, s.FT ) );
+		}
+		if( edges.empty() ) {
+			state.SkipWithError( "The mesh has no such edges" );
+			return;
+		}
+		placement_info_5d placement;
+		for( auto _ : state ) {
+			for( size_t i = 0; i < edges.size(); ++i ) {
+				double cost;
+				cost_and_placement_qslim5d_halfedge( edges[i], bundles[i], s.V, s.F, s.TC, s.FT, s.seams, s.Vmetrics,
+					SEAM_AWARE_DEGREE, mesh.pos_scale, UV_WEIGHT, cost, placement );
+				benchmark::DoNotOptimize( cost );
+			}
+		}
+		state.SetItemsProcessed( state.iterations()*edges.size() );
+		report_peak_rss( state );
+	}
+
+	void BM_decimate_halfedge_5d( benchmark::State & state, ProceduralMeshKind kind, int num_faces, int percent, bool shuffled, bool spatial_order )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces, shuffled );
+		DecimationOptions options;
+		options.spatial_order = spatial_order;
+		reset_peak_rss();
+		const int target_num_vertices = std::max( 1, int( lround( percent*mesh.V.rows()/100.0 ) ) );
+		long long collapses = 0;
+		for( auto _ : state ) {
+			state.PauseTiming();
+			EdgeMap seam_edges = mesh.seam_edges;
+			QuadricStore Vmetrics = mesh.Vmetrics;
+			state.ResumeTiming();
+			Eigen::MatrixXd V_out, TC_out;
+			Eigen::MatrixXi F_out, FT_out;
+			double max_error = 0.0;
+			decimate_halfedge_5d( mesh.V, mesh.F, mesh.TC, mesh.FT, seam_edges, Vmetrics, target_num_vertices, SEAM_AWARE_DEGREE,
+				V_out, F_out, TC_out, FT_out, false, mesh.pos_scale, UV_WEIGHT, max_error, options );
+			collapses += mesh.V.rows() - V_out.rows();
+		}
+		state.counters["collapses_per_second"] = benchmark::Counter( double( collapses ), benchmark::Counter::kIsRate );
+		report_peak_rss( state );
+	}
+
+	// Decimates to 10% with double or single precision quadrics. Also reports
+	// the largest geometric error and, measured untimed on the last output, the
+	// Hausdorff and RMS distances to the input and the UV seam distance.
+	void BM_decimation_quality( benchmark::State & state, ProceduralMeshKind kind, int num_faces, bool single_precision )
+	{
+		const BenchMesh & mesh = bench_mesh( kind, num_faces );
+		reset_peak_rss();
+		const int target_num_vertices = std::max( 1, int( lround( 0.1*mesh.V.rows() ) ) );
+		DecimationOptions options;
+		options.single_precision_quadrics = single_precision;
+		Eigen::MatrixXd V_out, TC_out;
+		Eigen::MatrixXi F_out, FT_out;
+		double max_error = 0.0;
+		long long collapses = 0;
+		for( auto _ : state ) {
+			state.PauseTiming();
+			EdgeMap seam_edges = mesh.seam_edges;
+			QuadricStore Vmetrics = mesh.Vmetrics;
+			state.ResumeTiming();
+			decimate_halfedge_5d( mesh.V, mesh.F, mesh.TC, mesh.FT, seam_edges, Vmetrics, target_num_vertices, SEAM_AWARE_DEGREE,
+				V_out, F_out, TC_out, FT_out, false, mesh.pos_scale, UV_WEIGHT, max_error, options );
+			collapses += mesh.V.rows() - V_out.rows();
+		}
+		state.counters["collapses_per_second"] = benchmark::Counter( double( collapses ), benchmark::Counter::kIsRate );
+		report_peak_rss( state );
+		DecimationQuality quality;
+		measure_decimation_quality( mesh.V, mesh.F, mesh.TC, mesh.FT, V_out, F_out, TC_out, FT_out, int( mesh.F.rows() ), quality );
+		state.counters["max_error"] = max_error;
+		state.counters["hausdorff"] = quality.hausdorff();
+		state.counters["rms"] = std::max( quality.input_to_output_rms, quality.output_to_input_rms );
+		state.counters["seam_uv_max"] = quality.seam_uv_max;
+	}
+
+	struct Threshold
+	{
+		std::string benchmark;
+		std::string counter;
+		bool at_least;
+		double value;
+	};
+
+	bool read_thresholds( const std::string & path, std::vector< Threshold > & thresholds )
+	{
+		std::ifstream in( path );
+		if( !in ) return false;
+		std::string line;
+		while( std::getline( in, line ) ) {
+			if( line.empty() || line[0] == '#' ) continue;
+			std::istringstream fields( line );
+			Threshold threshold;
+			std::string comparison;
+			if( !( fields >> threshold.benchmark >> threshold.counter >> comparison >> threshold.value ) ) return false;
+			if( comparison != ">=" && comparison != "<=" ) return false;
+			threshold.at_least = comparison == ">=";
+			thresholds.push_back( threshold );
+		}
+		return true;
+	}
+
+	// The console output, checking each benchmark against the thresholds.
+	class ThresholdReporter : public benchmark::ConsoleReporter
+	{
+	public:
+		explicit ThresholdReporter( const std::vector< Threshold > & thresholds ) : thresholds( thresholds ), failures( 0 ) {}
+
+		void ReportRuns( const std::vector< Run > & runs ) override
+		{
+			ConsoleReporter::ReportRuns( runs );
+			for( const auto & run : runs ) {
+				for( const auto & threshold : thresholds ) {
+					if( run.benchmark_name() != threshold.benchmark ) continue;
+					const auto counter = run.counters.find( threshold.counter );
+					const bool met = counter != run.counters.end() && !run.error_occurred
+						&& ( threshold.at_least ? counter->second.value >= threshold.value : counter->second.value <= threshold.value );
+					if( met ) continue;
+					++failures;
+					std::cerr << "REGRESSION: " << threshold.benchmark << " " << threshold.counter << " is "
+						<< ( counter == run.counters.end() ? std::string( "missing" ) : std::to_string( counter->second.value ) )
+						<< ", expected " << ( threshold.at_least ? ">= " : "<= " ) << threshold.value << std::endl;
+				}
+			}
+		}
+
+		int num_failures() const { return failures; }
+
+	private:
+		std::vector< Threshold > thresholds;
+		int failures;
+	};
+
+	void register_benchmarks( int max_faces )
+	{
+		for( int num_faces = 10000; num_faces <= max_faces && num_faces <= 10000000; num_faces *= 10 ) {
+			for( int k = 0; k < NUM_PROCEDURAL_MESH_KINDS; ++k ) {
+				const ProceduralMeshKind kind = ProceduralMeshKind( k );
+				const std::string mesh_name = std::string( procedural_mesh_name( kind ) ) + "/" + std::to_string( num_faces );
+				benchmark::RegisterBenchmark( ( "half_edge_qslim_5d/" + mesh_name ).c_str(), BM_half_edge_qslim_5d, kind, num_faces )
+					->Unit( benchmark::kMillisecond );
+				benchmark::RegisterBenchmark( ( "prepare_decimate_halfedge_5d/" + mesh_name ).c_str(), BM_prepare_decimate_halfedge_5d, kind, num_faces )
+					->Unit( benchmark::kMillisecond );
+				benchmark::RegisterBenchmark( ( "collapse_one_edge/" + mesh_name ).c_str(), BM_collapse_one_edge, kind, num_faces )
+					->Unit( benchmark::kMicrosecond );
+				benchmark::RegisterBenchmark( ( "cost_and_placement/interior/" + mesh_name ).c_str(), BM_cost_and_placement_qslim5d_halfedge, kind, num_faces, false )
+					->Unit( benchmark::kMicrosecond );
+				if( kind != PLANE_MESH ) {
+					benchmark::RegisterBenchmark( ( "cost_and_placement/seam/" + mesh_name ).c_str(), BM_cost_and_placement_qslim5d_halfedge, kind, num_faces, true )
+						->Unit( benchmark::kMicrosecond );
+				}
+				const int percents[3] = { 50, 10, 1 };
+				for( auto percent : percents ) {
+					benchmark::RegisterBenchmark( ( "decimate/" + mesh_name + "/" + std::to_string( percent ) ).c_str(), BM_decimate_halfedge_5d, kind, num_faces, percent, false, false )
+						->Unit( benchmark::kMillisecond );
+				}
+				benchmark::RegisterBenchmark( ( "decimate_quality/" + mesh_name + "/double" ).c_str(), BM_decimation_quality, kind, num_faces, false )
+					->Unit( benchmark::kMillisecond );
+				benchmark::RegisterBenchmark( ( "decimate_quality/" + mesh_name + "/float" ).c_str(), BM_decimation_quality, kind, num_faces, true )
+					->Unit( benchmark::kMillisecond );
+				const char * writer_names[3] = { "igl", "parallel", "glb" };
+				for( int w = 0; w < 3; ++w ) {
+					benchmark::RegisterBenchmark( ( "write_mesh/" + mesh_name + "/" + writer_names[w] ).c_str(), BM_write_mesh, kind, num_faces, MeshWriter( w ) )
+						->Unit( benchmark::kMillisecond );
+				}
+				// After the benchmarks of the mesh in order, which share it.
+				const std::string shuffled_name = "decimate/shuffled-" + mesh_name + "/10";
+				benchmark::RegisterBenchmark( shuffled_name.c_str(), BM_decimate_halfedge_5d, kind, num_faces, 10, true, false )
+					->Unit( benchmark::kMillisecond );
+				benchmark::RegisterBenchmark( ( shuffled_name + "/reordered" ).c_str(), BM_decimate_halfedge_5d, kind, num_faces, 10, true, true )
+					->Unit( benchmark::kMillisecond );
+			}
+		}
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	int max_faces = 1000000;
+	std::string thresholds_path;
+	// Take our own flags out before Google Benchmark sees them.
+	int kept = 1;
+	for( int i = 1; i < argc; ++i ) {
+		if( strncmp( argv[i], "--max_faces=", 12 ) == 0 ) max_faces = atoi( argv[i] + 12 );
+		else if( strncmp( argv[i], "--thresholds=", 13 ) == 0 ) thresholds_path = argv[i] + 13;
+		else argv[kept++] = argv[i];
+	}
+	argc = kept;
+
+	std::vector< Threshold > thresholds;
+	if( !thresholds_path.empty() && !read_thresholds( thresholds_path, thresholds ) ) {
+		std::cerr << "Error: Couldn't read the thresholds: " << thresholds_path << std::endl;
+		return -1;
+	}
+
+	register_benchmarks( max_faces );
+	benchmark::Initialize( &argc, argv );
+	if( benchmark::ReportUnrecognizedArguments( argc, argv ) ) return -1;
+	ThresholdReporter reporter( thresholds );
+	benchmark::RunSpecifiedBenchmarks( &reporter );
+	benchmark::Shutdown();
+	return reporter.num_failures() > 0 ? 1 : 0;
+}
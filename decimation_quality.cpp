@@ -0,0 +1,205 @@
+#include "decimation_quality.h"
+#include "edge_topology.h"
+#include "instrumentation.h"
+#include "parallel_for.h"
+#include <igl/AABB.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	// Splits num_samples over items of the given sizes in proportion to them,
+	// rounding the running total so that the counts add up exactly. The
+	// samples of item i are [offsets[i]..offsets[i+1]).
+	void spread_samples( const std::vector< double > & sizes, int num_samples, std::vector< int > & offsets )
+	{
+		double total = 0.0;
+		for( auto size : sizes ) total += size;
+		offsets.assign( sizes.size() + 1, 0 );
+		double running = 0.0;
+		for( int i = 0; i < int( sizes.size() ); ++i ) {
+			running += sizes[i];
+			offsets[i+1] = total > 0 ? int( std::floor( running / total * num_samples ) ) : 0;
+		}
+		if( total > 0 ) offsets.back() = num_samples;
+	}
+
+	// The fractional part of the R2 low-discrepancy sequence at index j, so
+	// that the samples of a face or segment spread out evenly.
+	void r2_point( int j, double & u, double & v )
+	{
+		const double a1 = 0.7548776662466927, a2 = 0.5698402909980532;
+		u = std::fmod( 0.5 + a1*j, 1.0 );
+		v = std::fmod( 0.5 + a2*j, 1.0 );
+	}
+
+	// The referenced vertices of (V,F) followed by num_samples points on its
+	// faces.
+	void sample_surface( const Eigen::MatrixXd & V, const Eigen::MatrixXi & F, int num_samples, Eigen::MatrixXd & P )
+	{
+		std::vector< char > referenced( V.rows(), 0 );
+		for( int f = 0; f < F.rows(); ++f ) {
+			for( int k = 0; k < 3; ++k ) referenced[ F(f,k) ] = 1;
+		}
+		const int num_vertices = int( std::count( referenced.begin(), referenced.end(), 1 ) );
+
+		std::vector< double > areas( F.rows() );
+		for( int f = 0; f < F.rows(); ++f ) {
+			const Eigen::RowVector3d a = V.row(F(f,0)), b = V.row(F(f,1)), c = V.row(F(f,2));
+			areas[f] = ( b - a ).cross( c - a ).norm();
+		}
+		std::vector< int > offsets;
+		spread_samples( areas, num_samples, offsets );
+
+		P.resize( num_vertices + offsets.back(), 3 );
+		int row = 0;
+		for( int v = 0; v < V.rows(); ++v ) {
+			if( referenced[v] ) P.row( row++ ) = V.row(v);
+		}
+		parallel_for( int( F.rows() ), [&]( const int f )
+		{
+			for( int j = offsets[f]; j < offsets[f+1]; ++j ) {
+				double u, v;
+				r2_point( j - offsets[f], u, v );
+				// Fold the unit square onto the triangle.
+				if( u + v > 1 ) {
+					u = 1 - u;
+					v = 1 - v;
+				}
+				P.row( num_vertices + j ) = ( 1 - u - v )*V.row(F(f,0)) + u*V.row(F(f,1)) + v*V.row(F(f,2));
+			}
+		} );
+	}
+
+	// The chart boundaries of (F,TC,FT) as pairs of rows of TC: the sides of
+	// the UV seam and mesh boundary edges.
+	void chart_boundaries( const Eigen::MatrixXi & F, const Eigen::MatrixXd & TC, const Eigen::MatrixXi & FT, int num_vertices, Eigen::MatrixXi & S )
+	{
+		EdgeTopology topology;
+		build_edge_topology( F, TC, FT, num_vertices, topology );
+		std::vector< std::pair< int, int > > segments;
+		for( int e = 0; e < topology.E.rows(); ++e ) {
+			if( !( topology.kind[e] & ( UV_SEAM_EDGE | MESH_BOUNDARY_EDGE ) ) ) continue;
+			for( int side = 0; side < 2; ++side ) {
+				const int f = topology.EF(e,side), k = topology.EI(e,side);
+				// Faces at infinity have no texture coordinates.
+				if( f < 0 || f >= F.rows() ) continue;
+				const int a = FT(f,(k+1)%3), b = FT(f,(k+2)%3);
+				segments.push_back( std::make_pair( std::min( a, b ), std::max( a, b ) ) );
+			}
+		}
+		std::sort( segments.begin(), segments.end() );
+		segments.erase( std::unique( segments.begin(), segments.end() ), segments.end() );
+		S.resize( segments.size(), 2 );
+		for( int i = 0; i < int( segments.size() ); ++i ) S.row(i) << segments[i].first, segments[i].second;
+	}
+
+	// The end points of the segments S of TC followed by num_samples points
+	// along them.
+	void sample_segments( const Eigen::MatrixXd & TC, const Eigen::MatrixXi & S, int num_samples, Eigen::MatrixXd & P )
+	{
+		std::vector< char > referenced( TC.rows(), 0 );
+		for( int i = 0; i < S.rows(); ++i ) referenced[ S(i,0) ] = referenced[ S(i,1) ] = 1;
+		const int num_ends = int( std::count( referenced.begin(), referenced.end(), 1 ) );
+
+		std::vector< double > lengths( S.rows() );
+		for( int i = 0; i < S.rows(); ++i ) lengths[i] = ( TC.row(S(i,1)) - TC.row(S(i,0)) ).norm();
+		std::vector< int > offsets;
+		spread_samples( lengths, S.rows() ? num_samples : 0, offsets );
+
+		P.resize( num_ends + offsets.back(), 2 );
+		int row = 0;
+		for( int t = 0; t < TC.rows(); ++t ) {
+			if( referenced[t] ) P.row( row++ ) = TC.row(t);
+		}
+		for( int i = 0; i < S.rows(); ++i ) {
+			const int n = offsets[i+1] - offsets[i];
+			for( int j = 0; j < n; ++j ) {
+				const double t = ( j + 0.5 ) / n;
+				P.row( num_ends + offsets[i] + j ) = ( 1 - t )*TC.row(S(i,0)) + t*TC.row(S(i,1));
+			}
+		}
+	}
+
+	// The squared distances from the rows of P to the elements Ele of V, in
+	// parallel.
+	template < int DIM >
+	void squared_distances( const Eigen::MatrixXd & V, const Eigen::MatrixXi & Ele, const Eigen::MatrixXd & P, std::vector< double > & distances )
+	{
+		distances.assign( P.rows(), 0.0 );
+		if( Ele.rows() == 0 ) return;
+		igl::AABB< Eigen::MatrixXd, DIM > tree;
+		tree.init( V, Ele );
+		parallel_for( int( P.rows() ), [&]( const int i )
+		{
+			const Eigen::Matrix< double, 1, DIM > p = P.row(i);
+			Eigen::Matrix< double, 1, DIM > c;
+			int element = -1;
+			distances[i] = tree.squared_distance( V, Ele, p, element, c );
+		} );
+	}
+
+	// Adds the squared distances to the largest distance and the sum of
+	// squares, in order, so that the result doesn't depend on the threads.
+	void accumulate( const std::vector< double > & distances, double & max_distance, double & sum_of_squares )
+	{
+		for( auto d : distances ) {
+			max_distance = std::max( max_distance, std::sqrt( d ) );
+			sum_of_squares += d;
+		}
+	}
+}
+
+void measure_decimation_quality(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const Eigen::MatrixXd & V_out,
+	const Eigen::MatrixXi & F_out,
+	const Eigen::MatrixXd & TC_out,
+	const Eigen::MatrixXi & FT_out,
+	int num_samples,
+	DecimationQuality & quality )
+{
+	PhaseTimer verification_timer( VERIFICATION_PHASE );
+	quality = DecimationQuality();
+	std::vector< double > distances;
+
+	Eigen::MatrixXd P;
+	double sum = 0.0;
+	sample_surface( V, F, num_samples, P );
+	squared_distances< 3 >( V_out, F_out, P, distances );
+	accumulate( distances, quality.input_to_output_max, sum );
+	quality.input_to_output_rms = P.rows() ? std::sqrt( sum / P.rows() ) : 0.0;
+	quality.num_surface_samples += P.rows();
+
+	sum = 0.0;
+	sample_surface( V_out, F_out, num_samples, P );
+	squared_distances< 3 >( V, F, P, distances );
+	accumulate( distances, quality.output_to_input_max, sum );
+	quality.output_to_input_rms = P.rows() ? std::sqrt( sum / P.rows() ) : 0.0;
+	quality.num_surface_samples += P.rows();
+
+	Eigen::MatrixXi S, S_out;
+	chart_boundaries( F, TC, FT, V.rows(), S );
+	chart_boundaries( F_out, TC_out, FT_out, V_out.rows(), S_out );
+	if( ( S.rows() == 0 ) != ( S_out.rows() == 0 ) ) {
+		quality.seam_uv_max = quality.seam_uv_rms = std::numeric_limits< double >::infinity();
+		return;
+	}
+	sum = 0.0;
+	sample_segments( TC, S, num_samples, P );
+	squared_distances< 2 >( TC_out, S_out, P, distances );
+	accumulate( distances, quality.seam_uv_max, sum );
+	quality.num_seam_samples += P.rows();
+	sample_segments( TC_out, S_out, num_samples, P );
+	squared_distances< 2 >( TC, S, P, distances );
+	accumulate( distances, quality.seam_uv_max, sum );
+	quality.num_seam_samples += P.rows();
+	quality.seam_uv_rms = quality.num_seam_samples ? std::sqrt( sum / quality.num_seam_samples ) : 0.0;
+}
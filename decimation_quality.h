@@ -0,0 +1,51 @@
+#ifndef DECIMATION_QUALITY_H
+#define DECIMATION_QUALITY_H
+
+#include <Eigen/Core>
+
+// How far a decimated mesh is from its input, measured independently of the
+// queue costs behind max_error: points are sampled on each mesh, and each
+// sample is matched with its closest point on the other mesh, looked up in an
+// igl::AABB of that mesh.
+struct DecimationQuality
+{
+	// Distances from the samples of the input to the output, and from the
+	// samples of the output to the input, in the units of V: the largest one,
+	// a one-sided Hausdorff distance, and the root mean square.
+	double input_to_output_max = 0.0;
+	double input_to_output_rms = 0.0;
+	double output_to_input_max = 0.0;
+	double output_to_input_rms = 0.0;
+	// The same in UV space between the chart boundaries, i.e. the UV seam and
+	// mesh boundary edges, of the two meshes, in both directions together. 0
+	// if neither mesh has any, infinite if only one of them has.
+	double seam_uv_max = 0.0;
+	double seam_uv_rms = 0.0;
+	// The number of samples on both surfaces, and on both sets of chart
+	// boundaries.
+	int num_surface_samples = 0;
+	int num_seam_samples = 0;
+
+	// The two-sided Hausdorff distance between the surfaces.
+	double hausdorff() const { return input_to_output_max > output_to_input_max ? input_to_output_max : output_to_input_max; }
+};
+
+// Measures (V_out,F_out,TC_out,FT_out) against (V,F,TC,FT). Each surface gets
+// its vertices and num_samples points spread over its faces by area, and each
+// set of chart boundaries its end points and num_samples points spread by UV
+// length, so that the time grows with num_samples and the largest distances
+// are found more reliably. The samples are deterministic and queried in
+// parallel, so the result doesn't depend on the number of threads.
+void measure_decimation_quality(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const Eigen::MatrixXd & V_out,
+	const Eigen::MatrixXi & F_out,
+	const Eigen::MatrixXd & TC_out,
+	const Eigen::MatrixXi & FT_out,
+	int num_samples,
+	DecimationQuality & quality );
+
+#endif
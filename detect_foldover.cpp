@@ -1,33 +1,109 @@
 #include "detect_foldover.h"
+#include "parallel_for.h"
+#include <cassert>
+#include <cmath>
+#include <limits>
 #include <vector>
 
-// judge if p1, p2 on the same side of the straight line pass through uv1, uv2
-bool two_points_on_same_side(
-	const Eigen::RowVectorXd uv1,
-	const Eigen::RowVectorXd uv2,
-	const Eigen::RowVectorXd p1,
-	const Eigen::RowVectorXd p2)
+namespace
 {
-	assert( uv1.size() == 2 );
-	assert( uv2.size() == 2 );
-	assert( p1.size() == 2 );
-	assert( p2.size() == 2 );
-	
-	if( uv1 == uv2 )	return true;
-	if( uv1(0) == uv2(0) ) {
-		if( (uv1(0) - p1(0))*(uv1(0) - p2(0)) <= 0 ) {
-			return false;
-		}	
+	// a + b = x + y exactly.
+	inline void two_sum( const double a, const double b, double & x, double & y )
+	{
+		x = a + b;
+		const double b_virtual = x - a;
+		y = ( a - ( x - b_virtual ) ) + ( b - b_virtual );
 	}
-	else {
-		double k = (uv2(1)-uv1(1))/(uv2(0)-uv1(0));
-		double b = uv1(1)-uv1(0)*k;
-		if( (p1(0)*k+b-p1(1)) * (p2(0)*k+b-p2(1)) <= 0 ) {
-			return false;
+
+	// a*b = x + y exactly.
+	inline void two_product( const double a, const double b, double & x, double & y )
+	{
+		x = a * b;
+		y = std::fma( a, b, -x );
+	}
+
+	// Adds b to the nonoverlapping expansion e[0..n), sorted by increasing
+	// magnitude, as in Shewchuk's Grow-Expansion. Zeros are kept, so the
+	// expansion grows by one.
+	inline int grow_expansion( double * e, const int n, const double b )
+	{
+		double q = b;
+		for( int i = 0; i < n; ++i ) two_sum( q, e[i], q, e[i] );
+		e[n] = q;
+		return n + 1;
+	}
+
+	// The sign of (b-a)x(c-a), expanded into six products of the coordinates
+	// so that nothing is rounded, as the largest nonzero component.
+	double exact_orientation(
+		const Eigen::RowVector2d & a,
+		const Eigen::RowVector2d & b,
+		const Eigen::RowVector2d & c)
+	{
+		const double terms[6][2] = {
+			{ b(0), c(1) }, { -b(0), a(1) }, { -a(0), c(1) },
+			{ -b(1), c(0) }, { b(1), a(0) }, { a(1), c(0) } };
+		double e[12];
+		int n = 0;
+		for( int i = 0; i < 6; ++i ) {
+			double x, y;
+			two_product( terms[i][0], terms[i][1], x, y );
+			n = grow_expansion( e, n, y );
+			n = grow_expansion( e, n, x );
 		}
+		while( n > 0 && e[n-1] == 0 ) --n;
+		return n > 0 ? e[n-1] : 0.0;
 	}
-	
-	return true;
+}
+
+double uv_orientation(
+	const Eigen::RowVector2d & a,
+	const Eigen::RowVector2d & b,
+	const Eigen::RowVector2d & c)
+{
+	const double left = ( b(0) - a(0) )*( c(1) - a(1) );
+	const double right = ( b(1) - a(1) )*( c(0) - a(0) );
+	const double det = left - right;
+	// Shewchuk's error bound for the rounded determinant: beyond it, the sign
+	// is right. A non-finite det comes from the texture coordinate at infinity.
+	const double epsilon = std::numeric_limits<double>::epsilon() / 2;
+	const double error_bound = ( 3 + 16*epsilon )*epsilon*( std::abs( left ) + std::abs( right ) );
+	if( std::abs( det ) > error_bound || !std::isfinite( det ) ) return det;
+	return exact_orientation( a, b, c );
+}
+
+double face_uv_orientation(
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const int f)
+{
+	int k = 0;
+	if( FT(f,1) < FT(f,k) ) k = 1;
+	if( FT(f,2) < FT(f,k) ) k = 2;
+	return uv_orientation( TC.row(FT(f,k)), TC.row(FT(f,(k+1)%3)), TC.row(FT(f,(k+2)%3)) );
+}
+
+bool on_same_side_as_corner(
+	const double orientation,
+	const Eigen::RowVector2d & uv1,
+	const Eigen::RowVector2d & uv2,
+	const Eigen::RowVector2d & p)
+{
+	if( uv1 == uv2 )	return true;
+	const double o = uv_orientation( uv1, uv2, p );
+	// uv1 or uv2 at infinity.
+	if( !std::isfinite( o ) )	return true;
+	return ( orientation > 0 && o > 0 ) || ( orientation < 0 && o < 0 );
+}
+
+// judge if p1, p2 on the same side of the straight line pass through uv1, uv2
+bool two_points_on_same_side(
+	const Eigen::RowVector2d & uv1,
+	const Eigen::RowVector2d & uv2,
+	const Eigen::RowVector2d & p1,
+	const Eigen::RowVector2d & p2)
+{
+	return on_same_side_as_corner( uv_orientation( uv1, uv2, p1 ), uv1, uv2, p2 );
 }
 
 bool try_attach_to_seam(
@@ -99,11 +175,26 @@ bool try_attach_to_seam(
 	// in UV space, return false
 	assert( boundary.size() > 2 );
 	for( int i=1; i<boundary.size()-1; i++ ) {
-		RowVectorXd uv1 = TC.row(FT(boundary[i].first,(boundary[i].second+1)%3));
-		RowVectorXd uv2 = TC.row(FT(boundary[i].first,(boundary[i].second+2)%3));
+		const RowVector2d uv1 = TC.row(FT(boundary[i].first,(boundary[i].second+1)%3));
+		const RowVector2d uv2 = TC.row(FT(boundary[i].first,(boundary[i].second+2)%3));
 		if( !two_points_on_same_side(uv1, uv2, TC.row(ti), TC.row(tj)) )
 			return false;
 	}
 	
 	return true;
-}
\ No newline at end of file
+}
+
+void FaceUVOrientations::compute(const Eigen::MatrixXd & TC, const Eigen::MatrixXi & FT)
+{
+	values.resize( FT.rows() );
+	parallel_for( int( FT.rows() ), [&]( const int f ) { values[f] = face_uv_orientation( TC, FT, f ); } );
+}
+
+void FaceUVOrientations::update(const Eigen::MatrixXd & TC, const Eigen::MatrixXi & FT, const int * faces, int n)
+{
+	for( int i = 0; i < n; ++i ) {
+		const int f = faces[i];
+		// Deleted faces have FT(f,:) = -1.
+		if( FT(f,0) != -1 ) values[f] = face_uv_orientation( TC, FT, f );
+	}
+}
@@ -2,12 +2,40 @@
 #define DETECT_FOLDOVER_H
 
 #include <Eigen/Core>
+#include <vector>
 
+// Twice the signed area of the triangle (a,b,c), positive if it turns
+// counterclockwise. The sign is exact: when rounding could flip it, it is
+// recomputed with exact arithmetic, so that collinear points give 0.
+double uv_orientation(
+	const Eigen::RowVector2d & a,
+	const Eigen::RowVector2d & b,
+	const Eigen::RowVector2d & c);
+
+// uv_orientation() of the texture coordinates of face f, starting from the
+// corner with the smallest index in FT, so that it comes out the same
+// whichever corner the caller starts from.
+double face_uv_orientation(
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	const int f);
+
+// Whether p is strictly on the same side of the line through uv1, uv2 as the
+// third corner c of a triangle with uv_orientation(uv1,uv2,c) of the sign of
+// orientation. Like two_points_on_same_side(), it is true if uv1 == uv2 or if
+// either is the texture coordinate at infinity.
+bool on_same_side_as_corner(
+	const double orientation,
+	const Eigen::RowVector2d & uv1,
+	const Eigen::RowVector2d & uv2,
+	const Eigen::RowVector2d & p);
+
+// judge if p1, p2 on the same side of the straight line pass through uv1, uv2
 bool two_points_on_same_side(
-	const Eigen::RowVectorXd uv1,
-	const Eigen::RowVectorXd uv2,
-	const Eigen::RowVectorXd p1,
-	const Eigen::RowVectorXd p2);
+	const Eigen::RowVector2d & uv1,
+	const Eigen::RowVector2d & uv2,
+	const Eigen::RowVector2d & p1,
+	const Eigen::RowVector2d & p2);
 	
 bool try_attach_to_seam(
 	const int e, 
@@ -23,5 +51,20 @@ bool try_attach_to_seam(
 	const Eigen::MatrixXd & TC,
 	const Eigen::MatrixXi & FT
 );
-	
+
+// face_uv_orientation() of every face, so that the fold-over test of
+// check_collapse_5d_edge() only computes the orientation of the new texture
+// coordinate. collapse_connectivity_5d_edge() recomputes the faces around the
+// collapsed edge, the only ones whose texture coordinates it changes.
+struct FaceUVOrientations
+{
+	bool enabled = false;
+	std::vector<double> values;
+
+	// Fills values for every face of FT.
+	void compute(const Eigen::MatrixXd & TC, const Eigen::MatrixXi & FT);
+	// Recomputes values for faces[0..n), skipping deleted faces.
+	void update(const Eigen::MatrixXd & TC, const Eigen::MatrixXi & FT, const int * faces, int n);
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include "edge_queue.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// Number of children per heap node. A 4-ary heap is shallower than a binary
+	// one and its children share a cache line.
+	const int ARITY = 4;
+}
+
+void IndexedHeapQueue::resize( int n )
+{
+	heap.clear();
+	heap.reserve( n );
+	pos.assign( n, -1 );
+	if( tie_key ) ties.assign( n, 0 );
+}
+
+void IndexedHeapQueue::set_tie_key( const TieKey & key )
+{
+	tie_key = key;
+	if( tie_key ) ties.assign( pos.size(), 0 );
+	else std::vector< uint64_t >().swap( ties );
+}
+
+void IndexedHeapQueue::place( int i, const Entry & entry )
+{
+	heap[i] = entry;
+	pos[entry.second] = i;
+}
+
+void IndexedHeapQueue::sift_up( int i )
+{
+	const Entry entry = heap[i];
+	while( i > 0 ) {
+		const int parent = ( i - 1 ) / ARITY;
+		if( !less( entry, heap[parent] ) ) break;
+		place( i, heap[parent] );
+		i = parent;
+	}
+	place( i, entry );
+}
+
+void IndexedHeapQueue::sift_down( int i )
+{
+	const int n = int( heap.size() );
+	const Entry entry = heap[i];
+	while( true ) {
+		const int first = ARITY*i + 1;
+		if( first >= n ) break;
+		const int last = std::min( first + ARITY, n );
+		int best = first;
+		for( int c = first + 1; c < last; ++c ) {
+			if( less( heap[c], heap[best] ) ) best = c;
+		}
+		if( !less( heap[best], entry ) ) break;
+		place( i, heap[best] );
+		i = best;
+	}
+	place( i, entry );
+}
+
+void IndexedHeapQueue::pop()
+{
+	assert( !heap.empty() );
+	DECIMATE_COUNT( QUEUE_POPS );
+	remove( heap.front().second );
+}
+
+void IndexedHeapQueue::update( int e, double cost )
+{
+	DECIMATE_COUNT( QUEUE_UPDATES );
+	assert( e >= 0 && e < int( pos.size() ) );
+	const Entry entry( cost, e );
+	const uint64_t tie = tie_key ? tie_key( e ) : 0;
+	if( pos[e] == -1 ) {
+		if( tie_key ) ties[e] = tie;
+		heap.push_back( entry );
+		pos[e] = int( heap.size() ) - 1;
+		sift_up( pos[e] );
+		return;
+	}
+	const int i = pos[e];
+	// Against the key the entry was placed with.
+	const bool decreased = cost < heap[i].first || ( cost == heap[i].first && tie_key && tie < ties[e] );
+	if( tie_key ) ties[e] = tie;
+	heap[i] = entry;
+	if( decreased ) sift_up( i );
+	else            sift_down( i );
+}
+
+void IndexedHeapQueue::erase( int e )
+{
+	DECIMATE_COUNT( QUEUE_ERASES );
+	remove( e );
+}
+
+void IndexedHeapQueue::remove( int e )
+{
+	const int i = pos[e];
+	if( i == -1 ) return;
+	pos[e] = -1;
+	const Entry back = heap.back();
+	heap.pop_back();
+	if( i == int( heap.size() ) ) return;
+	// Move the last entry into the hole and restore the heap property.
+	const bool decreased = less( back, heap[i] );
+	place( i, back );
+	if( decreased ) sift_up( i );
+	else            sift_down( i );
+}
+
+void IndexedHeapQueue::build( const std::vector< double > & cost )
+{
+	DECIMATE_COUNT( QUEUE_BUILDS );
+	const int n = int( cost.size() );
+	heap.resize( n );
+	pos.resize( n );
+	if( tie_key ) ties.resize( n );
+	for( int e = 0; e < n; ++e ) {
+		heap[e] = Entry( cost[e], e );
+		pos[e] = e;
+		if( tie_key ) ties[e] = tie_key( e );
+	}
+	if( n < 2 ) return;
+	for( int i = ( n - 2 ) / ARITY; i >= 0; --i ) sift_down( i );
+}
+
+void IndexedHeapQueue::rename( const std::vector< int > & new_ids, int num_edges )
+{
+	pos.assign( num_edges, -1 );
+	std::vector< uint64_t > renamed_ties( tie_key ? num_edges : 0, 0 );
+	for( int i = 0; i < int( heap.size() ); ++i ) {
+		assert( new_ids[ heap[i].second ] >= 0 && new_ids[ heap[i].second ] < num_edges );
+		if( tie_key ) renamed_ties[ new_ids[ heap[i].second ] ] = ties[ heap[i].second ];
+		heap[i].second = new_ids[ heap[i].second ];
+		pos[ heap[i].second ] = i;
+	}
+	ties.swap( renamed_ties );
+}
+
+void SetQueue::resize( int n )
+{
+	Q.clear();
+	Qit.assign( n, Q.end() );
+}
+
+void SetQueue::pop()
+{
+	assert( !Q.empty() );
+	DECIMATE_COUNT( QUEUE_POPS );
+	const int e = std::get<2>( *Q.begin() );
+	Q.erase( Q.begin() );
+	Qit[e] = Q.end();
+}
+
+void SetQueue::update( int e, double cost )
+{
+	DECIMATE_COUNT( QUEUE_UPDATES );
+	remove( e );
+	Qit[e] = Q.insert( key( cost, e ) ).first;
+}
+
+void SetQueue::erase( int e )
+{
+	DECIMATE_COUNT( QUEUE_ERASES );
+	remove( e );
+}
+
+void SetQueue::remove( int e )
+{
+	if( Qit[e] == Q.end() ) return;
+	Q.erase( Qit[e] );
+	Qit[e] = Q.end();
+}
+
+void SetQueue::build( const std::vector< double > & cost )
+{
+	DECIMATE_COUNT( QUEUE_BUILDS );
+	const int n = int( cost.size() );
+	std::vector< Key > entries( n );
+	for( int e = 0; e < n; ++e ) entries[e] = key( cost[e], e );
+	std::sort( entries.begin(), entries.end() );
+	// Sorted input with an end() hint inserts in amortized constant time.
+	resize( n );
+	for( const auto & entry : entries ) Qit[ std::get<2>( entry ) ] = Q.insert( Q.end(), entry );
+}
+
+void SetQueue::rename( const std::vector< int > & new_ids, int num_edges )
+{
+	std::vector< Key > entries( Q.begin(), Q.end() );
+	resize( num_edges );
+	for( auto & entry : entries ) {
+		int & e = std::get<2>( entry );
+		assert( new_ids[e] >= 0 && new_ids[e] < num_edges );
+		e = new_ids[e];
+		Qit[e] = Q.insert( Q.end(), entry );
+	}
+}
@@ -0,0 +1,128 @@
+#ifndef EDGE_QUEUE_H
+#define EDGE_QUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <utility>
+
+// Priority queues of edges keyed by collapse cost. Both queues hold at most one
+// entry per edge id and order entries by (cost, edge id), exactly like the
+// std::set< std::pair<double,int> > the decimater originally used, so that
+// either one produces the same collapse sequence.
+//
+// With a tie key (see set_tie_key()), equal costs are ordered by the key of
+// each edge first, and then by edge id. A key that doesn't depend on how the
+// mesh is numbered, e.g. one computed from the positions of the endpoints,
+// makes the order of equal-cost collapses independent of it too.
+//
+// The queue used by the decimater is selected at compile time with
+// DECIMATE_USE_SET_QUEUE (see the PriorityQueue typedef in decimate.h).
+
+// Indexed 4-ary min-heap. Keys live contiguously in one array and a position
+// table indexed by edge id allows changing or removing the key of any edge in
+// O(log n) without node allocations.
+class IndexedHeapQueue
+{
+public:
+	typedef std::pair<double,int> Entry;
+	typedef std::function< uint64_t( int ) > TieKey;
+
+	// Prepares the queue for edge ids in [0,n). The queue is emptied.
+	void resize( int n );
+
+	bool empty() const { return heap.empty(); }
+	int size() const { return int( heap.size() ); }
+	// Returns whether edge `e` currently has an entry.
+	bool contains( int e ) const { return pos[e] != -1; }
+	// Returns the cost of edge `e`, which must have an entry.
+	double cost( int e ) const { return heap[ pos[e] ].first; }
+
+	// Returns the (cost, edge) entry with smallest cost. The queue must not be empty.
+	const Entry & top() const { return heap.front(); }
+	// Removes the entry returned by top().
+	void pop();
+
+	// Inserts edge `e` with `cost`, or changes its cost if it is already present.
+	void update( int e, double cost );
+	// Removes edge `e` from the queue. Does nothing if it isn't present.
+	void erase( int e );
+
+	// Replaces the contents with one entry (cost[e], e) per edge. This is a
+	// linear-time heapify rather than #E insertions.
+	void build( const std::vector< double > & cost );
+	// Breaks ties between equal costs by key(e), which update() and build()
+	// evaluate whenever they give edge e an entry, so the key may change as
+	// the mesh does. An empty key breaks them by edge id only, and costs no
+	// memory. Set it before build().
+	void set_tie_key( const TieKey & key );
+	// Renames every edge e with an entry to new_ids[e], for edge ids in
+	// [0,num_edges) from then on. The renaming must keep the order of the
+	// edges with entries, as compacting the edges does, so that the heap stays
+	// valid as it is and the queue order doesn't change.
+	void rename( const std::vector< int > & new_ids, int num_edges );
+
+private:
+	bool less( const Entry & a, const Entry & b ) const
+	{
+		return a.first < b.first || ( a.first == b.first && tie_less( a.second, b.second ) );
+	}
+	bool tie_less( int a, int b ) const
+	{
+		if( !tie_key || ties[a] == ties[b] ) return a < b;
+		return ties[a] < ties[b];
+	}
+	// erase() without counting it, for pop().
+	void remove( int e );
+	void place( int i, const Entry & entry );
+	void sift_up( int i );
+	void sift_down( int i );
+
+	std::vector< Entry > heap;
+	// pos[e] is the index of edge e in heap, or -1.
+	std::vector< int > pos;
+	TieKey tie_key;
+	// ties[e] is the key of edge e when it got its entry, if there is a key.
+	std::vector< uint64_t > ties;
+};
+
+// The original red-black tree queue, kept for A/B comparisons. Qit[e] is the
+// iterator of edge e in Q, or Q.end().
+class SetQueue
+{
+public:
+	typedef std::pair<double,int> Entry;
+	typedef std::function< uint64_t( int ) > TieKey;
+
+	void resize( int n );
+
+	bool empty() const { return Q.empty(); }
+	int size() const { return int( Q.size() ); }
+	bool contains( int e ) const { return Qit[e] != Q.end(); }
+	double cost( int e ) const { return std::get<0>( *Qit[e] ); }
+
+	Entry top() const { return Entry( std::get<0>( *Q.begin() ), std::get<2>( *Q.begin() ) ); }
+	void pop();
+
+	void update( int e, double cost );
+	void erase( int e );
+
+	void build( const std::vector< double > & cost );
+	void set_tie_key( const TieKey & key ) { tie_key = key; }
+	void rename( const std::vector< int > & new_ids, int num_edges );
+
+private:
+	// (cost, tie, edge id)
+	typedef std::tuple< double, uint64_t, int > Key;
+	Key key( double cost, int e ) const { return Key( cost, tie_key ? tie_key( e ) : 0, e ); }
+	// erase() without counting it, for update().
+	void remove( int e );
+
+	std::set< Key > Q;
+	std::vector< std::set< Key >::iterator > Qit;
+	TieKey tie_key;
+};
+
+#endif
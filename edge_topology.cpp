@@ -0,0 +1,193 @@
+#include "edge_topology.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// A half-edge in the bucket of its smaller vertex: the larger vertex, and
+	// h = k*#F+f for the edge opposite corner k of face f.
+	struct BucketEntry
+	{
+		int other;
+		int h;
+		bool operator<( const BucketEntry & o ) const { return other < o.other || ( other == o.other && h < o.h ); }
+	};
+
+	double uv_orientation( const Eigen::MatrixXd & TC, int a, int b, int c )
+	{
+		return ( TC(b,0) - TC(a,0) )*( TC(c,1) - TC(a,1) ) - ( TC(b,1) - TC(a,1) )*( TC(c,0) - TC(a,0) );
+	}
+
+	// The EdgeKind of the edge with half-edges (f,k) and (g,j) of opposite
+	// orientations, where (f,k) is the half-edge from corner k to corner k+1
+	// of face f, as igl::seam_edges() classifies it.
+	unsigned char classify_pair( const Eigen::MatrixXd & TC, const Eigen::MatrixXi & FT, int f, int k, int g, int j )
+	{
+		if( g < f || ( g == f && j < k ) ) {
+			std::swap( f, g );
+			std::swap( k, j );
+		}
+		if( FT(f,k) != FT(g,(j+1)%3) || FT(f,(k+1)%3) != FT(g,j) ) return UV_SEAM_EDGE;
+		const double o1 = uv_orientation( TC, FT(f,k), FT(f,(k+1)%3), FT(f,(k+2)%3) );
+		const double o2 = uv_orientation( TC, FT(f,k), FT(f,(k+1)%3), FT(g,(j+2)%3) );
+		return ( o1 > 0 ) == ( o2 > 0 ) ? UV_FOLDOVER_EDGE : 0;
+	}
+}
+
+void build_edge_topology(
+	const Eigen::MatrixXi & OF,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & OFT,
+	int num_vertices,
+	EdgeTopology & topology )
+{
+	const int m = OF.rows();
+	const int inf = num_vertices;
+
+	// Bucket the half-edges by their smaller vertex, then sort each bucket by
+	// the other vertex: the edges come out in the order of igl::edge_flaps().
+	std::vector< int > bucket_offsets( num_vertices + 1, 0 );
+	for( int k = 0; k < 3; ++k ) {
+		for( int f = 0; f < m; ++f ) ++bucket_offsets[ std::min( OF(f,(k+1)%3), OF(f,(k+2)%3) ) + 1 ];
+	}
+	for( int v = 0; v < num_vertices; ++v ) bucket_offsets[v+1] += bucket_offsets[v];
+	std::vector< BucketEntry > entries( 3*m );
+	{
+		std::vector< int > cursor( bucket_offsets.begin(), bucket_offsets.end() - 1 );
+		for( int k = 0; k < 3; ++k ) {
+			for( int f = 0; f < m; ++f ) {
+				const int a = OF(f,(k+1)%3), b = OF(f,(k+2)%3);
+				entries[ cursor[ std::min( a, b ) ]++ ] = BucketEntry{ std::max( a, b ), k*m + f };
+			}
+		}
+	}
+	// The number of edges in each bucket, and the half-edges on the boundary.
+	std::vector< int > edge_offsets( num_vertices + 1, 0 );
+	std::vector< char > boundary_half_edge( 3*m, 0 );
+	parallel_for( num_vertices, [&]( const int v )
+	{
+		const auto begin = entries.begin() + bucket_offsets[v], end = entries.begin() + bucket_offsets[v+1];
+		std::sort( begin, end );
+		int num_edges = 0;
+		for( auto it = begin; it != end; ) {
+			auto next = it + 1;
+			while( next != end && next->other == it->other ) ++next;
+			if( next - it == 1 ) boundary_half_edge[ it->h ] = 1;
+			++num_edges;
+			it = next;
+		}
+		edge_offsets[v+1] = num_edges;
+	} );
+
+	// One face at infinity per boundary half-edge, in the order of
+	// igl::connect_boundary_to_infinity(), and one edge to infinity per
+	// boundary vertex, after the other edges of that vertex.
+	std::vector< int > infinity_faces;
+	std::vector< char > on_boundary( num_vertices, 0 );
+	for( int f = 0; f < m; ++f ) {
+		for( int k = 0; k < 3; ++k ) {
+			if( !boundary_half_edge[ k*m + f ] ) continue;
+			infinity_faces.push_back( k*m + f );
+			on_boundary[ OF(f,(k+1)%3) ] = on_boundary[ OF(f,(k+2)%3) ] = 1;
+		}
+	}
+	// first_edge[v] is the index in E of the first edge of bucket v.
+	std::vector< int > first_edge( num_vertices + 1, 0 );
+	for( int v = 0; v < num_vertices; ++v ) {
+		edge_offsets[v+1] += edge_offsets[v];
+		first_edge[v+1] = first_edge[v] + ( edge_offsets[v+1] - edge_offsets[v] ) + on_boundary[v];
+	}
+	const int M = m + int( infinity_faces.size() );
+	const int num_edges = first_edge[ num_vertices ];
+
+	auto & F = topology.F;
+	auto & FT = topology.FT;
+	auto & E = topology.E;
+	auto & EF = topology.EF;
+	auto & EI = topology.EI;
+	auto & EMAP = topology.EMAP;
+	F.resize( M, 3 );
+	FT.resize( M, 3 );
+	F.topRows( m ) = OF;
+	FT.topRows( m ) = OFT;
+	for( int i = 0; i < int( infinity_faces.size() ); ++i ) {
+		const int f = infinity_faces[i] % m, k = infinity_faces[i] / m;
+		F.row( m + i ) << OF(f,(k+2)%3), OF(f,(k+1)%3), inf;
+		FT.row( m + i ) << OFT(f,(k+2)%3), OFT(f,(k+1)%3), int( TC.rows() );
+	}
+	E.resize( num_edges, 2 );
+	EF.setConstant( num_edges, 2, -1 );
+	EI.setConstant( num_edges, 2, -1 );
+	EMAP.resize( 3*M );
+	topology.kind.assign( num_edges, 0 );
+
+	// The edges of the input faces. Like igl::edge_flaps(), a face whose
+	// corners k+1, k+2 are E(e,0), E(e,1) goes on side 0 and the others on
+	// side 1; of several faces on one side, the last one counts.
+	parallel_for( num_vertices, [&]( const int a )
+	{
+		int e = first_edge[a];
+		const auto begin = entries.begin() + bucket_offsets[a], end = entries.begin() + bucket_offsets[a+1];
+		for( auto it = begin; it != end; ++e ) {
+			auto next = it;
+			int last[2] = { -1, -1 };
+			for( ; next != end && next->other == it->other; ++next ) {
+				const int f = next->h % m, k = next->h / m;
+				EMAP( k*M + f ) = e;
+				const int side = OF(f,(k+1)%3) == a ? 0 : 1;
+				if( 3*f + k > last[side] ) {
+					last[side] = 3*f + k;
+					EF(e,side) = f;
+					EI(e,side) = k;
+				}
+			}
+			E(e,0) = a;
+			E(e,1) = it->other;
+			// The half-edge (f,k+1) of igl::seam_edges() goes from corner
+			// k+1 to corner k+2.
+			if( next - it == 1 ) topology.kind[e] = MESH_BOUNDARY_EDGE;
+			else if( next - it == 2 && EF(e,0) != -1 && EF(e,1) != -1 ) {
+				topology.kind[e] = classify_pair( TC, OFT, EF(e,0), ( EI(e,0) + 1 )%3, EF(e,1), ( EI(e,1) + 1 )%3 );
+			}
+			else topology.kind[e] = UV_SEAM_EDGE;
+			it = next;
+		}
+		assert( e == first_edge[a] + edge_offsets[a+1] - edge_offsets[a] );
+		if( on_boundary[a] ) {
+			E(e,0) = a;
+			E(e,1) = inf;
+		}
+	} );
+
+	// The faces at infinity come after the input faces, so they go last on
+	// their sides. Face (b,a,inf) has the boundary edge opposite corner 2,
+	// (a,inf) on side 0 opposite corner 0 and (b,inf) on side 1 opposite
+	// corner 1.
+	for( int i = 0; i < int( infinity_faces.size() ); ++i ) {
+		const int fi = m + i;
+		const int e_a = first_edge[ F(fi,1) + 1 ] - 1, e_b = first_edge[ F(fi,0) + 1 ] - 1;
+		const int e = EMAP( infinity_faces[i] / m * M + infinity_faces[i] % m );
+		EMAP( 0*M + fi ) = e_a;
+		EF(e_a,0) = fi;
+		EI(e_a,0) = 0;
+		EMAP( 1*M + fi ) = e_b;
+		EF(e_b,1) = fi;
+		EI(e_b,1) = 1;
+		EMAP( 2*M + fi ) = e;
+		const int side = F(fi,0) == E(e,0) ? 0 : 1;
+		EF(e,side) = fi;
+		EI(e,side) = 2;
+	}
+}
+
+int insert_edges_of_kind( const EdgeTopology & topology, int kinds, EdgeMap & edges )
+{
+	int count = 0;
+	for( int e = 0; e < topology.E.rows(); ++e ) {
+		if( !( topology.kind[e] & kinds ) ) continue;
+		++count;
+		if( !contains_edge( edges, topology.E(e,0), topology.E(e,1) ) ) insert_edge( edges, topology.E(e,0), topology.E(e,1) );
+	}
+	return count;
+}
@@ -0,0 +1,53 @@
+#ifndef EDGE_TOPOLOGY_H
+#define EDGE_TOPOLOGY_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "half_edge.h"
+
+// Bits of EdgeTopology::kind, like the three lists of igl::seam_edges():
+// edges whose two sides have different texture coordinates, edges with a
+// single face, and edges whose two faces overlap in UV space.
+enum EdgeKind
+{
+	UV_SEAM_EDGE = 1,
+	MESH_BOUNDARY_EDGE = 2,
+	UV_FOLDOVER_EDGE = 4,
+	ANY_SEAM_EDGE = UV_SEAM_EDGE | MESH_BOUNDARY_EDGE | UV_FOLDOVER_EDGE
+};
+
+// The connectivity prepare_decimate_halfedge_5d() decimates: the mesh closed
+// with a vertex, a texture coordinate and faces at infinity, as
+// igl::connect_boundary_to_infinity() closes it, and its edges, as
+// igl::edge_flaps() finds them, together with which edges of the input are
+// seams.
+struct EdgeTopology
+{
+	// The input faces followed by one face (b,a,inf) per boundary edge a->b,
+	// and their texture coordinates, where inf is the index after the last
+	// vertex or texture coordinate of the input.
+	Eigen::MatrixXi F, FT;
+	// E(e,0) < E(e,1), sorted; EMAP(k*#F+f) is the edge opposite corner k of
+	// face f, and EF(e,i), EI(e,i) are the faces on either side and the
+	// corners opposite e in them, or -1.
+	Eigen::MatrixXi E, EF, EI;
+	Eigen::VectorXi EMAP;
+	// EdgeKind bits of each edge of E; 0 for the edges at infinity.
+	std::vector<unsigned char> kind;
+};
+
+// Builds the topology of (F,FT) with one bucket sort of the half-edges by
+// vertex, in parallel. Edges with more than two faces, or two faces with the
+// same orientation, are classified as UV seams.
+void build_edge_topology(
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	int num_vertices,
+	EdgeTopology & topology );
+
+// Inserts the edges of E that have any of the EdgeKind bits `kinds` into
+// edges, skipping those already in it. Returns how many there are.
+int insert_edges_of_kind( const EdgeTopology & topology, int kinds, EdgeMap & edges );
+
+#endif
@@ -17,15 +17,14 @@ HalfEdge::HalfEdge(int a, int b) : fi(a), ki(b) {}
 
 Bundle get_half_edge_bundle(
     int e,
-    Eigen::MatrixXi & E,
-    Eigen::MatrixXi & EF,
-    Eigen::MatrixXi & EI,
-    Eigen::MatrixXi & F,
-    Eigen::MatrixXi & FTC
+    const Eigen::MatrixXi & E,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXi & FTC
     )
 {
     Bundle result;
-    result.reserve(2);
     
     for( int side = 0; side < 2; ++side ) {
         
@@ -7,6 +7,8 @@
 #include <unordered_set>
 #include <utility>
 #include <string>
+#include "quadric_store.h"
+#include "inline_vector.h"
 
 struct VertexBundle
 {
@@ -25,20 +27,20 @@ struct HalfEdge
 	int ki;		// the index opposite to the half edge, ki = {0,1,2}
 	VertexBundle p[2]; 	// endpoints, each endpoint contain vi and ti
 	
+	HalfEdge() : fi(-1), ki(-1) {}
 	HalfEdge(int fi, int ki);
 };
 
-// A map from vertex_index to texcoord_index to metrics.
-typedef std::unordered_map< int, std::unordered_map< int, Eigen::MatrixXd > > MapV5d;
-typedef std::vector<HalfEdge> Bundle;
+// The two half edges of an edge.
+typedef InlineVector<HalfEdge,2> Bundle;
 
 Bundle get_half_edge_bundle(
     int e,
-    Eigen::MatrixXi & E,
-    Eigen::MatrixXi & EF,
-    Eigen::MatrixXi & EI,
-    Eigen::MatrixXi & F,
-    Eigen::MatrixXi & FT
+    const Eigen::MatrixXi & E,
+    const Eigen::MatrixXi & EF,
+    const Eigen::MatrixXi & EI,
+    const Eigen::MatrixXi & F,
+    const Eigen::MatrixXi & FT
     );
 
 void print_bundle( const Bundle & b );
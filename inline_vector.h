@@ -0,0 +1,44 @@
+#ifndef INLINE_VECTOR_H
+#define INLINE_VECTOR_H
+
+#include <cassert>
+
+// A vector of at most Capacity elements stored in place, for the short lists
+// the collapse loop builds for every edge (the two half edges of a bundle,
+// the one or two wedges of a placement), so that building them doesn't
+// allocate.
+template< typename T, int Capacity >
+class InlineVector
+{
+public:
+	InlineVector() : count( 0 ) {}
+
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	void clear() { count = 0; }
+	// New elements keep whatever value their slot had.
+	void resize( int n )
+	{
+		assert( n >= 0 && n <= Capacity );
+		count = n;
+	}
+	void push_back( const T & value )
+	{
+		assert( count < Capacity );
+		items[ count++ ] = value;
+	}
+
+	T & operator[]( int i ) { assert( i >= 0 && i < count ); return items[i]; }
+	const T & operator[]( int i ) const { assert( i >= 0 && i < count ); return items[i]; }
+
+	T * begin() { return items; }
+	T * end() { return items + count; }
+	const T * begin() const { return items; }
+	const T * end() const { return items + count; }
+
+private:
+	T items[ Capacity ];
+	int count;
+};
+
+#endif
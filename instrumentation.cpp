@@ -0,0 +1,108 @@
+#include "instrumentation.h"
+#include <atomic>
+#include <cassert>
+
+namespace
+{
+	const char * const phase_names[ NUM_DECIMATION_PHASES ] = {
+		"seam_detection",
+		"quadrics",
+		"reorder",
+		"queue_setup",
+		"collapse_loop",
+		"clean_mesh",
+		"compaction",
+		"verification"
+	};
+
+	const char * const counter_names[ NUM_DECIMATION_COUNTERS ] = {
+		"collapse_attempts",
+		"collapses",
+		"rejected_link_condition",
+		"rejected_foldover",
+		"rejected_seam_corner",
+		"rejected_boundary",
+		"rejected_zero_length_uv",
+		"closed_form_solves",
+		"quadprog_solves",
+		"queue_builds",
+		"queue_updates",
+		"queue_pops",
+		"queue_erases"
+	};
+
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	// Nanoseconds, so that the phases can be atomics too.
+	std::atomic< long long > phase_nanoseconds[ NUM_DECIMATION_PHASES ];
+	std::atomic< long long > counters[ NUM_DECIMATION_COUNTERS ];
+#endif
+}
+
+bool instrumentation_enabled()
+{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	return true;
+#else
+	return false;
+#endif
+}
+
+void reset_instrumentation()
+{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	for( auto & t : phase_nanoseconds ) t.store( 0, std::memory_order_relaxed );
+	for( auto & c : counters ) c.store( 0, std::memory_order_relaxed );
+#endif
+}
+
+const char * decimation_phase_name( DecimationPhase phase )
+{
+	assert( phase >= 0 && phase < NUM_DECIMATION_PHASES );
+	return phase_names[ phase ];
+}
+
+const char * decimation_counter_name( DecimationCounter counter )
+{
+	assert( counter >= 0 && counter < NUM_DECIMATION_COUNTERS );
+	return counter_names[ counter ];
+}
+
+double phase_seconds( DecimationPhase phase )
+{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	return phase_nanoseconds[ phase ].load( std::memory_order_relaxed ) * 1e-9;
+#else
+	(void)phase;
+	return 0.0;
+#endif
+}
+
+long long counter_value( DecimationCounter counter )
+{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	return counters[ counter ].load( std::memory_order_relaxed );
+#else
+	(void)counter;
+	return 0;
+#endif
+}
+
+void add_phase_seconds( DecimationPhase phase, double seconds )
+{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	phase_nanoseconds[ phase ].fetch_add( (long long)( seconds * 1e9 ), std::memory_order_relaxed );
+#else
+	(void)phase;
+	(void)seconds;
+#endif
+}
+
+void add_to_counter( DecimationCounter counter, long long n )
+{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+	counters[ counter ].fetch_add( n, std::memory_order_relaxed );
+#else
+	(void)counter;
+	(void)n;
+#endif
+}
@@ -0,0 +1,120 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+
+// Wall time of the phases of the decimation pipeline and counts of what the
+// collapse loop did, for telling whether a slow mesh is bound by the
+// placement solves, the queue or the rejected collapses. The totals are
+// global and accumulate until reset_instrumentation(); counting is safe from
+// the parallel stages.
+//
+// Building with DECIMATE_NO_INSTRUMENTATION (the CMake option
+// DECIMATE_INSTRUMENTATION=OFF) compiles all of it out: DECIMATE_COUNT()
+// does nothing, PhaseTimer doesn't read the clock and every total stays 0.
+
+enum DecimationPhase
+{
+	// igl::seam_edges() and the seam edge map built from it.
+	SEAM_DETECTION_PHASE,
+	// half_edge_qslim_5d().
+	QUADRICS_PHASE,
+	// Putting the input in DecimationOptions::spatial_order.
+	REORDER_PHASE,
+	// prepare_decimate_halfedge_5d(): the edge flaps, the seam flags, the
+	// initial costs and building the queue.
+	QUEUE_SETUP_PHASE,
+	// Collapsing edges, including the clean_mesh() of any levels of detail.
+	COLLAPSE_LOOP_PHASE,
+	// Every clean_mesh().
+	CLEAN_MESH_PHASE,
+	// Compacting the working mesh during the collapse loop.
+	COMPACTION_PHASE,
+	// measure_decimation_quality().
+	VERIFICATION_PHASE,
+	NUM_DECIMATION_PHASES
+};
+
+enum DecimationCounter
+{
+	// Calls to check_collapse_5d_edge().
+	COLLAPSE_ATTEMPTS,
+	// Edges collapsed.
+	COLLAPSES,
+	// Attempts rejected by check_collapse_5d_edge(), by reason.
+	REJECTED_LINK_CONDITION,
+	REJECTED_FOLDOVER,
+	// Both ends on seams, but not the edge.
+	REJECTED_SEAM_CORNER,
+	// A seam or boundary edge with --preserve-boundaries.
+	REJECTED_BOUNDARY,
+	// Seam edge cost evaluations given infinite cost because one side has a
+	// zero-length UV edge.
+	REJECTED_ZERO_LENGTH_UV,
+	// Placement solves, closed-form and with eiquadprog. The closed forms fall
+	// back to eiquadprog when they fail, so an edge may count in both.
+	CLOSED_FORM_SOLVES,
+	QUADPROG_SOLVES,
+	// Operations on the priority queue; build() counts once.
+	QUEUE_BUILDS,
+	QUEUE_UPDATES,
+	QUEUE_POPS,
+	QUEUE_ERASES,
+	NUM_DECIMATION_COUNTERS
+};
+
+// Returns false if built with DECIMATE_NO_INSTRUMENTATION.
+bool instrumentation_enabled();
+// Sets every total to 0.
+void reset_instrumentation();
+// The JSON friendly names of the phases and counters, e.g. "collapse_loop".
+const char * decimation_phase_name( DecimationPhase phase );
+const char * decimation_counter_name( DecimationCounter counter );
+// The totals so far.
+double phase_seconds( DecimationPhase phase );
+long long counter_value( DecimationCounter counter );
+
+void add_phase_seconds( DecimationPhase phase, double seconds );
+void add_to_counter( DecimationCounter counter, long long n );
+
+#ifndef DECIMATE_NO_INSTRUMENTATION
+#define DECIMATE_COUNT( counter ) add_to_counter( counter, 1 )
+#define DECIMATE_COUNT_N( counter, n ) add_to_counter( counter, n )
+#else
+#define DECIMATE_COUNT( counter ) ((void)0)
+#define DECIMATE_COUNT_N( counter, n ) ((void)0)
+#endif
+
+// Adds the wall time from its construction to stop(), or to its destruction
+// if stop() isn't called, to a phase.
+class PhaseTimer
+{
+public:
+	explicit PhaseTimer( DecimationPhase phase ) : phase( phase ), running( true )
+	{
+#ifndef DECIMATE_NO_INSTRUMENTATION
+		start = std::chrono::steady_clock::now();
+#endif
+	}
+	~PhaseTimer() { stop(); }
+
+	void stop()
+	{
+		if( !running ) return;
+		running = false;
+#ifndef DECIMATE_NO_INSTRUMENTATION
+		const std::chrono::duration< double > elapsed = std::chrono::steady_clock::now() - start;
+		add_phase_seconds( phase, elapsed.count() );
+#endif
+	}
+
+private:
+	PhaseTimer( const PhaseTimer & );
+	PhaseTimer & operator=( const PhaseTimer & );
+
+	DecimationPhase phase;
+	bool running;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,942 @@
+#include "mesh_io.h"
+#include "parallel_for.h"
+#include <igl/readOBJ.h>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char BINARY_MESH_MAGIC[8] = { 'S', 'A', 'D', 'M', 'E', 'S', 'H', '\0' };
+	const uint32_t BINARY_MESH_VERSION = 1;
+	const uint32_t BINARY_MESH_BYTE_ORDER = 0x01020304;
+	const uint64_t BINARY_MESH_ALIGNMENT = 64;
+
+	struct BinaryMeshHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint64_t num_vertices;
+		uint64_t num_tcs;
+		uint64_t num_faces;
+		uint64_t offset_V;
+		uint64_t offset_TC;
+		uint64_t offset_F;
+		uint64_t offset_FT;
+	};
+	static_assert( sizeof( BinaryMeshHeader ) == 72, "BinaryMeshHeader must not have padding" );
+
+	const char WEIGHTS_MAGIC[8] = { 'S', 'A', 'D', 'W', 'G', 'H', 'T', '\0' };
+	const uint32_t WEIGHTS_VERSION = 1;
+
+	struct WeightsHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t per_face;
+		uint32_t reserved;
+		uint64_t count;
+	};
+	static_assert( sizeof( WeightsHeader ) == 32, "WeightsHeader must not have padding" );
+
+	uint64_t align_up( uint64_t offset )
+	{
+		return ( offset + BINARY_MESH_ALIGNMENT - 1 ) / BINARY_MESH_ALIGNMENT * BINARY_MESH_ALIGNMENT;
+	}
+
+	bool ends_with( const std::string & str, const std::string & suffix )
+	{
+		return str.size() >= suffix.size() && str.compare( str.size() - suffix.size(), suffix.size(), suffix ) == 0;
+	}
+}
+
+bool is_binary_mesh_path( const std::string & path )
+{
+	return ends_with( path, ".bmesh" );
+}
+
+bool is_glb_path( const std::string & path )
+{
+	return ends_with( path, ".glb" );
+}
+
+MappedMesh::MappedMesh()
+	: data( nullptr ), size( 0 ), owns_buffer( false ),
+	  num_vertices( 0 ), num_tcs( 0 ), num_faces( 0 ),
+	  offset_V( 0 ), offset_TC( 0 ), offset_F( 0 ), offset_FT( 0 )
+{}
+
+MappedMesh::~MappedMesh()
+{
+	close();
+}
+
+bool MappedMesh::open( const std::string & path )
+{
+	close();
+
+#ifndef _WIN32
+	const int fd = ::open( path.c_str(), O_RDONLY );
+	if( fd < 0 ) return false;
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || size_t( st.st_size ) < sizeof( BinaryMeshHeader ) )
+	{
+		::close( fd );
+		return false;
+	}
+	size = size_t( st.st_size );
+	void * mapped = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+	if( mapped == MAP_FAILED )
+	{
+		size = 0;
+		return false;
+	}
+	data = static_cast< const char* >( mapped );
+#else
+	std::ifstream in( path, std::ios::binary | std::ios::ate );
+	if( !in ) return false;
+	size = size_t( in.tellg() );
+	if( size < sizeof( BinaryMeshHeader ) )
+	{
+		size = 0;
+		return false;
+	}
+	char * buffer = new char[ size ];
+	in.seekg( 0 );
+	in.read( buffer, size );
+	data = buffer;
+	owns_buffer = true;
+	if( !in )
+	{
+		close();
+		return false;
+	}
+#endif
+
+	BinaryMeshHeader header;
+	std::memcpy( &header, data, sizeof( header ) );
+	const auto & fits = [&]( uint64_t offset, uint64_t bytes )
+	{
+		return offset % sizeof( double ) == 0 && offset <= size && bytes <= size - offset;
+	};
+	const bool valid =
+		std::memcmp( header.magic, BINARY_MESH_MAGIC, sizeof( header.magic ) ) == 0 &&
+		header.version == BINARY_MESH_VERSION &&
+		header.byte_order == BINARY_MESH_BYTE_ORDER &&
+		header.num_vertices < ( uint64_t( 1 ) << 31 ) &&
+		header.num_tcs < ( uint64_t( 1 ) << 31 ) &&
+		header.num_faces < ( uint64_t( 1 ) << 31 ) &&
+		fits( header.offset_V, header.num_vertices * 3 * sizeof( double ) ) &&
+		fits( header.offset_TC, header.num_tcs * 2 * sizeof( double ) ) &&
+		fits( header.offset_F, header.num_faces * 3 * sizeof( int32_t ) ) &&
+		( header.num_tcs == 0 || fits( header.offset_FT, header.num_faces * 3 * sizeof( int32_t ) ) );
+	if( !valid )
+	{
+		close();
+		return false;
+	}
+
+	num_vertices = (long long)header.num_vertices;
+	num_tcs = (long long)header.num_tcs;
+	num_faces = (long long)header.num_faces;
+	offset_V = size_t( header.offset_V );
+	offset_TC = size_t( header.offset_TC );
+	offset_F = size_t( header.offset_F );
+	offset_FT = size_t( header.offset_FT );
+
+	// Out of range indices would only crash once the mesh is used.
+	const bool valid_indices = num_faces == 0 || (
+		F().minCoeff() >= 0 && F().maxCoeff() < num_vertices &&
+		( num_tcs == 0 || ( FT().minCoeff() >= 0 && FT().maxCoeff() < num_tcs ) ) );
+	if( !valid_indices )
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedMesh::close()
+{
+	if( data )
+	{
+#ifndef _WIN32
+		if( !owns_buffer ) munmap( const_cast< char* >( data ), size );
+#endif
+		if( owns_buffer ) delete [] data;
+	}
+	data = nullptr;
+	size = 0;
+	owns_buffer = false;
+	num_vertices = num_tcs = num_faces = 0;
+	offset_V = offset_TC = offset_F = offset_FT = 0;
+}
+
+Eigen::Map< const Eigen::MatrixXd > MappedMesh::V() const
+{
+	return Eigen::Map< const Eigen::MatrixXd >( reinterpret_cast< const double* >( data + offset_V ), num_vertices, 3 );
+}
+
+Eigen::Map< const Eigen::MatrixXd > MappedMesh::TC() const
+{
+	return Eigen::Map< const Eigen::MatrixXd >( reinterpret_cast< const double* >( data + offset_TC ), num_tcs, 2 );
+}
+
+Eigen::Map< const Eigen::MatrixXi > MappedMesh::F() const
+{
+	return Eigen::Map< const Eigen::MatrixXi >( reinterpret_cast< const int* >( data + offset_F ), num_faces, 3 );
+}
+
+Eigen::Map< const Eigen::MatrixXi > MappedMesh::FT() const
+{
+	return Eigen::Map< const Eigen::MatrixXi >( reinterpret_cast< const int* >( data + offset_FT ), num_tcs > 0 ? num_faces : 0, 3 );
+}
+
+bool write_binary_mesh(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXi & FT )
+{
+	static_assert( sizeof( int ) == sizeof( int32_t ), "F and FT are stored as int32" );
+	if( V.cols() != 3 || F.cols() != 3 ) return false;
+	if( TC.rows() > 0 && ( TC.cols() != 2 || FT.rows() != F.rows() || FT.cols() != 3 ) ) return false;
+	if( TC.rows() == 0 && FT.size() > 0 ) return false;
+
+	BinaryMeshHeader header;
+	std::memcpy( header.magic, BINARY_MESH_MAGIC, sizeof( header.magic ) );
+	header.version = BINARY_MESH_VERSION;
+	header.byte_order = BINARY_MESH_BYTE_ORDER;
+	header.num_vertices = uint64_t( V.rows() );
+	header.num_tcs = uint64_t( TC.rows() );
+	header.num_faces = uint64_t( F.rows() );
+	header.offset_V = align_up( sizeof( header ) );
+	header.offset_TC = align_up( header.offset_V + V.size() * sizeof( double ) );
+	header.offset_F = align_up( header.offset_TC + TC.size() * sizeof( double ) );
+	header.offset_FT = align_up( header.offset_F + F.size() * sizeof( int32_t ) );
+
+	std::ofstream out( path, std::ios::binary );
+	if( !out ) return false;
+	uint64_t written = 0;
+	const auto & write = [&]( uint64_t offset, const void * bytes, uint64_t count )
+	{
+		static const char zeros[ BINARY_MESH_ALIGNMENT ] = {};
+		for( ; written < offset; ++written ) out.write( zeros, 1 );
+		out.write( static_cast< const char* >( bytes ), std::streamsize( count ) );
+		written += count;
+	};
+	write( 0, &header, sizeof( header ) );
+	write( header.offset_V, V.data(), V.size() * sizeof( double ) );
+	write( header.offset_TC, TC.data(), TC.size() * sizeof( double ) );
+	write( header.offset_F, F.data(), F.size() * sizeof( int32_t ) );
+	if( TC.rows() > 0 ) write( header.offset_FT, FT.data(), FT.size() * sizeof( int32_t ) );
+	return bool( out );
+}
+
+bool read_binary_mesh(
+	const std::string & path,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT )
+{
+	MappedMesh mesh;
+	if( !mesh.open( path ) ) return false;
+	V = mesh.V();
+	TC = mesh.TC();
+	F = mesh.F();
+	FT = mesh.FT();
+	return true;
+}
+
+bool read_importance_weights(
+	const std::string & path,
+	Eigen::VectorXd & weights,
+	bool & per_face )
+{
+	std::ifstream in( path, std::ios::binary | std::ios::ate );
+	if( !in ) return false;
+	const uint64_t size = uint64_t( in.tellg() );
+	WeightsHeader header;
+	in.seekg( 0 );
+	if( size < sizeof( header ) || !in.read( reinterpret_cast< char* >( &header ), sizeof( header ) ) ) return false;
+	if( std::memcmp( header.magic, WEIGHTS_MAGIC, sizeof( header.magic ) ) != 0 ||
+		header.version != WEIGHTS_VERSION ||
+		header.byte_order != BINARY_MESH_BYTE_ORDER ||
+		header.per_face > 1 ||
+		header.count >= ( uint64_t( 1 ) << 31 ) ||
+		header.count*sizeof( float ) != size - sizeof( header ) ) return false;
+
+	std::vector< float > values( header.count );
+	if( !in.read( reinterpret_cast< char* >( values.data() ), std::streamsize( values.size()*sizeof( float ) ) ) ) return false;
+	weights.resize( Eigen::Index( values.size() ) );
+	for( size_t i = 0; i < values.size(); ++i )
+	{
+		if( !( values[i] > 0 && values[i] <= std::numeric_limits< float >::max() ) ) return false;
+		weights( Eigen::Index( i ) ) = values[i];
+	}
+	per_face = header.per_face == 1;
+	return true;
+}
+
+bool write_importance_weights(
+	const std::string & path,
+	const Eigen::VectorXd & weights,
+	bool per_face )
+{
+	WeightsHeader header;
+	std::memcpy( header.magic, WEIGHTS_MAGIC, sizeof( header.magic ) );
+	header.version = WEIGHTS_VERSION;
+	header.byte_order = BINARY_MESH_BYTE_ORDER;
+	header.per_face = per_face ? 1 : 0;
+	header.reserved = 0;
+	header.count = uint64_t( weights.size() );
+	std::vector< float > values( weights.size() );
+	for( size_t i = 0; i < values.size(); ++i ) values[i] = float( weights( Eigen::Index( i ) ) );
+
+	std::ofstream out( path, std::ios::binary );
+	if( !out ) return false;
+	out.write( reinterpret_cast< const char* >( &header ), sizeof( header ) );
+	out.write( reinterpret_cast< const char* >( values.data() ), std::streamsize( values.size()*sizeof( float ) ) );
+	return bool( out );
+}
+
+namespace
+{
+	// The lines [begin,end) of an OBJ, with what they contain.
+	struct ObjChunk
+	{
+		const char * begin = nullptr;
+		const char * end = nullptr;
+		long long num_v = 0;
+		long long num_vt = 0;
+		long long num_vn = 0;
+		long long num_triangles = 0;
+		// Triangles whose corners all have a texture coordinate or a normal.
+		long long num_triangles_vt = 0;
+		long long num_triangles_vn = 0;
+		bool ok = true;
+	};
+
+	inline const char * skip_blanks( const char * p, const char * end )
+	{
+		while( p < end && ( *p == ' ' || *p == '\t' || *p == '\r' ) ) ++p;
+		return p;
+	}
+
+	inline const char * line_end( const char * p, const char * end )
+	{
+		const void * newline = std::memchr( p, '\n', end - p );
+		return newline ? static_cast< const char* >( newline ) : end;
+	}
+
+	inline bool is_blank( char c )
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	enum ObjLineKind { OBJ_OTHER, OBJ_V, OBJ_VT, OBJ_VN, OBJ_F };
+
+	// Skips the keyword of the line at p.
+	inline ObjLineKind classify_line( const char * & p, const char * end )
+	{
+		if( end - p >= 2 && p[0] == 'v' && is_blank( p[1] ) ) { p += 2; return OBJ_V; }
+		if( end - p >= 3 && p[0] == 'v' && p[1] == 't' && is_blank( p[2] ) ) { p += 3; return OBJ_VT; }
+		if( end - p >= 3 && p[0] == 'v' && p[1] == 'n' && is_blank( p[2] ) ) { p += 3; return OBJ_VN; }
+		if( end - p >= 2 && p[0] == 'f' && is_blank( p[1] ) ) { p += 2; return OBJ_F; }
+		return OBJ_OTHER;
+	}
+
+	// Parses the corners v, v/vt, v/vt/vn or v//vn of a face line. Indices
+	// stay as written: 1-based, negative for relative, 0 where absent.
+	bool parse_face( const char * p, const char * end, std::vector<int> & v, std::vector<int> & vt, std::vector<int> & vn )
+	{
+		v.clear();
+		vt.clear();
+		vn.clear();
+		while( true )
+		{
+			p = skip_blanks( p, end );
+			if( p == end ) break;
+			char * q;
+			const long a = std::strtol( p, &q, 10 );
+			if( q == p || a == 0 ) return false;
+			p = q;
+			long b = 0, c = 0;
+			if( p < end && *p == '/' )
+			{
+				++p;
+				if( p < end && *p != '/' )
+				{
+					b = std::strtol( p, &q, 10 );
+					if( q == p || b == 0 ) return false;
+					p = q;
+				}
+				if( p < end && *p == '/' )
+				{
+					++p;
+					c = std::strtol( p, &q, 10 );
+					if( q == p || c == 0 ) return false;
+					p = q;
+				}
+			}
+			if( p < end && !is_blank( *p ) ) return false;
+			v.push_back( int( a ) );
+			vt.push_back( int( b ) );
+			vn.push_back( int( c ) );
+		}
+		return v.size() >= 3;
+	}
+
+	// Parses up to n numbers of a vertex line into row `row` of M.
+	bool parse_numbers( const char * p, const char * end, int n, Eigen::MatrixXd & M, long long row )
+	{
+		for( int k = 0; k < n; ++k )
+		{
+			p = skip_blanks( p, end );
+			if( p == end ) return false;
+			char * q;
+			M( row, k ) = std::strtod( p, &q );
+			if( q == p ) return false;
+			p = q;
+		}
+		return true;
+	}
+
+	// Converts an OBJ index given after `count` elements to a 0-based one, or
+	// returns -1 if it is out of range.
+	inline int obj_index( int i, long long count, long long total )
+	{
+		const long long j = i > 0 ? i - 1 : count + i;
+		return ( j >= 0 && j < total ) ? int( j ) : -1;
+	}
+
+	// Same whether all corners of a face have the index or none.
+	inline int count_nonzero( const std::vector<int> & indices )
+	{
+		return int( indices.size() - std::count( indices.begin(), indices.end(), 0 ) );
+	}
+}
+
+bool read_obj_parallel(
+	const std::string & path,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXd & CN,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT,
+	Eigen::MatrixXi & FN )
+{
+	std::ifstream in( path, std::ios::binary | std::ios::ate );
+	if( !in ) return false;
+	const size_t size = size_t( in.tellg() );
+	// Zero-terminated so that strtod() and strtol() stop at the end.
+	std::vector<char> buffer( size + 1, '\0' );
+	in.seekg( 0 );
+	in.read( buffer.data(), std::streamsize( size ) );
+	if( !in ) return false;
+	const char * const text = buffer.data();
+	const char * const text_end = text + size;
+
+	// Blocks of about 1 MB, cut after a newline.
+	const size_t block_size = 1 << 20;
+	std::vector< ObjChunk > chunks;
+	for( const char * p = text; p < text_end; )
+	{
+		ObjChunk chunk;
+		chunk.begin = p;
+		const char * cut = p + std::min( block_size, size_t( text_end - p ) );
+		chunk.end = cut == text_end ? text_end : std::min( text_end, line_end( cut, text_end ) + 1 );
+		p = chunk.end;
+		chunks.push_back( chunk );
+	}
+
+	// Count what every block contains.
+	parallel_for( int( chunks.size() ), [&]( const int c )
+	{
+		ObjChunk & chunk = chunks[c];
+		std::vector<int> v, vt, vn;
+		for( const char * p = chunk.begin; p < chunk.end; )
+		{
+			const char * end = line_end( p, chunk.end );
+			const char * q = skip_blanks( p, end );
+			switch( classify_line( q, end ) )
+			{
+				case OBJ_V: ++chunk.num_v; break;
+				case OBJ_VT: ++chunk.num_vt; break;
+				case OBJ_VN: ++chunk.num_vn; break;
+				case OBJ_F:
+				{
+					if( !parse_face( q, end, v, vt, vn ) ) { chunk.ok = false; break; }
+					const int num_vt = count_nonzero( vt );
+					const int num_vn = count_nonzero( vn );
+					if( ( num_vt != 0 && num_vt != int( v.size() ) ) || ( num_vn != 0 && num_vn != int( v.size() ) ) ) chunk.ok = false;
+					chunk.num_triangles += v.size() - 2;
+					if( num_vt ) chunk.num_triangles_vt += v.size() - 2;
+					if( num_vn ) chunk.num_triangles_vn += v.size() - 2;
+					break;
+				}
+				default: break;
+			}
+			p = end + 1;
+		}
+	}, 1 );
+
+	// Where every block's elements start.
+	ObjChunk total;
+	std::vector< ObjChunk > first( chunks.size() );
+	for( size_t c = 0; c < chunks.size(); ++c )
+	{
+		if( !chunks[c].ok ) return false;
+		first[c] = total;
+		total.num_v += chunks[c].num_v;
+		total.num_vt += chunks[c].num_vt;
+		total.num_vn += chunks[c].num_vn;
+		total.num_triangles += chunks[c].num_triangles;
+		total.num_triangles_vt += chunks[c].num_triangles_vt;
+		total.num_triangles_vn += chunks[c].num_triangles_vn;
+	}
+	const bool has_ft = total.num_vt > 0 && total.num_triangles_vt > 0;
+	const bool has_fn = total.num_vn > 0 && total.num_triangles_vn > 0;
+	if( has_ft && total.num_triangles_vt != total.num_triangles ) return false;
+	if( has_fn && total.num_triangles_vn != total.num_triangles ) return false;
+
+	// Like igl::readOBJ(), absent elements give 0 by 0 matrices.
+	V.resize( total.num_v, total.num_v > 0 ? 3 : 0 );
+	TC.resize( total.num_vt, total.num_vt > 0 ? 2 : 0 );
+	CN.resize( total.num_vn, total.num_vn > 0 ? 3 : 0 );
+	F.resize( total.num_triangles, 3 );
+	if( has_ft ) FT.resize( total.num_triangles, 3 );
+	else FT.resize( 0, 0 );
+	if( has_fn ) FN.resize( total.num_triangles, 3 );
+	else FN.resize( 0, 0 );
+
+	// Parse every block into its rows.
+	std::vector< char > ok( chunks.size(), 1 );
+	parallel_for( int( chunks.size() ), [&]( const int c )
+	{
+		ObjChunk next = first[c];
+		std::vector<int> v, vt, vn;
+		for( const char * p = chunks[c].begin; p < chunks[c].end && ok[c]; )
+		{
+			const char * end = line_end( p, chunks[c].end );
+			const char * q = skip_blanks( p, end );
+			switch( classify_line( q, end ) )
+			{
+				case OBJ_V: ok[c] = parse_numbers( q, end, 3, V, next.num_v++ ); break;
+				case OBJ_VT: ok[c] = parse_numbers( q, end, 2, TC, next.num_vt++ ); break;
+				case OBJ_VN: ok[c] = parse_numbers( q, end, 3, CN, next.num_vn++ ); break;
+				case OBJ_F:
+				{
+					parse_face( q, end, v, vt, vn );
+					for( size_t k = 0; k < v.size(); ++k )
+					{
+						v[k] = obj_index( v[k], next.num_v, total.num_v );
+						if( has_ft ) vt[k] = obj_index( vt[k], next.num_vt, total.num_vt );
+						if( has_fn ) vn[k] = obj_index( vn[k], next.num_vn, total.num_vn );
+						if( v[k] < 0 || ( has_ft && vt[k] < 0 ) || ( has_fn && vn[k] < 0 ) ) ok[c] = 0;
+					}
+					// A fan around the first corner.
+					for( size_t k = 1; k + 1 < v.size(); ++k )
+					{
+						const size_t corner[3] = { 0, k, k+1 };
+						for( int j = 0; j < 3; ++j )
+						{
+							F( next.num_triangles, j ) = v[ corner[j] ];
+							if( has_ft ) FT( next.num_triangles, j ) = vt[ corner[j] ];
+							if( has_fn ) FN( next.num_triangles, j ) = vn[ corner[j] ];
+						}
+						++next.num_triangles;
+					}
+					break;
+				}
+				default: break;
+			}
+			p = end + 1;
+		}
+	}, 1 );
+	return std::find( ok.begin(), ok.end(), 0 ) == ok.end();
+}
+
+namespace
+{
+	// Writes n+1 in decimal at p, for the 1-based indices of an OBJ.
+	inline char * format_index( int n, char * p )
+	{
+		char digits[16];
+		int count = 0;
+		for( unsigned int x = unsigned( n ) + 1; x > 0 || count == 0; x /= 10 ) digits[ count++ ] = char( '0' + x % 10 );
+		while( count > 0 ) *p++ = digits[ --count ];
+		return p;
+	}
+
+	// Writes x like igl::writeOBJ() does.
+	inline char * format_double( double x, char * p )
+	{
+		return p + std::snprintf( p, 32, "%0.17g", x );
+	}
+
+	enum ObjSection { OBJ_SECTION_V, OBJ_SECTION_VN, OBJ_SECTION_VT, OBJ_SECTION_F };
+
+	// The lines of rows [begin,end) of one section of an OBJ, formatted.
+	struct ObjBlock
+	{
+		ObjSection section = OBJ_SECTION_V;
+		int begin = 0;
+		int end = 0;
+		// igl::writeOBJ() ends the normals and the texture coordinates with a
+		// blank line.
+		bool blank_line = false;
+	};
+}
+
+bool write_obj_parallel(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT )
+{
+	const bool has_tc = TC.rows() > 0;
+	const bool has_cn = CN.rows() > 0;
+	if( has_tc && ( TC.cols() < 2 || FT.rows() != F.rows() || FT.cols() != F.cols() ) ) return false;
+	if( has_cn && ( CN.cols() < 3 || FN.rows() != F.rows() || FN.cols() != F.cols() ) ) return false;
+
+	// Blocks of rows in the order igl::writeOBJ() writes them.
+	const int block_rows = 1 << 14;
+	std::vector< ObjBlock > blocks;
+	const auto & add_section = [&]( ObjSection section, int rows, bool blank_line )
+	{
+		for( int begin = 0; begin < rows; begin += block_rows )
+		{
+			ObjBlock block;
+			block.section = section;
+			block.begin = begin;
+			block.end = std::min( rows, begin + block_rows );
+			block.blank_line = blank_line && block.end == rows;
+			blocks.push_back( block );
+		}
+	};
+	add_section( OBJ_SECTION_V, int( V.rows() ), false );
+	add_section( OBJ_SECTION_VN, int( CN.rows() ), true );
+	add_section( OBJ_SECTION_VT, int( TC.rows() ), true );
+	add_section( OBJ_SECTION_F, int( F.rows() ), false );
+
+	std::ofstream out( path, std::ios::binary );
+	if( !out ) return false;
+
+	// Formats a window of blocks at a time in parallel, and writes them in
+	// order, so that only the window is ever in memory.
+	const int window = std::max( 1, 4*num_threads() );
+	std::vector< std::string > text( std::min( window, int( blocks.size() ) ) );
+	for( int first = 0; first < int( blocks.size() ); first += window )
+	{
+		const int count = std::min( window, int( blocks.size() ) - first );
+		parallel_for( count, [&]( const int b )
+		{
+			const ObjBlock & block = blocks[ first + b ];
+			const int numbers = block.section == OBJ_SECTION_V ? int( V.cols() ) : block.section == OBJ_SECTION_F ? 3*int( F.cols() ) : 3;
+			std::string & buffer = text[b];
+			buffer.resize( size_t( block.end - block.begin )*( 4 + 33*size_t( numbers ) ) + 1 );
+			char * const begin = &buffer[0];
+			char * p = begin;
+			for( int i = block.begin; i < block.end; ++i )
+			{
+				switch( block.section )
+				{
+					case OBJ_SECTION_V:
+						*p++ = 'v';
+						for( int k = 0; k < V.cols(); ++k ) *p++ = ' ', p = format_double( V(i,k), p );
+						break;
+					case OBJ_SECTION_VN:
+						*p++ = 'v', *p++ = 'n';
+						for( int k = 0; k < 3; ++k ) *p++ = ' ', p = format_double( CN(i,k), p );
+						break;
+					case OBJ_SECTION_VT:
+						*p++ = 'v', *p++ = 't';
+						for( int k = 0; k < 2; ++k ) *p++ = ' ', p = format_double( TC(i,k), p );
+						break;
+					case OBJ_SECTION_F:
+						*p++ = 'f';
+						for( int k = 0; k < F.cols(); ++k )
+						{
+							*p++ = ' ';
+							p = format_index( F(i,k), p );
+							if( has_tc ) *p++ = '/', p = format_index( FT(i,k), p );
+							if( has_cn )
+							{
+								if( !has_tc ) *p++ = '/';
+								*p++ = '/';
+								p = format_index( FN(i,k), p );
+							}
+						}
+						break;
+				}
+				*p++ = '\n';
+			}
+			if( block.blank_line ) *p++ = '\n';
+			buffer.resize( size_t( p - begin ) );
+		}, 1 );
+		for( int b = 0; b < count; ++b ) out.write( text[b].data(), std::streamsize( text[b].size() ) );
+		if( !out ) return false;
+	}
+	return bool( out );
+}
+
+namespace
+{
+	const uint32_t GLB_MAGIC = 0x46546C67;
+	const uint32_t GLB_VERSION = 2;
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+	const int GLTF_FLOAT = 5126;
+	const int GLTF_UNSIGNED_INT = 5125;
+	const int GLTF_ARRAY_BUFFER = 34962;
+	const int GLTF_ELEMENT_ARRAY_BUFFER = 34963;
+
+	bool is_little_endian()
+	{
+		const uint32_t one = 1;
+		char first;
+		std::memcpy( &first, &one, 1 );
+		return first == 1;
+	}
+
+	std::string format_json( const char * format, ... )
+	{
+		char buffer[256];
+		va_list args;
+		va_start( args, format );
+		std::vsnprintf( buffer, sizeof( buffer ), format, args );
+		va_end( args );
+		return buffer;
+	}
+}
+
+bool write_glb(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT )
+{
+	static_assert( sizeof( float ) == 4, "glTF stores 32-bit floats" );
+	const bool has_tc = TC.rows() > 0;
+	const bool has_cn = CN.rows() > 0;
+	if( !is_little_endian() || V.cols() != 3 || F.cols() != 3 || F.rows() == 0 ) return false;
+	if( has_tc && ( TC.cols() != 2 || FT.rows() != F.rows() || FT.cols() != 3 ) ) return false;
+	if( has_cn && ( CN.cols() != 3 || FN.rows() != F.rows() || FN.cols() != 3 ) ) return false;
+
+	// The glTF vertex of every corner. The first (vertex, texture coordinate,
+	// normal) to use a texture coordinate, or a vertex if there are none,
+	// gets its slot, so only the rare others go through the map.
+	typedef std::tuple< int, int, int > Wedge;
+	const int num_slots = int( has_tc ? TC.rows() : V.rows() );
+	std::vector< int > slot_vertex( num_slots, -1 );
+	std::vector< Wedge > wedges;
+	std::map< Wedge, int > other_wedges;
+	std::vector< uint32_t > indices( F.size() );
+	for( int f = 0; f < F.rows(); ++f )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			const Wedge wedge( F(f,k), has_tc ? FT(f,k) : -1, has_cn ? FN(f,k) : -1 );
+			int & slot = slot_vertex[ has_tc ? FT(f,k) : F(f,k) ];
+			int vertex;
+			if( slot < 0 )
+			{
+				slot = vertex = int( wedges.size() );
+				wedges.push_back( wedge );
+			}
+			else if( wedges[ slot ] == wedge ) vertex = slot;
+			else
+			{
+				const auto inserted = other_wedges.insert( std::make_pair( wedge, int( wedges.size() ) ) );
+				if( inserted.second ) wedges.push_back( wedge );
+				vertex = inserted.first->second;
+			}
+			indices[ 3*f + k ] = uint32_t( vertex );
+		}
+	}
+	const int num_vertices = int( wedges.size() );
+
+	// The binary chunk: positions, texture coordinates, normals and indices,
+	// all of them multiples of 4 bytes.
+	const size_t offset_positions = 0;
+	const size_t offset_tcs = offset_positions + size_t( num_vertices )*3*sizeof( float );
+	const size_t offset_normals = offset_tcs + ( has_tc ? size_t( num_vertices )*2*sizeof( float ) : 0 );
+	const size_t offset_indices = offset_normals + ( has_cn ? size_t( num_vertices )*3*sizeof( float ) : 0 );
+	const size_t bin_length = offset_indices + indices.size()*sizeof( uint32_t );
+	std::vector< char > bin( bin_length );
+	float * const positions = reinterpret_cast< float* >( bin.data() + offset_positions );
+	float * const tcs = reinterpret_cast< float* >( bin.data() + offset_tcs );
+	float * const normals = reinterpret_cast< float* >( bin.data() + offset_normals );
+	parallel_for( num_vertices, [&]( const int i )
+	{
+		const Wedge & wedge = wedges[i];
+		for( int c = 0; c < 3; ++c ) positions[ 3*i + c ] = float( V( std::get<0>( wedge ), c ) );
+		if( has_tc )
+		{
+			// glTF puts the origin of texture coordinates at the top left.
+			tcs[ 2*i ] = float( TC( std::get<1>( wedge ), 0 ) );
+			tcs[ 2*i + 1 ] = float( 1.0 - TC( std::get<1>( wedge ), 1 ) );
+		}
+		if( has_cn )
+		{
+			for( int c = 0; c < 3; ++c ) normals[ 3*i + c ] = float( CN( std::get<2>( wedge ), c ) );
+		}
+	} );
+	std::memcpy( bin.data() + offset_indices, indices.data(), indices.size()*sizeof( uint32_t ) );
+
+	// glTF requires the bounds of the positions.
+	float lo[3], hi[3];
+	for( int c = 0; c < 3; ++c )
+	{
+		lo[c] = std::numeric_limits< float >::max();
+		hi[c] = -lo[c];
+	}
+	for( int i = 0; i < num_vertices; ++i )
+	{
+		for( int c = 0; c < 3; ++c )
+		{
+			lo[c] = std::min( lo[c], positions[ 3*i + c ] );
+			hi[c] = std::max( hi[c], positions[ 3*i + c ] );
+		}
+	}
+
+	std::string attributes = "\"POSITION\":0";
+	std::string accessors = format_json(
+		"{\"bufferView\":0,\"componentType\":%d,\"count\":%d,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]}",
+		GLTF_FLOAT, num_vertices, lo[0], lo[1], lo[2], hi[0], hi[1], hi[2] );
+	std::string buffer_views = format_json(
+		"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":%d}",
+		offset_positions, offset_tcs - offset_positions, GLTF_ARRAY_BUFFER );
+	int num_views = 1;
+	const auto & add_attribute = [&]( const char * name, const char * type, size_t begin, size_t end )
+	{
+		attributes += format_json( ",\"%s\":%d", name, num_views );
+		accessors += format_json( ",{\"bufferView\":%d,\"componentType\":%d,\"count\":%d,\"type\":\"%s\"}", num_views, GLTF_FLOAT, num_vertices, type );
+		buffer_views += format_json( ",{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":%d}", begin, end - begin, GLTF_ARRAY_BUFFER );
+		++num_views;
+	};
+	if( has_tc ) add_attribute( "TEXCOORD_0", "VEC2", offset_tcs, offset_normals );
+	if( has_cn ) add_attribute( "NORMAL", "VEC3", offset_normals, offset_indices );
+	accessors += format_json( ",{\"bufferView\":%d,\"componentType\":%d,\"count\":%zu,\"type\":\"SCALAR\"}", num_views, GLTF_UNSIGNED_INT, indices.size() );
+	buffer_views += format_json( ",{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":%d}", offset_indices, bin_length - offset_indices, GLTF_ELEMENT_ARRAY_BUFFER );
+
+	std::string json =
+		"{\"asset\":{\"version\":\"2.0\",\"generator\":\"SeamAwareDecimater\"},"
+		"\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{" + attributes + "},\"indices\":" + std::to_string( num_views ) + ",\"mode\":4}]}],"
+		"\"accessors\":[" + accessors + "],"
+		"\"bufferViews\":[" + buffer_views + "],"
+		"\"buffers\":[{\"byteLength\":" + std::to_string( bin_length ) + "}]}";
+	// Chunks are padded to 4 bytes, the JSON with spaces.
+	json.resize( ( json.size() + 3 ) / 4 * 4, ' ' );
+
+	const uint32_t header[3] = { GLB_MAGIC, GLB_VERSION, uint32_t( 12 + 8 + json.size() + 8 + bin_length ) };
+	const uint32_t json_header[2] = { uint32_t( json.size() ), GLB_CHUNK_JSON };
+	const uint32_t bin_header[2] = { uint32_t( bin_length ), GLB_CHUNK_BIN };
+	std::ofstream out( path, std::ios::binary );
+	if( !out ) return false;
+	out.write( reinterpret_cast< const char* >( header ), sizeof( header ) );
+	out.write( reinterpret_cast< const char* >( json_header ), sizeof( json_header ) );
+	out.write( json.data(), std::streamsize( json.size() ) );
+	out.write( reinterpret_cast< const char* >( bin_header ), sizeof( bin_header ) );
+	out.write( bin.data(), std::streamsize( bin.size() ) );
+	return bool( out );
+}
+
+namespace
+{
+	const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+	const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+	void hash_bytes( const void * data, size_t size, uint64_t & hash )
+	{
+		const unsigned char * bytes = static_cast< const unsigned char* >( data );
+		for( size_t i = 0; i < size; ++i ) hash = ( hash ^ bytes[i] )*FNV_PRIME;
+	}
+
+	template < typename Matrix >
+	void hash_matrix( const Matrix & M, uint64_t & hash )
+	{
+		const int64_t size[2] = { int64_t( M.rows() ), int64_t( M.cols() ) };
+		hash_bytes( size, sizeof( size ), hash );
+		hash_bytes( M.data(), size_t( M.size() )*sizeof( typename Matrix::Scalar ), hash );
+	}
+}
+
+uint64_t mesh_hash(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT )
+{
+	uint64_t hash = FNV_OFFSET_BASIS;
+	hash_matrix( V, hash );
+	hash_matrix( F, hash );
+	hash_matrix( CN, hash );
+	hash_matrix( FN, hash );
+	hash_matrix( TC, hash );
+	hash_matrix( FT, hash );
+	return hash;
+}
+
+bool read_mesh(
+	const std::string & path,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXd & CN,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT,
+	Eigen::MatrixXi & FN )
+{
+	if( is_binary_mesh_path( path ) )
+	{
+		CN.resize( 0, 0 );
+		FN.resize( 0, 0 );
+		return read_binary_mesh( path, V, TC, F, FT );
+	}
+	return read_obj_parallel( path, V, TC, CN, F, FT, FN ) || igl::readOBJ( path, V, TC, CN, F, FT, FN );
+}
+
+bool write_mesh(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT )
+{
+	if( is_binary_mesh_path( path ) ) return write_binary_mesh( path, V, TC, F, FT );
+	if( is_glb_path( path ) ) return write_glb( path, V, F, CN, FN, TC, FT );
+	return write_obj_parallel( path, V, F, CN, FN, TC, FT );
+}
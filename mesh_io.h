@@ -0,0 +1,176 @@
+#ifndef MESH_IO_H
+#define MESH_IO_H
+
+#include <Eigen/Core>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Mesh files by extension: ".bmesh" is the binary container below, ".glb" is
+// written as a glTF binary (see write_glb()), anything else is read and
+// written as OBJ.
+//
+// The binary container holds positions, texture coordinates, F and FT as
+// column-major arrays, so they map directly onto Eigen::MatrixXd/MatrixXi:
+//
+//   char magic[8]          "SADMESH" followed by a zero byte
+//   uint32 version         1
+//   uint32 byte_order      0x01020304 in the byte order of the writer
+//   uint64 num_vertices, num_tcs, num_faces
+//   uint64 offset_V        #V by 3 doubles
+//   uint64 offset_TC       #TC by 2 doubles
+//   uint64 offset_F        #F by 3 int32
+//   uint64 offset_FT       #F by 3 int32 if #TC > 0, otherwise nothing
+//
+// Offsets are in bytes from the start of the file and multiples of 64.
+
+// Returns whether `path` names a binary mesh, or a glTF binary.
+bool is_binary_mesh_path( const std::string & path );
+bool is_glb_path( const std::string & path );
+
+// A binary mesh mapped into memory, read-only. The views stay valid until
+// the file is closed or the MappedMesh is destroyed.
+class MappedMesh
+{
+public:
+	MappedMesh();
+	~MappedMesh();
+	MappedMesh( const MappedMesh & ) = delete;
+	MappedMesh & operator=( const MappedMesh & ) = delete;
+
+	// Maps `path`, closing any file mapped before. Returns false if it can't
+	// be read or isn't a binary mesh, including when a face refers to a
+	// vertex or texture coordinate it doesn't have.
+	bool open( const std::string & path );
+	void close();
+	bool is_open() const { return data != nullptr; }
+
+	Eigen::Map< const Eigen::MatrixXd > V() const;
+	Eigen::Map< const Eigen::MatrixXd > TC() const;
+	Eigen::Map< const Eigen::MatrixXi > F() const;
+	Eigen::Map< const Eigen::MatrixXi > FT() const;
+
+private:
+	const char * data;
+	size_t size;
+	// Whether data was read into a heap buffer where there is no mmap().
+	bool owns_buffer;
+	long long num_vertices;
+	long long num_tcs;
+	long long num_faces;
+	size_t offset_V, offset_TC, offset_F, offset_FT;
+};
+
+// Writes the binary container. FT must be empty if TC is.
+bool write_binary_mesh(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXi & FT );
+
+// Reads a binary mesh, copying every array once out of the mapping.
+bool read_binary_mesh(
+	const std::string & path,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT );
+
+// Reads an OBJ like igl::readOBJ(), parsing blocks of lines in parallel.
+// Faces with more than three corners are split into triangle fans. Returns
+// false if the file can't be read, has something it doesn't handle (e.g.
+// some faces with texture coordinates and some without) or has indices out
+// of range.
+bool read_obj_parallel(
+	const std::string & path,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXd & CN,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT,
+	Eigen::MatrixXi & FN );
+
+// Writes the same text as igl::writeOBJ(), formatting blocks of rows in
+// parallel and writing each block with one call. Numbers are formatted as
+// "%0.17g", which reads back exactly.
+bool write_obj_parallel(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT );
+
+// Writes a glTF 2.0 binary with a single triangle primitive: POSITION,
+// TEXCOORD_0 and NORMAL, the latter two if the mesh has them, as floats, and
+// 32-bit indices. glTF has a single index per corner, so each distinct
+// (vertex, texture coordinate, normal) of the corners becomes a vertex, in
+// the order the corners first use them. Texture coordinates are flipped to
+// glTF's top-left origin. Returns false on big-endian hosts, since glTF is
+// little-endian.
+bool write_glb(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT );
+
+// Importance weights for a mesh, in a sidecar file next to it, which
+// half_edge_qslim_5d() multiplies the face quadrics by:
+//
+//   char magic[8]          "SADWGHT" followed by a zero byte
+//   uint32 version         1
+//   uint32 byte_order      0x01020304 in the byte order of the writer
+//   uint32 per_face        1 for one weight per face, 0 for one per vertex
+//   uint32 reserved        0
+//   uint64 count           The number of weights
+//   float32 weights[count]
+//
+// Weights must be positive and finite. Returns false if the file can't be
+// read, isn't a weights file or has other weights.
+bool read_importance_weights(
+	const std::string & path,
+	Eigen::VectorXd & weights,
+	bool & per_face );
+bool write_importance_weights(
+	const std::string & path,
+	const Eigen::VectorXd & weights,
+	bool per_face );
+
+// A 64-bit FNV-1a hash of the sizes and the bytes of the arrays of a mesh,
+// which is the same for the same mesh whatever file it is written to, e.g.
+// to key a cache of decimated meshes.
+uint64_t mesh_hash(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT );
+
+// Reads or writes a mesh, choosing the format by extension. Binary meshes
+// have no normals: CN and FN come back empty and aren't written. OBJs that
+// read_obj_parallel() can't handle are read with igl::readOBJ(). glTF
+// binaries are only written.
+bool read_mesh(
+	const std::string & path,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXd & CN,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT,
+	Eigen::MatrixXi & FN );
+bool write_mesh(
+	const std::string & path,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & CN,
+	const Eigen::MatrixXi & FN,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT );
+
+#endif
@@ -0,0 +1,170 @@
+#include "mesh_order.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	// Spreads the low 21 bits of x out to every third bit.
+	uint64_t spread_bits( uint64_t x )
+	{
+		x &= 0x1fffff;
+		x = ( x | x << 32 ) & 0x1f00000000ffffULL;
+		x = ( x | x << 16 ) & 0x1f0000ff0000ffULL;
+		x = ( x | x << 8 ) & 0x100f00f00f00f00fULL;
+		x = ( x | x << 4 ) & 0x10c30c30c30c30c3ULL;
+		x = ( x | x << 2 ) & 0x1249249249249249ULL;
+		return x;
+	}
+
+	// The rows of keys in increasing order of (keys[i],i).
+	template < typename Key >
+	void sorted_order( const std::vector< Key > & keys, std::vector< int > & order )
+	{
+		std::vector< std::pair< Key, int > > sorted( keys.size() );
+		for( int i = 0; i < int( keys.size() ); ++i ) sorted[i] = std::make_pair( keys[i], i );
+		std::sort( sorted.begin(), sorted.end() );
+		order.resize( sorted.size() );
+		for( int i = 0; i < int( sorted.size() ); ++i ) order[i] = sorted[i].second;
+	}
+
+	// The rows of M in the given order.
+	template < typename Matrix >
+	void reorder_rows( const Matrix & M, const int * order, int n, Matrix & M_out )
+	{
+		M_out.resize( n, M.cols() );
+		for( int i = 0; i < n; ++i ) M_out.row(i) = M.row( order[i] );
+	}
+
+	// The rows of F in the given order, renumbered with new_ids.
+	void reorder_faces( const Eigen::MatrixXi & F, const int * order, int n, const std::vector< int > & new_ids, Eigen::MatrixXi & F_out )
+	{
+		F_out.resize( n, F.cols() );
+		for( int i = 0; i < n; ++i ) {
+			for( int k = 0; k < F.cols(); ++k ) F_out(i,k) = new_ids[ F( order[i], k ) ];
+		}
+	}
+}
+
+void spatial_mesh_order(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	MeshOrder & order )
+{
+	// The bounding box of the finite positions.
+	Eigen::RowVectorXd lo = Eigen::RowVectorXd::Constant( V.cols(), std::numeric_limits< double >::infinity() );
+	Eigen::RowVectorXd hi = -lo;
+	for( int v = 0; v < V.rows(); ++v ) {
+		for( int c = 0; c < V.cols(); ++c ) {
+			if( !std::isfinite( V(v,c) ) ) continue;
+			lo(c) = std::min( lo(c), V(v,c) );
+			hi(c) = std::max( hi(c), V(v,c) );
+		}
+	}
+	const int dims = std::min( int( V.cols() ), 3 );
+	const double cells = double( ( 1 << 21 ) - 1 );
+	std::vector< uint64_t > codes( V.rows() );
+	parallel_for( int( V.rows() ), [&]( const int v )
+	{
+		uint64_t code = 0;
+		for( int c = 0; c < dims; ++c ) {
+			const double extent = hi(c) - lo(c);
+			const double t = extent > 0 && std::isfinite( V(v,c) ) ? ( V(v,c) - lo(c) )/extent : 0.0;
+			code |= spread_bits( uint64_t( std::min( cells, std::max( 0.0, t*cells ) ) ) ) << c;
+		}
+		codes[v] = code;
+	} );
+	sorted_order( codes, order.vertices );
+	std::vector< int > new_vertices;
+	inverse_order( order.vertices, new_vertices );
+
+	// A counting sort of the faces by their first vertex.
+	std::vector< int > first( F.rows() ), offsets( V.rows() + 1, 0 );
+	for( int f = 0; f < F.rows(); ++f ) {
+		first[f] = std::min( new_vertices[ F(f,0) ], std::min( new_vertices[ F(f,1) ], new_vertices[ F(f,2) ] ) );
+		++offsets[ first[f] + 1 ];
+	}
+	for( int v = 0; v < V.rows(); ++v ) offsets[v+1] += offsets[v];
+	order.faces.resize( F.rows() );
+	for( int f = 0; f < F.rows(); ++f ) order.faces[ offsets[ first[f] ]++ ] = f;
+
+	std::vector< char > placed( TC.rows(), 0 );
+	order.tcs.clear();
+	order.tcs.reserve( TC.rows() );
+	for( auto f : order.faces ) {
+		for( int k = 0; k < FT.cols(); ++k ) {
+			const int t = FT(f,k);
+			if( !placed[t] ) placed[t] = 1, order.tcs.push_back( t );
+		}
+	}
+	for( int t = 0; t < TC.rows(); ++t ) {
+		if( !placed[t] ) order.tcs.push_back( t );
+	}
+}
+
+void reorder_mesh(
+	const MeshOrder & order,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out )
+{
+	assert( int( order.vertices.size() ) == V.rows() && int( order.tcs.size() ) == TC.rows() && int( order.faces.size() ) == F.rows() );
+	std::vector< int > new_vertices, new_tcs;
+	inverse_order( order.vertices, new_vertices );
+	inverse_order( order.tcs, new_tcs );
+	reorder_rows( V, order.vertices.data(), int( V.rows() ), V_out );
+	reorder_rows( TC, order.tcs.data(), int( TC.rows() ), TC_out );
+	reorder_faces( F, order.faces.data(), int( F.rows() ), new_vertices, F_out );
+	reorder_faces( FT, order.faces.data(), int( FT.rows() ), new_tcs, FT_out );
+}
+
+void inverse_order( const std::vector< int > & order, std::vector< int > & new_ids )
+{
+	new_ids.assign( order.size(), -1 );
+	for( int i = 0; i < int( order.size() ); ++i ) new_ids[ order[i] ] = i;
+}
+
+void sort_by_origins(
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXi & FT,
+	Eigen::VectorXi & vertex_origins,
+	Eigen::VectorXi & tc_origins,
+	Eigen::VectorXi & face_origins )
+{
+	assert( vertex_origins.size() == V.rows() && tc_origins.size() == TC.rows() && face_origins.size() == F.rows() );
+	const auto & sort_rows = []( Eigen::VectorXi & origins, std::vector< int > & order, std::vector< int > & new_ids )
+	{
+		sorted_order( std::vector< int >( origins.data(), origins.data() + origins.size() ), order );
+		inverse_order( order, new_ids );
+		const Eigen::VectorXi unsorted = origins;
+		for( int i = 0; i < int( order.size() ); ++i ) origins(i) = unsorted( order[i] );
+	};
+	std::vector< int > vertex_order, tc_order, face_order, new_vertices, new_tcs, new_faces;
+	sort_rows( vertex_origins, vertex_order, new_vertices );
+	sort_rows( tc_origins, tc_order, new_tcs );
+	sort_rows( face_origins, face_order, new_faces );
+
+	Eigen::MatrixXd sorted;
+	reorder_rows( V, vertex_order.data(), int( V.rows() ), sorted );
+	V.swap( sorted );
+	reorder_rows( TC, tc_order.data(), int( TC.rows() ), sorted );
+	TC.swap( sorted );
+	Eigen::MatrixXi sorted_faces;
+	reorder_faces( F, face_order.data(), int( F.rows() ), new_vertices, sorted_faces );
+	F.swap( sorted_faces );
+	reorder_faces( FT, face_order.data(), int( FT.rows() ), new_tcs, sorted_faces );
+	FT.swap( sorted_faces );
+}
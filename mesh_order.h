@@ -0,0 +1,54 @@
+#ifndef MESH_ORDER_H
+#define MESH_ORDER_H
+
+#include <Eigen/Core>
+#include <vector>
+
+// An order of the rows of a mesh. Row i of the reordered V, TC and F is row
+// vertices[i], tcs[i] and faces[i] of the original.
+struct MeshOrder
+{
+	std::vector< int > vertices, tcs, faces;
+};
+
+// An order in which the neighbors of a vertex or face are mostly close by in
+// memory, for meshes exported in an arbitrary order: the vertices along a
+// Morton curve through the bounding box of their positions, the faces by
+// their first vertex in that order, and the texture coordinates by the first
+// face using them, followed by those no face uses. Ties keep the original
+// order, so the same mesh always gets the same order.
+void spatial_mesh_order(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	MeshOrder & order );
+
+// (V,F,TC,FT) in the given order.
+void reorder_mesh(
+	const MeshOrder & order,
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out );
+
+// The row each row goes to in the given order, i.e. new_ids[ order[i] ] = i.
+void inverse_order( const std::vector< int > & order, std::vector< int > & new_ids );
+
+// Sorts the rows of V, TC and F by the row of the original mesh each one
+// comes from, given by vertex_origins, tc_origins and face_origins, which are
+// sorted along with them. F and FT are renumbered to match.
+void sort_by_origins(
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXi & FT,
+	Eigen::VectorXi & vertex_origins,
+	Eigen::VectorXi & tc_origins,
+	Eigen::VectorXi & face_origins );
+
+#endif
@@ -1,5 +1,5 @@
 #include "neighbor_faces_and_boundary.h"
-#include <unordered_set>
+#include <algorithm>
 
 void neighbor_faces_and_boundary (
 	const int e,
@@ -33,7 +33,7 @@ void neighbor_faces_and_boundary (
 		};
 	// Always start with first face (ccw in step will be sure to turn right
   	// direction)
-  	std::unordered_set<int> nfaces;
+  	std::vector<int> nfaces;
   	std::vector<std::pair<int,int>> b1, b2;
 	const int f0 = EF(e,0);
 	int fi = f0;
@@ -42,7 +42,7 @@ void neighbor_faces_and_boundary (
 	while(true)
 	{
 		step(ei,fi,true,ei,fi,fvi);
-		nfaces.insert(fi);
+		nfaces.push_back(fi);
 		b1.push_back(std::make_pair(fi,fvi));
 		// back to start?
 		if(fi == f0)
@@ -54,7 +54,7 @@ void neighbor_faces_and_boundary (
 	while(true)
 	{
 		step(ei,fi,false,ei,fi,fvi);
-		nfaces.insert(fi);
+		nfaces.push_back(fi);
 		b2.push_back(std::make_pair(fi,fvi));
 		// back to start?
 		if(fi == f0)
@@ -64,12 +64,83 @@ void neighbor_faces_and_boundary (
 		}
 	}
 	
-	neigh_faces.resize(nfaces.size());
-	std::copy(nfaces.begin(), nfaces.end(), neigh_faces.begin());
+	// Sorted, rather than in the order of a hash set, which depends on the
+	// standard library.
+	std::sort(nfaces.begin(), nfaces.end());
+	nfaces.erase(std::unique(nfaces.begin(), nfaces.end()), nfaces.end());
+	neigh_faces.assign(nfaces.begin(), nfaces.end());
 	
 	const int k=b1.size(), n=b2.size();
 	assert( k > 2 && n > 2 );
 	boundary.resize(k+n-4);
 	std::copy(b1.begin()+1, b1.begin()+k-1, boundary.begin());
 	std::copy(b2.begin()+1, b2.begin()+n-1, boundary.begin()+k-2);
-}
\ No newline at end of file
+}
+void circulation_faces (
+	const int e,
+	const bool ccw,
+	const Eigen::VectorXi & EMAP,
+	const Eigen::MatrixXi & EF,
+	const Eigen::MatrixXi & EI,
+	std::vector<int> & faces
+) {
+	faces.clear();
+	const int m = EMAP.size()/3;
+	const int dir = ccw?-1:1;
+	// Always start with first face (ccw in step will be sure to turn right
+	// direction)
+	const int f0 = EF(e,0);
+	int fi = f0;
+	int ei = e;
+	while(true) {
+		assert((EF(ei,1) == fi || EF(ei,0) == fi) && "e should touch ff");
+		const int nside = EF(ei,0)==fi?1:0;
+		const int nv = EI(ei,nside);
+		// get next face and edge
+		fi = EF(ei,nside);
+		ei = EMAP(fi+m*((nv+dir+3)%3));
+		faces.push_back(fi);
+		// back to start?
+		if(fi == f0) {
+			assert(ei == e);
+			break;
+		}
+	}
+}
+
+namespace {
+	// The distinct vertices of faces, sorted.
+	void sorted_vertices( const Eigen::MatrixXi & F, const std::vector<int> & faces, std::vector<int> & vertices )
+	{
+		vertices.clear();
+		for(auto f : faces) {
+			for(int k=0; k<3; k++) vertices.push_back(F(f,k));
+		}
+		std::sort(vertices.begin(), vertices.end());
+		vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+	}
+}
+
+bool edge_collapse_is_valid (
+	const Eigen::MatrixXi & F,
+	const std::vector<int> & faces_s,
+	const std::vector<int> & faces_d,
+	std::vector<int> & vertices_s,
+	std::vector<int> & vertices_d
+) {
+	// The vertex neighbors of s and d, each including s and d, must have
+	// exactly s, d and the two opposite vertices in common. Vertices of high
+	// valence have long one-rings, so they are intersected sorted.
+	sorted_vertices(F,faces_s,vertices_s);
+	sorted_vertices(F,faces_d,vertices_d);
+	int shared = 0;
+	for(auto a = vertices_s.begin(), b = vertices_d.begin(); a != vertices_s.end() && b != vertices_d.end(); ) {
+		if(*a < *b) ++a;
+		else if(*b < *a) ++b;
+		else ++shared, ++a, ++b;
+	}
+	if(shared != 4) return false;
+	// single tet, don't collapse
+	if(vertices_s.size() == 4 && vertices_d.size() == 4) return false;
+	return true;
+}
@@ -18,4 +18,27 @@ void neighbor_faces_and_boundary (
 	std::vector<std::pair<int,int>> & boundary
 );
 
+// Like igl::circulation(), but into `faces`, whose storage is reused, so that
+// it doesn't allocate once faces has grown to the largest one-ring.
+void circulation_faces (
+	const int e,
+	const bool ccw,
+	const Eigen::VectorXi & EMAP,
+	const Eigen::MatrixXi & EF,
+	const Eigen::MatrixXi & EI,
+	std::vector<int> & faces
+);
+
+// Like igl::edge_collapse_is_valid() (the link condition), given the faces
+// around both ends of e from circulation_faces(). vertices_s and vertices_d
+// get the sorted vertices of those faces; their storage is reused, so it
+// doesn't allocate once they have grown to the largest one-ring.
+bool edge_collapse_is_valid (
+	const Eigen::MatrixXi & F,
+	const std::vector<int> & faces_s,
+	const std::vector<int> & faces_d,
+	std::vector<int> & vertices_s,
+	std::vector<int> & vertices_d
+);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Sets the number of threads used by parallel_for(). n <= 0 keeps the
+// OpenMP default (usually one thread per core).
+inline void set_num_threads( int n )
+{
+#ifdef _OPENMP
+	if( n > 0 ) omp_set_num_threads( n );
+#else
+	(void)n;
+#endif
+}
+
+// Returns the number of threads parallel_for() will use.
+inline int num_threads()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+// Returns the index of the calling thread inside parallel_for(), in
+// [0,num_threads()).
+inline int thread_index()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+// Calls func(i) for every i in [0,n). Iterations run concurrently when OpenMP
+// is enabled, so they must not write to shared state. Without OpenMP this is a
+// plain loop. Threads take `grain` iterations at a time; use a small grain
+// when every iteration is expensive and n is small.
+template <typename Func>
+inline void parallel_for( const int n, const Func & func, const int grain = 64 )
+{
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic,grain)
+#else
+	(void)grain;
+#endif
+	for( int i = 0; i < n; ++i ) func( i );
+}
+
+#endif
@@ -0,0 +1,297 @@
+#include "placement_solver.h"
+
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+
+#include "eiquadprog.h"
+
+namespace {
+	// Weight of the regularizer that makes G positive definite.
+	const double w = 1e-6;
+
+	// Replaces the lower triangle of A by its Cholesky factor L, A = L L'.
+	// Returns false if A is not (numerically) positive definite.
+	template< int N >
+	bool cholesky_factor( Eigen::Matrix<double,N,N> & A )
+	{
+		for( int j = 0; j < N; ++j ) {
+			double d = A(j,j);
+			for( int k = 0; k < j; ++k ) d -= A(j,k)*A(j,k);
+			// Also rejects NaN.
+			if( !( d > 0 ) ) return false;
+			d = std::sqrt( d );
+			A(j,j) = d;
+			for( int i = j+1; i < N; ++i ) {
+				double s = A(i,j);
+				for( int k = 0; k < j; ++k ) s -= A(i,k)*A(j,k);
+				A(i,j) = s/d;
+			}
+		}
+		return true;
+	}
+
+	// Solves L L' x = b in place, given the factor from cholesky_factor().
+	template< int N >
+	void cholesky_solve( const Eigen::Matrix<double,N,N> & L, Eigen::Matrix<double,N,1> & b )
+	{
+		for( int i = 0; i < N; ++i ) {
+			double s = b(i);
+			for( int k = 0; k < i; ++k ) s -= L(i,k)*b(k);
+			b(i) = s/L(i,i);
+		}
+		for( int i = N-1; i >= 0; --i ) {
+			double s = b(i);
+			for( int k = i+1; k < N; ++k ) s -= L(k,i)*b(k);
+			b(i) = s/L(i,i);
+		}
+	}
+}
+
+void placement_qp_5d(
+	const Quadric5d & q,
+	const PlacementVector6d & mid,
+	PlacementMatrix6d & G,
+	PlacementVector6d & g0 )
+{
+	G = q.matrix();
+	G += w*PlacementMatrix6d::Identity();
+	g0 = -w*mid;
+}
+
+bool solve_placement_5d(
+	const PlacementMatrix6d & G,
+	const PlacementVector6d & g0,
+	PlacementVector6d & x )
+{
+	// With x(5) fixed to 1 the minimizer of the remaining five unknowns y
+	// solves G(0:5,0:5) y = -( G(0:5,5) + g0(0:5) ).
+	Eigen::Matrix<double,5,5> L = G.topLeftCorner<5,5>();
+	if( !cholesky_factor( L ) ) return false;
+	Eigen::Matrix<double,5,1> y = -( G.topRightCorner<5,1>() + g0.head<5>() );
+	cholesky_solve( L, y );
+	x.head<5>() = y;
+	x(5) = 1.0;
+	return true;
+}
+
+bool solve_placement_5d_quadprog(
+	const PlacementMatrix6d & G_in,
+	const PlacementVector6d & g0_in,
+	PlacementVector6d & x )
+{
+	using namespace Eigen;
+	MatrixXd G = G_in;
+	VectorXd g0 = g0_in;
+	MatrixXd CE(6,1);
+	CE.setZero();
+	CE(5,0) = 1.0;
+	VectorXd ce0(1);
+	ce0 << -1;
+	MatrixXd CI;
+	VectorXd ci0;
+	VectorXd Z;
+	const double f = solve_quadprog(G,g0,CE,ce0,CI,ci0,Z);
+	x = Z;
+	return std::isfinite( f );
+}
+
+void seam_placement_qp_5d(
+	const Quadric5d q[2],
+	const PlacementVector8d & mid,
+	PlacementMatrix8d & G,
+	PlacementVector8d & g0 )
+{
+	const Quadric5d::Matrix m[2] = { q[0].matrix(), q[1].matrix() };
+	// The position is shared by both sides, each side has its own uv.
+	G.setZero();
+	G.block<3,3>(0,0) = m[0].block<3,3>(0,0) + m[1].block<3,3>(0,0);
+	G.block<2,3>(3,0) = m[0].block<2,3>(3,0);
+	G.block<3,2>(0,3) = m[0].block<3,2>(0,3);
+	G.block<2,2>(3,3) = m[0].block<2,2>(3,3);
+	G.block<2,3>(5,0) = m[1].block<2,3>(3,0);
+	G.block<3,2>(0,5) = m[1].block<3,2>(0,3);
+	G.block<2,2>(5,5) = m[1].block<2,2>(3,3);
+	// The linear term of the combined metric.
+	Eigen::Matrix<double,1,7> b;
+	b.segment<3>(0) = m[0].block<1,3>(5,0) + m[1].block<1,3>(5,0);
+	b.segment<2>(3) = m[0].block<1,2>(5,3);
+	b.segment<2>(5) = m[1].block<1,2>(5,3);
+	G.block<1,7>(7,0) = b;
+	G.block<7,1>(0,7) = b.transpose();
+	G(7,7) = m[0](5,5) + m[1](5,5);
+
+	G += w*PlacementMatrix8d::Identity();
+	g0 = -w*mid;
+}
+
+bool solve_seam_placement_5d(
+	const PlacementMatrix8d & G,
+	const PlacementVector8d & g0,
+	const Eigen::Vector2d & uv0, const Eigen::Vector2d & duv0,
+	const Eigen::Vector2d & uv1, const Eigen::Vector2d & duv1,
+	PlacementVector8d & x )
+{
+	// The feasible points are x = c + t*d + (p,0,0,0,0,0) with the position p
+	// and t as the only unknowns.
+	PlacementVector8d c, d;
+	c << 0, 0, 0, uv0, uv1, 1;
+	d << 0, 0, 0, duv0, duv1, 0;
+	const PlacementVector8d Gd = G*d;
+	const PlacementVector8d r = G*c + g0;
+
+	// For fixed t, the best position is p(t) = -( Pr + t*Pd ).
+	Eigen::Matrix3d L = G.topLeftCorner<3,3>();
+	if( !cholesky_factor( L ) ) return false;
+	Eigen::Vector3d Pr = r.head<3>();
+	Eigen::Vector3d Pd = Gd.head<3>();
+	cholesky_solve( L, Pr );
+	cholesky_solve( L, Pd );
+
+	// What remains is the 1D quadratic 1/2 a t^2 + b t on [0,1]. Since it is
+	// convex, its constrained minimizer is the clamped unconstrained one.
+	const double a = d.dot( Gd ) - Gd.head<3>().dot( Pd );
+	const double b = d.dot( r ) - Gd.head<3>().dot( Pr );
+	if( !( a > 0 ) ) return false;
+	const double t = std::min( 1.0, std::max( 0.0, -b/a ) );
+
+	x = c + t*d;
+	x.head<3>() = -( Pr + t*Pd );
+	return true;
+}
+
+bool solve_seam_placement_5d_quadprog(
+	const PlacementMatrix8d & G_in,
+	const PlacementVector8d & g0_in,
+	const Eigen::Vector2d & uv0, const Eigen::Vector2d & duv0,
+	const Eigen::Vector2d & uv1, const Eigen::Vector2d & duv1,
+	PlacementVector8d & x )
+{
+	using namespace Eigen;
+	MatrixXd G = G_in;
+	VectorXd g0 = g0_in;
+	const Vector2d vec[2] = { duv0, duv1 };
+
+	// equality constraints:
+	// x(7) - 1 = 0
+	// (x(3) - b0_u0) - t(b0_u1 - b0_u0) = 0
+	// (x(4) - b0_v0) - t(b0_v1 - b0_v0) = 0
+	// (x(5) - b1_u0) - t(b1_u1 - b1_u0) = 0
+	// (x(6) - b1_v0) - t(b1_v1 - b1_v0) = 0
+	MatrixXd CE(8,4);
+	VectorXd ce0(4);
+	CE.setZero();
+	CE(7,0) = 1.0;
+	ce0(0) = -1;
+	if( vec[0](0) != 0 ) {		 // t = (x(3) - b0_u0)/(b0_u1 - b0_u0)
+		CE(3,1) = -vec[0](1);
+		CE(4,1) = vec[0](0);
+		ce0(1) = vec[0](1)*uv0(0) - vec[0](0)*uv0(1);
+		CE(3,2) = -vec[1](0);
+		CE(5,2) = vec[0](0);
+		ce0(2) = vec[1](0)*uv0(0) - vec[0](0)*uv1(0);
+		CE(3,3) = -vec[1](1);
+		CE(6,3) = vec[0](0);
+		ce0(3) = vec[1](1)*uv0(0) - vec[0](0)*uv1(1);
+	}
+	else {						// t = (x(4) - b0_v0)/(b0_v1 - b0_v0)
+		assert( vec[0](1) != 0 );
+		CE(4,1) = -vec[0](0);
+		CE(3,1) = vec[0](1);
+		ce0(1) = vec[0](0)*uv0(1) - vec[0](1)*uv0(0);
+		CE(4,2) = -vec[1](0);
+		CE(5,2) = vec[0](1);
+		ce0(2) = vec[1](0)*uv0(1) - vec[0](1)*uv1(0);
+		CE(4,3) = -vec[1](1);
+		CE(6,3) = vec[0](1);
+		ce0(3) = vec[1](1)*uv0(1) - vec[0](1)*uv1(1);
+	}
+
+	// inequality constraints:
+	// t >= 0 && t <= 1
+	MatrixXd CI(8,2);
+	VectorXd ci0(2);
+	CI.setZero();
+	if( vec[0](0) != 0 ) {
+		double sign = vec[0](0) > 0 ? 1 : -1;
+		CI(3,0) = sign;
+		ci0(0) = -sign*uv0(0);
+		CI(3,1) = -sign;
+		ci0(1) = sign*(uv0(0)+vec[0](0));
+	}
+	else {
+		double sign = vec[0](1) > 0 ? 1 : -1;
+		CI(4,0) = sign;
+		ci0(0) = -sign*uv0(1);
+		CI(4,1) = -sign;
+		ci0(1) = sign*(uv0(1)+vec[0](1));
+	}
+
+	VectorXd Z;
+	const double f = solve_quadprog(G,g0,CE,ce0,CI,ci0,Z);
+	x = Z;
+	return std::isfinite( f );
+}
+
+PlacementBatch5d::PlacementBatch5d()
+{
+	for( int side = 0; side < 2; ++side ) {
+		for( int i = 0; i < 5; ++i ) p[side][i].setZero();
+		for( int k = 0; k < 21; ++k ) q[side][k].setZero();
+	}
+	fixed.setZero();
+}
+
+void solve_placement_batch_5d( PlacementBatch5d & batch )
+{
+	typedef PlacementLanes Lanes;
+
+	for( int k = 0; k < 21; ++k ) batch.quadric[k] = batch.q[0][k] + batch.q[1][k];
+	const Lanes * Q = batch.quadric;
+
+	// The same steps as solve_placement_5d(), with cholesky_factor() and
+	// cholesky_solve() unrolled over the lanes.
+	Lanes L[5][5];
+	Lanes y[5];
+	for( int i = 0; i < 5; ++i ) {
+		for( int j = 0; j <= i; ++j ) L[i][j] = Q[ Quadric5d::index( i, j ) ];
+		L[i][i] += w;
+		const Lanes mid = ( batch.p[0][i] + batch.p[1][i] )/2;
+		y[i] = -( Q[ Quadric5d::index( i, 5 ) ] - w*mid );
+	}
+
+	Lanes failed = Lanes::Zero();
+	for( int j = 0; j < 5; ++j ) {
+		Lanes d = L[j][j];
+		for( int k = 0; k < j; ++k ) d -= L[j][k]*L[j][k];
+		// Also catches NaN.
+		failed = ( d > 0 ).select( failed, Lanes::Ones() );
+		d = d.sqrt();
+		L[j][j] = d;
+		for( int i = j+1; i < 5; ++i ) {
+			Lanes s = L[i][j];
+			for( int k = 0; k < j; ++k ) s -= L[i][k]*L[j][k];
+			L[i][j] = s/d;
+		}
+	}
+	for( int i = 0; i < 5; ++i ) {
+		for( int k = 0; k < i; ++k ) y[i] -= L[i][k]*y[k];
+		y[i] /= L[i][i];
+	}
+	for( int i = 4; i >= 0; --i ) {
+		for( int k = i+1; k < 5; ++k ) y[i] -= L[k][i]*y[k];
+		y[i] /= L[i][i];
+	}
+
+	const Eigen::Array< bool, PLACEMENT_BATCH_SIZE, 1 > fixed = batch.fixed > 0;
+	for( int i = 0; i < 5; ++i ) batch.x[i] = fixed.select( batch.p[0][i], y[i] );
+	batch.failed = fixed.select( Lanes::Zero(), failed );
+
+	// cost = v' Q v with v = (x,1).
+	batch.cost.setZero();
+	for( int i = 0; i < 6; ++i ) {
+		Lanes Qv = Q[ Quadric5d::index( i, 5 ) ];
+		for( int j = 0; j < 5; ++j ) Qv += Q[ Quadric5d::index( i, j ) ]*batch.x[j];
+		batch.cost += i < 5 ? Lanes( batch.x[i]*Qv ) : Qv;
+	}
+}
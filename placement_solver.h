@@ -0,0 +1,106 @@
+#ifndef PLACEMENT_SOLVER_H
+#define PLACEMENT_SOLVER_H
+
+#include <Eigen/Core>
+#include "quadric_store.h"
+
+// The two constrained quadratic programs cost_and_placement_qslim5d_halfedge()
+// solves to place the vertex an edge collapses to. Both minimize
+//     1/2 x' G x + g0' x
+// like solve_quadprog() in eiquadprog.h. The *_quadprog functions hand the
+// problem to eiquadprog; the others eliminate the constraints in closed form
+// on fixed-size matrices, which gives the same minimizer without any heap
+// allocation. The closed-form solvers return false if the reduced system is
+// not positive definite, in which case callers fall back to eiquadprog.
+
+typedef Eigen::Matrix<double,6,6> PlacementMatrix6d;
+typedef Eigen::Matrix<double,6,1> PlacementVector6d;
+typedef Eigen::Matrix<double,8,8> PlacementMatrix8d;
+typedef Eigen::Matrix<double,8,1> PlacementVector8d;
+
+/// Edges away from seams: x = (x,y,z,u,v,1).
+
+// Builds G and g0 for minimizing quadric q, with a small regularizer pulling
+// the solution towards mid = (x,y,z,u,v,1).
+void placement_qp_5d(
+	const Quadric5d & q,
+	const PlacementVector6d & mid,
+	PlacementMatrix6d & G,
+	PlacementVector6d & g0 );
+
+// Minimizes subject to x(5) == 1.
+bool solve_placement_5d(
+	const PlacementMatrix6d & G,
+	const PlacementVector6d & g0,
+	PlacementVector6d & x );
+bool solve_placement_5d_quadprog(
+	const PlacementMatrix6d & G,
+	const PlacementVector6d & g0,
+	PlacementVector6d & x );
+
+/// Seam edges: x = (x,y,z,u0,v0,u1,v1,1), one uv per side of the seam.
+
+// Builds G and g0 for minimizing q[0] on side 0 plus q[1] on side 1, with a
+// small regularizer pulling the solution towards mid = (x,y,z,u0,v0,u1,v1,1).
+void seam_placement_qp_5d(
+	const Quadric5d q[2],
+	const PlacementVector8d & mid,
+	PlacementMatrix8d & G,
+	PlacementVector8d & g0 );
+
+// Minimizes subject to x(7) == 1 and both uvs moving along their side of the
+// seam edge with a common parameter t in [0,1]:
+//     (u0,v0) = uv0 + t*duv0,   (u1,v1) = uv1 + t*duv1
+// Neither duv0 nor duv1 may be zero.
+bool solve_seam_placement_5d(
+	const PlacementMatrix8d & G,
+	const PlacementVector8d & g0,
+	const Eigen::Vector2d & uv0, const Eigen::Vector2d & duv0,
+	const Eigen::Vector2d & uv1, const Eigen::Vector2d & duv1,
+	PlacementVector8d & x );
+bool solve_seam_placement_5d_quadprog(
+	const PlacementMatrix8d & G,
+	const PlacementVector8d & g0,
+	const Eigen::Vector2d & uv0, const Eigen::Vector2d & duv0,
+	const Eigen::Vector2d & uv1, const Eigen::Vector2d & duv1,
+	PlacementVector8d & x );
+
+/// Batches of edges away from seams.
+
+// Number of problems solve_placement_batch_5d() solves at once. Every step of
+// the solve works on whole PlacementLanes, which Eigen evaluates with SIMD
+// packets (SSE2, AVX or NEON, depending on the target flags).
+enum { PLACEMENT_BATCH_SIZE = 8 };
+typedef Eigen::Array< double, PLACEMENT_BATCH_SIZE, 1 > PlacementLanes;
+
+// PLACEMENT_BATCH_SIZE 6x6 placement problems in structure-of-arrays layout:
+// lane l of every array belongs to problem l.
+struct PlacementBatch5d
+{
+	// Input: the two wedges (x,y,z,u,v) being merged and their quadrics, as
+	// the coefficients of Quadric5d::c.
+	PlacementLanes p[2][5];
+	PlacementLanes q[2][21];
+	// Input: 1 if the merged wedge must stay at p[0], 0 to place it optimally.
+	PlacementLanes fixed;
+
+	// Output: the merged quadric q[0] + q[1], the placement x = (x,y,z,u,v)
+	// and its cost under the merged quadric.
+	PlacementLanes quadric[21];
+	PlacementLanes x[5];
+	PlacementLanes cost;
+	// Output: 1 where the closed form failed, leaving x and cost undefined.
+	PlacementLanes failed;
+
+	// Zero-initializes all the problems.
+	PlacementBatch5d();
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+// Solves every problem of `batch` like placement_qp_5d() followed by
+// solve_placement_5d(), or takes x = p[0] where `fixed` is set, and then
+// evaluates the cost of x.
+void solve_placement_batch_5d( PlacementBatch5d & batch );
+
+#endif
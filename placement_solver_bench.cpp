@@ -0,0 +1,185 @@
+// Compares the closed-form placement solvers of placement_solver.h with
+// eiquadprog on the placement problems of every edge of a mesh.
+//
+// usage: placement_solver_bench path/to/input.obj [repetitions]
+
+#include <igl/readOBJ.h>
+#include <igl/edge_flaps.h>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "half_edge.h"
+#include "quadric_error_metric.h"
+#include "placement_solver.h"
+
+namespace {
+	struct SeamProblem
+	{
+		PlacementMatrix8d G;
+		PlacementVector8d g0;
+		Eigen::Vector2d uv[2];
+		Eigen::Vector2d duv[2];
+	};
+
+	template< typename Func >
+	double seconds_for( int repetitions, const Func & func )
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for( int r = 0; r < repetitions; ++r ) func();
+		const auto stop = std::chrono::steady_clock::now();
+		return std::chrono::duration< double >( stop - start ).count();
+	}
+
+	void report( const char * name, double seconds, int count )
+	{
+		std::cout << "  " << name << ": " << 1e9*seconds/count << " ns per solve" << std::endl;
+	}
+}
+
+int main( int argc, char* argv[] )
+{
+	using namespace Eigen;
+
+	if( argc != 2 && argc != 3 ) {
+		std::cerr << "Usage: " << argv[0] << " path/to/input.obj [repetitions]" << std::endl;
+		return -1;
+	}
+	const int repetitions = argc == 3 ? std::max( 1, atoi( argv[2] ) ) : 20;
+
+	MatrixXd V, TC, CN;
+	MatrixXi F, FT, FN;
+	if( !igl::readOBJ( argv[1], V, TC, CN, F, FT, FN ) ) {
+		std::cerr << "Error: Couldn't read the input mesh: " << argv[1] << std::endl;
+		return -1;
+	}
+
+	// Same scaling as the decimater, so the problems are the ones it solves.
+	double total_area = 0.0;
+	for( int i = 0; i < F.rows(); ++i ) {
+		const Vector3d v0 = V.row(F(i,0));
+		const Vector3d v1 = V.row(F(i,1));
+		const Vector3d v2 = V.row(F(i,2));
+		total_area += 0.5*((v1 - v0).cross(v2 - v0)).norm();
+	}
+	const double avg_area = F.rows() > 0 ? total_area/F.rows() : 0.0;
+	const double pos_scale = avg_area > 1e-12 ? sqrt(1.0/avg_area) : 1.0;
+	const double uv_weight = 1.0;
+
+	QuadricStore Vmetrics;
+	half_edge_qslim_5d( V, F, TC, FT, pos_scale, uv_weight, Vmetrics );
+	const MatrixXd V_scaled = V*pos_scale;
+	const MatrixXd TC_scaled = TC*uv_weight;
+
+	MatrixXi E, EF, EI;
+	VectorXi EMAP;
+	igl::edge_flaps( F, E, EMAP, EF, EI );
+
+	// Capture the problem of every interior edge. Edges whose two sides use
+	// the same texcoords get the 6x6 problem, the others the seam problem.
+	std::vector< PlacementMatrix6d, aligned_allocator< PlacementMatrix6d > > G6;
+	std::vector< PlacementVector6d, aligned_allocator< PlacementVector6d > > g6;
+	std::vector< SeamProblem, aligned_allocator< SeamProblem > > seam;
+	for( int e = 0; e < E.rows(); ++e ) {
+		if( EF(e,0) == -1 || EF(e,1) == -1 ) continue;
+		const Bundle b = get_half_edge_bundle( e, E, EF, EI, F, FT );
+		if( b[0].p[0] == b[1].p[1] && b[0].p[1] == b[1].p[0] ) {
+			PlacementVector6d mid;
+			mid.setOnes();
+			mid.head(3) = (V_scaled.row(b[0].p[0].vi) + V_scaled.row(b[0].p[1].vi))/2;
+			mid.segment(3,2) = (TC_scaled.row(b[0].p[0].tci) + TC_scaled.row(b[0].p[1].tci))/2;
+			PlacementMatrix6d G;
+			PlacementVector6d g0;
+			placement_qp_5d( Vmetrics.at(b[0].p[0].vi, b[0].p[0].tci) + Vmetrics.at(b[0].p[1].vi, b[0].p[1].tci), mid, G, g0 );
+			G6.push_back( G );
+			g6.push_back( g0 );
+		}
+		else {
+			SeamProblem problem;
+			Quadric5d q[2];
+			PlacementVector8d mid;
+			mid.setOnes();
+			mid.head(3) = (V_scaled.row(b[0].p[0].vi) + V_scaled.row(b[0].p[1].vi))/2;
+			for( int side = 0; side < 2; ++side ) {
+				q[side] = Vmetrics.at(b[side].p[0].vi, b[side].p[0].tci) + Vmetrics.at(b[side].p[1].vi, b[side].p[1].tci);
+				problem.uv[side] = TC_scaled.row(b[side].p[0].tci);
+				problem.duv[side] = TC_scaled.row(b[side].p[1].tci) - TC_scaled.row(b[side].p[0].tci);
+				mid.segment(3+2*side,2) = (TC_scaled.row(b[side].p[0].tci) + TC_scaled.row(b[side].p[1].tci))/2;
+			}
+			if( problem.duv[0].norm() < 1e-10 || problem.duv[1].norm() < 1e-10 ) continue;
+			seam_placement_qp_5d( q, mid, problem.G, problem.g0 );
+			seam.push_back( problem );
+		}
+	}
+	std::cout << "# 6x6 problems: " << G6.size() << std::endl;
+	std::cout << "# seam problems: " << seam.size() << std::endl;
+
+	// Agreement of the two paths, measured on the objective the decimater
+	// uses as the collapse cost.
+	double max_dx6 = 0, max_dx8 = 0, max_dcost6 = 0, max_dcost8 = 0;
+	int failed6 = 0, failed8 = 0;
+	for( size_t i = 0; i < G6.size(); ++i ) {
+		PlacementVector6d x, y;
+		if( !solve_placement_5d( G6[i], g6[i], x ) ) { ++failed6; continue; }
+		solve_placement_5d_quadprog( G6[i], g6[i], y );
+		max_dx6 = std::max( max_dx6, (x - y).cwiseAbs().maxCoeff()/std::max( 1.0, y.cwiseAbs().maxCoeff() ) );
+		const double cx = x.dot( G6[i]*x ), cy = y.dot( G6[i]*y );
+		max_dcost6 = std::max( max_dcost6, std::abs( cx - cy )/std::max( 1.0, std::abs( cy ) ) );
+	}
+	for( size_t i = 0; i < seam.size(); ++i ) {
+		const SeamProblem & p = seam[i];
+		PlacementVector8d x, y;
+		if( !solve_seam_placement_5d( p.G, p.g0, p.uv[0], p.duv[0], p.uv[1], p.duv[1], x ) ) { ++failed8; continue; }
+		solve_seam_placement_5d_quadprog( p.G, p.g0, p.uv[0], p.duv[0], p.uv[1], p.duv[1], y );
+		max_dx8 = std::max( max_dx8, (x - y).cwiseAbs().maxCoeff()/std::max( 1.0, y.cwiseAbs().maxCoeff() ) );
+		const double cx = x.dot( p.G*x ), cy = y.dot( p.G*y );
+		max_dcost8 = std::max( max_dcost8, std::abs( cx - cy )/std::max( 1.0, std::abs( cy ) ) );
+	}
+	std::cout << "6x6: max relative difference in x " << max_dx6 << ", in cost " << max_dcost6
+	          << ", closed form failures " << failed6 << std::endl;
+	std::cout << "seam: max relative difference in x " << max_dx8 << ", in cost " << max_dcost8
+	          << ", closed form failures " << failed8 << std::endl;
+
+	// Timings. The sum of the results keeps the solves from being optimized out.
+	double sink = 0;
+	if( !G6.empty() ) {
+		std::cout << "6x6 problems:" << std::endl;
+		report( "closed form", seconds_for( repetitions, [&]() {
+			PlacementVector6d x;
+			for( size_t i = 0; i < G6.size(); ++i ) { solve_placement_5d( G6[i], g6[i], x ); sink += x(0); }
+		} ), repetitions*int( G6.size() ) );
+		report( "eiquadprog ", seconds_for( repetitions, [&]() {
+			PlacementVector6d x;
+			for( size_t i = 0; i < G6.size(); ++i ) { solve_placement_5d_quadprog( G6[i], g6[i], x ); sink += x(0); }
+		} ), repetitions*int( G6.size() ) );
+	}
+	if( !seam.empty() ) {
+		std::cout << "seam problems:" << std::endl;
+		report( "closed form", seconds_for( repetitions, [&]() {
+			PlacementVector8d x;
+			for( size_t i = 0; i < seam.size(); ++i ) {
+				const SeamProblem & p = seam[i];
+				solve_seam_placement_5d( p.G, p.g0, p.uv[0], p.duv[0], p.uv[1], p.duv[1], x );
+				sink += x(0);
+			}
+		} ), repetitions*int( seam.size() ) );
+		report( "eiquadprog ", seconds_for( repetitions, [&]() {
+			PlacementVector8d x;
+			for( size_t i = 0; i < seam.size(); ++i ) {
+				const SeamProblem & p = seam[i];
+				solve_seam_placement_5d_quadprog( p.G, p.g0, p.uv[0], p.duv[0], p.uv[1], p.duv[1], x );
+				sink += x(0);
+			}
+		} ), repetitions*int( seam.size() ) );
+	}
+	std::cerr << "(checksum " << sink << ")" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include "procedural_mesh.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	const double PI = 3.14159265358979323846;
+	// ATLAS_MESH has CHARTS by CHARTS charts.
+	const int CHARTS = 4;
+
+	// A deterministic value in [-1,1] for each (i,j).
+	double noise( int i, int j )
+	{
+		unsigned int h = unsigned( i )*73856093u ^ unsigned( j )*19349663u;
+		h ^= h >> 13;
+		h *= 0x5bd1e995u;
+		h ^= h >> 15;
+		return ( h & 0xffffff )/double( 0x7fffff ) - 1.0;
+	}
+
+	// The height of the height field at (x,y) in [0,1]^2, grid point (i,j).
+	double height( double x, double y, int i, int j )
+	{
+		return 0.05*sin( 6*PI*x )*cos( 4*PI*y ) + 0.02*sin( 23*x + 17*y ) + 0.002*noise( i, j );
+	}
+
+	// Two triangles per cell of an nx by ny grid whose corner (i,j) is
+	// index(i,j) into V and texcoord(i,j) into TC.
+	template< typename VertexIndex, typename TexcoordIndex >
+	void triangulate_grid(
+		int nx,
+		int ny,
+		const VertexIndex & index,
+		const TexcoordIndex & texcoord,
+		Eigen::MatrixXi & F,
+		Eigen::MatrixXi & FT )
+	{
+		F.resize( 2*nx*ny, 3 );
+		FT.resize( 2*nx*ny, 3 );
+		int f = 0;
+		for( int j = 0; j < ny; ++j ) {
+			for( int i = 0; i < nx; ++i ) {
+				const int ci[4] = { i, i+1, i+1, i };
+				const int cj[4] = { j, j, j+1, j+1 };
+				const int tris[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+				for( const auto & tri : tris ) {
+					for( int k = 0; k < 3; ++k ) {
+						F( f, k ) = index( ci[tri[k]], cj[tri[k]] );
+						FT( f, k ) = texcoord( i, j, ci[tri[k]], cj[tri[k]] );
+					}
+					++f;
+				}
+			}
+		}
+	}
+
+	void make_height_field( int n, Eigen::MatrixXd & V )
+	{
+		V.resize( (n+1)*(n+1), 3 );
+		for( int j = 0; j <= n; ++j ) {
+			for( int i = 0; i <= n; ++i ) {
+				const double x = double( i )/n;
+				const double y = double( j )/n;
+				V.row( j*(n+1) + i ) << x, y, height( x, y, i, j );
+			}
+		}
+	}
+}
+
+const char * procedural_mesh_name( ProceduralMeshKind kind )
+{
+	switch( kind ) {
+		case PLANE_MESH: return "plane";
+		case TORUS_MESH: return "torus";
+		case ATLAS_MESH: return "atlas";
+		default: break;
+	}
+	assert( false && "Unknown mesh kind" );
+	return "";
+}
+
+void make_procedural_mesh(
+	ProceduralMeshKind kind,
+	int num_faces,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT )
+{
+	if( kind == TORUS_MESH ) {
+		// Cells as close to square as the radii allow.
+		const double R = 1.0, r = 0.4;
+		const int ny = std::max( 3, int( lround( sqrt( num_faces*r/( 2*R ) ) ) ) );
+		const int nx = std::max( 3, int( lround( num_faces/( 2.0*ny ) ) ) );
+		V.resize( nx*ny, 3 );
+		for( int j = 0; j < ny; ++j ) {
+			for( int i = 0; i < nx; ++i ) {
+				const double theta = 2*PI*i/nx;
+				const double phi = 2*PI*j/ny;
+				const double bump = 1.0 + 0.1*sin( 5*theta )*sin( 3*phi ) + 0.01*noise( i, j );
+				const double ring = R + r*bump*cos( phi );
+				V.row( j*nx + i ) << ring*cos( theta ), ring*sin( theta ), r*bump*sin( phi );
+			}
+		}
+		// The texture coordinates don't wrap, which cuts the seams.
+		TC.resize( (nx+1)*(ny+1), 2 );
+		for( int j = 0; j <= ny; ++j ) {
+			for( int i = 0; i <= nx; ++i ) TC.row( j*(nx+1) + i ) << double( i )/nx, double( j )/ny;
+		}
+		triangulate_grid( nx, ny,
+			[nx,ny]( int i, int j ) { return ( j % ny )*nx + ( i % nx ); },
+			[nx]( int, int, int i, int j ) { return j*(nx+1) + i; },
+			F, FT );
+		return;
+	}
+
+	const int n = std::max( 2, int( lround( sqrt( num_faces/2.0 ) ) ) );
+	make_height_field( n, V );
+	if( kind == PLANE_MESH ) {
+		TC = V.leftCols( 2 );
+		triangulate_grid( n, n,
+			[n]( int i, int j ) { return j*(n+1) + i; },
+			[n]( int, int, int i, int j ) { return j*(n+1) + i; },
+			F, FT );
+		return;
+	}
+
+	assert( kind == ATLAS_MESH );
+	// Cell i is in chart column i*charts/n, which starts at cell begin[column].
+	const int charts = std::min( CHARTS, n );
+	std::vector< int > begin( charts + 1, n );
+	for( int i = n - 1; i >= 0; --i ) begin[ i*charts/n ] = i;
+	// The texture coordinate of grid point (i,j) in chart (ci,cj), of which
+	// there are up to four per point, in the cells around it.
+	const auto chart_of = [n,charts]( int i ) { return std::min( i, n - 1 )*charts/n; };
+	std::vector< int > first_tc( (n+1)*(n+1) + 1, 0 );
+	for( int j = 0; j <= n; ++j ) {
+		for( int i = 0; i <= n; ++i ) {
+			const int ci0 = chart_of( std::max( i - 1, 0 ) ), ci1 = chart_of( i );
+			const int cj0 = chart_of( std::max( j - 1, 0 ) ), cj1 = chart_of( j );
+			first_tc[ j*(n+1) + i + 1 ] = ( ci1 - ci0 + 1 )*( cj1 - cj0 + 1 );
+		}
+	}
+	for( int p = 0; p < (n+1)*(n+1); ++p ) first_tc[p+1] += first_tc[p];
+	TC.resize( first_tc.back(), 2 );
+	const auto texcoord = [&]( int cell_i, int cell_j, int i, int j )
+	{
+		const int ci = chart_of( cell_i ), cj = chart_of( cell_j );
+		const int ci0 = chart_of( std::max( i - 1, 0 ) ), cj0 = chart_of( std::max( j - 1, 0 ) );
+		const int ci1 = chart_of( i );
+		return first_tc[ j*(n+1) + i ] + ( cj - cj0 )*( ci1 - ci0 + 1 ) + ( ci - ci0 );
+	};
+	for( int j = 0; j <= n; ++j ) {
+		for( int i = 0; i <= n; ++i ) {
+			for( int cj = chart_of( std::max( j - 1, 0 ) ); cj <= chart_of( j ); ++cj ) {
+				for( int ci = chart_of( std::max( i - 1, 0 ) ); ci <= chart_of( i ); ++ci ) {
+					// Each chart is scaled differently, so the UVs on the two
+					// sides of a seam don't match.
+					const double scale = 0.8 + 0.15*noise( ci, cj );
+					const double u = double( i - begin[ci] )/( begin[ci+1] - begin[ci] ) - 0.5;
+					const double v = double( j - begin[cj] )/( begin[cj+1] - begin[cj] ) - 0.5;
+					TC.row( texcoord( begin[ci], begin[cj], i, j ) ) << ( ci + 0.5 + scale*u )/charts, ( cj + 0.5 + scale*v )/charts;
+				}
+			}
+		}
+	}
+	triangulate_grid( n, n,
+		[n]( int i, int j ) { return j*(n+1) + i; },
+		texcoord,
+		F, FT );
+}
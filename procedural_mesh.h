@@ -0,0 +1,39 @@
+#ifndef PROCEDURAL_MESH_H
+#define PROCEDURAL_MESH_H
+
+#include <Eigen/Core>
+
+// UV-mapped triangle meshes generated from a grid of quads, so that
+// benchmarks can run on meshes of any size without shipping them. The same
+// kind and number of faces always give the same mesh.
+enum ProceduralMeshKind
+{
+	// A bumpy height field with one UV chart: a boundary and no seams.
+	PLANE_MESH,
+	// A bumpy torus whose UVs wrap around it: seams along two loops and no
+	// boundary.
+	TORUS_MESH,
+	// The height field of PLANE_MESH cut into charts of different scales
+	// packed into one atlas: seams between the charts and a boundary.
+	ATLAS_MESH,
+	NUM_PROCEDURAL_MESH_KINDS
+};
+
+// Returns "plane", "torus" or "atlas".
+const char * procedural_mesh_name( ProceduralMeshKind kind );
+
+// Generates a mesh of the given kind with about num_faces faces.
+// Outputs:
+//   V  #V by 3 list of vertex positions
+//   TC  #TC by 2 list of texture coordinates
+//   F  #F by 3 list of face indices into V
+//   FT  #F by 3 list of face indices into TC
+void make_procedural_mesh(
+	ProceduralMeshKind kind,
+	int num_faces,
+	Eigen::MatrixXd & V,
+	Eigen::MatrixXd & TC,
+	Eigen::MatrixXi & F,
+	Eigen::MatrixXi & FT );
+
+#endif
@@ -1,23 +1,76 @@
 #include "quadric_error_metric.h"
+#include "parallel_for.h"
 #include <Eigen/Geometry>
 #include <iostream>
+#include <algorithm>
 
 namespace {
 	const double eps = 1e-7;
+
+	typedef Eigen::Matrix<double,5,1> Vector5d;
+
+	// Groups the corners of F by the index stored in them. On return, the
+	// corners (3*f + j) with F(f,j) == i are corners[start[i]] to
+	// corners[start[i+1]-1], in increasing order.
+	void corner_incidence(
+		const Eigen::MatrixXi& F,
+		const int n,
+		std::vector< int >& start,
+		std::vector< int >& corners)
+	{
+		start.assign( n + 1, 0 );
+		for( int f = 0; f < F.rows(); f++ )
+			for( int j = 0; j < 3; j++ )
+				start[ F(f,j) + 1 ]++;
+		for( int i = 0; i < n; i++ ) start[i+1] += start[i];
+		
+		corners.resize( 3*F.rows() );
+		std::vector< int > next( start.begin(), start.end() - 1 );
+		for( int f = 0; f < F.rows(); f++ )
+			for( int j = 0; j < 3; j++ )
+				corners[ next[ F(f,j) ]++ ] = 3*f + j;
+	}
+
+	// Adds face_Q[i] to the wedges of the three corners of every face i with
+	// add( vi, ti, q ). The wedges must exist; each texcoord is summed
+	// separately, in parallel, adding faces in increasing order.
+	template < typename Quadric, typename Add >
+	void add_face_quadrics(
+		const Eigen::MatrixXi& F,
+		const Eigen::MatrixXi& FT,
+		const int num_tcs,
+		const std::vector< Quadric >& face_Q,
+		const Add& add)
+	{
+		std::vector< int > start, corners;
+		corner_incidence( FT, num_tcs, start, corners );
+		parallel_for( num_tcs, [&]( const int ti )
+		{
+			for( int k = start[ti]; k < start[ti+1]; k++ ) {
+				const int i = corners[k]/3;
+				const int vi = F( i, corners[k]%3 );
+				add( vi, ti, face_Q[i] );
+			}
+		} );
+	}
+}
+
+Quadric5d face_quadric_5d(
+	const Vector5d& p1,
+	const Vector5d& p2,
+	const Vector5d& p3)
+{
+	return face_attribute_quadric< 5 >( p1, p2, p3 );
 }
+
 void quadric_error_metric(
 	const Eigen::MatrixXd& V, 
 	const Eigen::MatrixXi& F, 
-	std::vector< Eigen::MatrixXd >& Q)
+	Quadrics4d& Q)
 {
 	using namespace std;
 	using namespace Eigen;
 	
-	// array of 4x4 matrices
-	Q.resize( V.rows() );
-	for( int i=0; i<Q.size(); i++ )
-		Q[i] = Matrix4d::Zero();
-	
 	const auto & face_from_three_points = [](const Vector3d& v1, const Vector3d& v2, const Vector3d& v3)
 	{
 		Vector3d n = (v2-v1).cross(v3-v1);
@@ -30,18 +83,26 @@ void quadric_error_metric(
 		return res;
 	};
 	
-	// the metric at each vertex equals to the sum of metric of its attached faces
-	for( int i=0; i<F.rows(); i++ ) {
+	// the metric of each face
+	Quadrics4d face_Q( F.rows() );
+	parallel_for( F.rows(), [&]( const int i )
+	{
 		Vector3d v1 = V.row( F(i,0) );
 		Vector3d v2 = V.row( F(i,1) );
 		Vector3d v3 = V.row( F(i,2) );
 		Vector4d p = face_from_three_points(v1, v2, v3);
-		Matrix4d metric = p*p.transpose();
-		
-		Q[ F(i,0) ] += metric;
-		Q[ F(i,1) ] += metric;
-		Q[ F(i,2) ] += metric;
-	}
+		face_Q[i] = p*p.transpose();
+	} );
+	
+	// the metric at each vertex equals to the sum of metric of its attached faces
+	vector< int > start, corners;
+	corner_incidence( F, V.rows(), start, corners );
+	Q.resize( V.rows() );
+	parallel_for( V.rows(), [&]( const int i )
+	{
+		Q[i].setZero();
+		for( int k = start[i]; k < start[i+1]; k++ ) Q[i] += face_Q[ corners[k]/3 ];
+	} );
 	
 	// the cost v.T*Q*v should equal to zero
 	for( int i=0; i<V.rows(); i++ ) {
@@ -54,55 +115,33 @@ void qslim_5d(
 	const Eigen::MatrixXi& F,
 	const Eigen::MatrixXd& TC, 
 	const Eigen::MatrixXi& FT, 
-	std::vector< Eigen::MatrixXd >& Q)
+	std::vector< Quadric5d >& Q)
 {
 	using namespace std;
 	using namespace Eigen;
 	
 	assert( F.rows() == FT.rows() );
 	const int nF = F.rows();
-	// array of 6x6 matrices
-	Q.resize( V.rows() );
-	for( int i=0; i<Q.size(); i++ ) {
-		MatrixXd metric(6,6);
-		metric.setZero();
-		Q[i] = metric;
-	}
 	
-	for(int i=0; i<nF; i++) {
-		VectorXd p1(5),p2(5),p3(5);
-		p1.head(3) = V.row( F(i,0) );
-		p2.head(3) = V.row( F(i,1) );
-		p3.head(3) = V.row( F(i,2) );
-		p1.tail(2) = TC.row( FT(i,0) );
-		p2.tail(2) = TC.row( FT(i,1) );
-		p3.tail(2) = TC.row( FT(i,2) );
-		// Paper Section 5.1
-		VectorXd e1 = (p2-p1)/(p2-p1).norm();
-		VectorXd e2 = p3-p1-(e1.dot(p3-p1))*e1;
-		e2 /= e2.norm();
-		const double eps = 1e-7;
-		assert( fabs(e1.norm() - 1) <= eps );
-		assert( fabs(e2.norm() - 1) <= eps );
-		
-		MatrixXd A(5,5);
-		A.setIdentity();
-		A = A - e1*e1.transpose() - e2*e2.transpose();
-		VectorXd b = p1.dot(e1)*e1 + p1.dot(e2)*e2 - p1;
-		double c = p1.dot(p1) - p1.dot(e1)*p1.dot(e1) - p1.dot(e2)*p1.dot(e2);
-		
-		// Paper Section 3.4
-		MatrixXd metric(6,6);
-		metric.block(0,0,5,5) = A;
-		metric.block(0,5,5,1) = b;
-		metric.block(5,0,1,5) = b.transpose();
-		metric(5,5) = c;
-		
-		// add metric to each vertex
-		Q[ F(i,0) ] += metric;
-		Q[ F(i,1) ] += metric;
-		Q[ F(i,2) ] += metric;
-	}
+	vector< Quadric5d > face_Q( nF );
+	parallel_for( nF, [&]( const int i )
+	{
+		Vector5d p[3];
+		for( int j = 0; j < 3; j++ ) {
+			p[j].head<3>() = V.row( F(i,j) );
+			p[j].tail<2>() = TC.row( FT(i,j) );
+		}
+		face_Q[i] = face_quadric_5d( p[0], p[1], p[2] );
+	} );
+	
+	// add metric to each vertex
+	vector< int > start, corners;
+	corner_incidence( F, V.rows(), start, corners );
+	Q.assign( V.rows(), Quadric5d() );
+	parallel_for( V.rows(), [&]( const int i )
+	{
+		for( int k = start[i]; k < start[i+1]; k++ ) Q[i] += face_Q[ corners[k]/3 ];
+	} );
 }
 	
 void half_edge_qslim_5d(
@@ -112,57 +151,88 @@ void half_edge_qslim_5d(
 	const Eigen::MatrixXi& FT, 
     double pos_scale,
     double uv_weight,
-	MapV5d & hash_Q)
+	QuadricStore & hash_Q,
+	const Eigen::VectorXd * face_weights)
 {
 	using namespace std;
 	using namespace Eigen;
 	
-	// initialize 5d vertex map, key is (vi,ti), value is zero metric
 	assert( F.rows() == FT.rows() );
+	assert( !face_weights || face_weights->size() == F.rows() );
 	const int nF = F.rows();
-	for(int i=0; i<nF; i++) {
 	
-		/// A. compute metric for each face
-		VectorXd p1(5),p2(5),p3(5);
-		p1.head(3) = V.row( F(i,0) ) * pos_scale;
-		p2.head(3) = V.row( F(i,1) ) * pos_scale;
-		p3.head(3) = V.row( F(i,2) ) * pos_scale;
-		p1.tail(2) = TC.row( FT(i,0) ) * uv_weight;
-		p2.tail(2) = TC.row( FT(i,1) ) * uv_weight;
-		p3.tail(2) = TC.row( FT(i,2) ) * uv_weight;
-		// Paper Section 5.1
-		VectorXd e1 = (p2-p1)/(p2-p1).norm();
-		VectorXd e2 = p3-p1-(e1.dot(p3-p1))*e1;
-		e2 /= e2.norm();
-		const double eps = 1e-7;
-		assert( fabs(e1.norm() - 1) <= eps );
-		assert( fabs(e2.norm() - 1) <= eps );
-		
-		MatrixXd A(5,5);
-		A.setIdentity();
-		A = A - e1*e1.transpose() - e2*e2.transpose();
-		VectorXd b = p1.dot(e1)*e1 + p1.dot(e2)*e2 - p1;
-		double c = p1.dot(p1) - p1.dot(e1)*p1.dot(e1) - p1.dot(e2)*p1.dot(e2);
-		
-		// Paper Section 3.4
-		MatrixXd metric(6,6);
-		metric.block(0,0,5,5) = A;
-		metric.block(0,5,5,1) = b;
-		metric.block(5,0,1,5) = b.transpose();
-		metric(5,5) = c;	
+	/// A. compute metric for each face
+	vector< Quadric5d > face_Q( nF );
+	parallel_for( nF, [&]( const int i )
+	{
+		Vector5d p[3];
+		for( int j = 0; j < 3; j++ ) {
+			p[j].head<3>() = V.row( F(i,j) ) * pos_scale;
+			p[j].tail<2>() = TC.row( FT(i,j) ) * uv_weight;
+		}
+		face_Q[i] = face_quadric_5d( p[0], p[1], p[2] );
+		if( face_weights ) face_Q[i] *= (*face_weights)(i);
+	} );
 	
-		/// B. assign the face metric to each 5d vertex, if it hasn't appeared, initialize
-		/// it with the metric, otherwise, add the metric to its original metric. 
-		for(int j=0; j<3; j++) {
-			int vi = F(i,j);
-			int ti = FT(i,j);
-			if( hash_Q[vi].count(ti) == 0 ) {
-				hash_Q[vi][ti] = metric;
-			} 
-			else {
-				hash_Q[vi][ti] += metric;
-			}
+	/// B. assign the face metric to each 5d vertex, if it hasn't appeared, initialize
+	/// it with the metric, otherwise, add the metric to its original metric. 
+	// Create the wedges serially, in face order, so that every vertex lists its
+	// wedges in the same order regardless of the thread count. Afterwards each
+	// texcoord's quadrics can be summed independently.
+	hash_Q.resize( std::max( hash_Q.num_vertices(), int( V.rows() ) ), std::max( hash_Q.num_tcs(), int( TC.rows() ) ) );
+	for( int i = 0; i < nF; i++ )
+		for( int j = 0; j < 3; j++ )
+			hash_Q.add( F(i,j), FT(i,j), Quadric5d() );
+	
+	add_face_quadrics( F, FT, TC.rows(), face_Q, [&]( const int vi, const int ti, const Quadric5d& q ) { hash_Q.add( vi, ti, q ); } );
+}
+
+void half_edge_qslim_8d(
+	const Eigen::MatrixXd& V, 
+	const Eigen::MatrixXi& F,
+	const Eigen::MatrixXd& TC, 
+	const Eigen::MatrixXi& FT, 
+	const Eigen::MatrixXd& CN, 
+	const Eigen::MatrixXi& FN, 
+	double pos_scale,
+	double uv_weight,
+	double normal_weight,
+	QuadricStore & hash_Q,
+	const Eigen::VectorXd * face_weights)
+{
+	using namespace std;
+	using namespace Eigen;
+	
+	assert( F.rows() == FN.rows() );
+	half_edge_qslim_5d( V, F, TC, FT, pos_scale, uv_weight, hash_Q, face_weights );
+	hash_Q.set_normals( true );
+	
+	const int nF = F.rows();
+	vector< Quadric8d > face_Q( nF );
+	parallel_for( nF, [&]( const int i )
+	{
+		Quadric8d::Point p[3];
+		for( int j = 0; j < 3; j++ ) {
+			const Vector3d n = CN.row( FN(i,j) );
+			p[j].head<3>() = V.row( F(i,j) ) * pos_scale;
+			p[j].segment<2>(3) = TC.row( FT(i,j) ) * uv_weight;
+			p[j].tail<3>() = ( n.norm() > 0 ? n.normalized() : n ) * normal_weight;
 		}
-	}
+		face_Q[i] = face_attribute_quadric< 8 >( p[0], p[1], p[2] );
+		if( face_weights ) face_Q[i] *= (*face_weights)(i);
+	} );
 	
-}	
+	add_face_quadrics( F, FT, TC.rows(), face_Q, [&]( const int vi, const int ti, const Quadric8d& q ) { hash_Q.add_normal_quadric( vi, ti, q ); } );
+}
+
+void face_weights_from_vertices(
+	const Eigen::MatrixXi& F,
+	const Eigen::VectorXd& vertex_weights,
+	Eigen::VectorXd& face_weights)
+{
+	face_weights.resize( F.rows() );
+	parallel_for( F.rows(), [&]( const int i )
+	{
+		face_weights(i) = ( vertex_weights( F(i,0) ) + vertex_weights( F(i,1) ) + vertex_weights( F(i,2) ) )/3.0;
+	} );
+}
@@ -5,6 +5,19 @@
 #include <vector>
 #include "half_edge.h"
 
+typedef std::vector< Eigen::Matrix4d, Eigen::aligned_allocator< Eigen::Matrix4d > > Quadrics4d;
+
+// Returns the 5D quadric of the triangle (p1,p2,p3), where each point is
+// (x,y,z,u,v). See Garland and Heckbert 1998, Sections 3.4 and 5.1.
+Quadric5d face_quadric_5d(
+	const Eigen::Matrix<double,5,1>& p1,
+	const Eigen::Matrix<double,5,1>& p2,
+	const Eigen::Matrix<double,5,1>& p3);
+
+// All three functions below compute one quadric per face in parallel first,
+// then sum them per vertex (or per wedge) in parallel, adding faces in
+// increasing order so the result doesn't depend on the number of threads.
+//
 // Inputs:
 //   V  #V by dim list of vertex positions, lesser index of E(e,:) will be set
 //     to midpoint of edge.
@@ -14,15 +27,23 @@
 void quadric_error_metric(
 	const Eigen::MatrixXd& V, 
 	const Eigen::MatrixXi& F, 
-	std::vector< Eigen::MatrixXd >& Q);
+	Quadrics4d& Q);
 
+// Outputs:
+//	 Q  array of metrics, one 6-by-6 (5D) metric per vertex
 void qslim_5d(
 	const Eigen::MatrixXd& V, 
 	const Eigen::MatrixXi& F,
 	const Eigen::MatrixXd& TC, 
 	const Eigen::MatrixXi& FT, 
-	std::vector< Eigen::MatrixXd >& Q);	
+	std::vector< Quadric5d >& Q);	
 	
+// Adds the metric of every face to each of its three wedges (vertex, texcoord)
+// in hash_Q, with positions scaled by pos_scale and texcoords by uv_weight.
+// face_weights, unless it is null, multiplies the metric of every face, so
+// that collapses cost more where the weights are large and the detail there
+// lasts longer (see read_importance_weights()).
+
 void half_edge_qslim_5d(
 	const Eigen::MatrixXd& V, 
 	const Eigen::MatrixXi& F,
@@ -30,5 +51,31 @@ void half_edge_qslim_5d(
 	const Eigen::MatrixXi& FT, 
     double pos_scale,
     double uv_weight,
-	MapV5d & hash_Q);	
+	QuadricStore & hash_Q,
+	const Eigen::VectorXd * face_weights = nullptr);	
+
+// Like half_edge_qslim_5d(), and also gives every wedge the 8D quadric of its
+// faces with the normals CN of their corners FN, normalized and scaled by
+// normal_weight (see QuadricStore::set_normals()). The corners of a wedge may
+// have different normals, e.g. at hard edges that aren't UV seams; the
+// quadric blends them.
+void half_edge_qslim_8d(
+	const Eigen::MatrixXd& V, 
+	const Eigen::MatrixXi& F,
+	const Eigen::MatrixXd& TC, 
+	const Eigen::MatrixXi& FT, 
+	const Eigen::MatrixXd& CN, 
+	const Eigen::MatrixXi& FN, 
+	double pos_scale,
+	double uv_weight,
+	double normal_weight,
+	QuadricStore & hash_Q,
+	const Eigen::VectorXd * face_weights = nullptr);
+
+// The weight of every face of F given one per vertex: the mean of the weights
+// of its corners.
+void face_weights_from_vertices(
+	const Eigen::MatrixXi& F,
+	const Eigen::VectorXd& vertex_weights,
+	Eigen::VectorXd& face_weights);
 #endif
@@ -0,0 +1,272 @@
+#include "quadric_store.h"
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+void QuadricStore::resize( int num_vertices, int num_tcs )
+{
+	assert( num_vertices >= int( vertex_tc.size() ) );
+	assert( num_tcs >= int( tc_vertex.size() ) );
+	vertex_tc.resize( num_vertices, NO_WEDGE );
+	tc_vertex.resize( num_tcs, NO_WEDGE );
+	if( single ) quadric_f.resize( num_tcs );
+	else quadric.resize( num_tcs );
+	if( normals ) quadric_n.resize( num_tcs );
+}
+
+void QuadricStore::clear()
+{
+	std::fill( vertex_tc.begin(), vertex_tc.end(), int( NO_WEDGE ) );
+	std::fill( tc_vertex.begin(), tc_vertex.end(), int( NO_WEDGE ) );
+	vertex_tcs.clear();
+	shared.clear();
+	shared_normals.clear();
+}
+
+bool QuadricStore::contains( int vi, int tci ) const
+{
+	assert( vi >= 0 && vi < num_vertices() );
+	assert( tci >= 0 && tci < num_tcs() );
+	return tc_vertex[tci] == vi || ( !shared.empty() && shared.count( key( vi, tci ) ) );
+}
+
+Quadric5d QuadricStore::at( int vi, int tci ) const
+{
+	assert( contains( vi, tci ) );
+	if( tc_vertex[tci] == vi ) return dense( tci );
+	return shared.at( key( vi, tci ) );
+}
+
+void QuadricStore::set( int vi, int tci, const Quadric5d & q )
+{
+	Quadric5d * side = find_or_add( vi, tci );
+	if( side ) *side = q;
+	else set_dense( tci, q );
+}
+
+void QuadricStore::add( int vi, int tci, const Quadric5d & q )
+{
+	Quadric5d * side = find_or_add( vi, tci );
+	if( side ) *side += q;
+	else if( single ) set_dense( tci, dense( tci ) + q );
+	else quadric[tci] += q;
+}
+
+Quadric5d * QuadricStore::find_or_add( int vi, int tci )
+{
+	assert( vi >= 0 && vi < num_vertices() );
+	assert( tci >= 0 && tci < num_tcs() );
+	if( tc_vertex[tci] == vi ) return nullptr;
+	if( tc_vertex[tci] == NO_WEDGE ) {
+		tc_vertex[tci] = vi;
+		set_dense( tci, Quadric5d() );
+		if( normals ) quadric_n[tci] = Quadric8d();
+		add_to_vertex( vi, tci );
+		return nullptr;
+	}
+	// The texcoord is owned by another vertex.
+	auto it = shared.find( key( vi, tci ) );
+	if( it == shared.end() ) {
+		it = shared.insert( std::make_pair( key( vi, tci ), Quadric5d() ) ).first;
+		if( normals ) shared_normals[ key( vi, tci ) ] = Quadric8d();
+		add_to_vertex( vi, tci );
+	}
+	return &it->second;
+}
+
+Quadric5d QuadricStore::dense( int tci ) const
+{
+	if( !single ) return quadric[tci];
+	Quadric5d q;
+	for( int k = 0; k < 21; ++k ) q.c[k] = quadric_f[tci].c[k];
+	return q;
+}
+
+void QuadricStore::set_dense( int tci, const Quadric5d & q )
+{
+	if( !single ) {
+		quadric[tci] = q;
+		return;
+	}
+	for( int k = 0; k < 21; ++k ) quadric_f[tci].c[k] = float( q.c[k] );
+}
+
+void QuadricStore::set_single_precision( bool single_precision )
+{
+	if( single_precision == single ) return;
+	const int n = num_tcs();
+	if( single_precision ) {
+		quadric_f.resize( n );
+		single = true;
+		for( int t = 0; t < n; ++t ) set_dense( t, quadric[t] );
+		std::vector< Quadric5d >().swap( quadric );
+	}
+	else {
+		quadric.resize( n );
+		for( int t = 0; t < n; ++t ) quadric[t] = dense( t );
+		single = false;
+		std::vector< Quadric5f >().swap( quadric_f );
+	}
+}
+
+void QuadricStore::set_normals( bool has_normals )
+{
+	if( has_normals == normals ) return;
+	normals = has_normals;
+	if( normals ) {
+		quadric_n.assign( num_tcs(), Quadric8d() );
+		for( const auto & wedge : shared ) shared_normals[ wedge.first ] = Quadric8d();
+	}
+	else {
+		std::vector< Quadric8d >().swap( quadric_n );
+		shared_normals.clear();
+	}
+}
+
+Quadric8d QuadricStore::normal_quadric( int vi, int tci ) const
+{
+	assert( normals && contains( vi, tci ) );
+	if( tc_vertex[tci] == vi ) return quadric_n[tci];
+	return shared_normals.at( key( vi, tci ) );
+}
+
+void QuadricStore::set_normal_quadric( int vi, int tci, const Quadric8d & q )
+{
+	assert( normals && contains( vi, tci ) );
+	if( tc_vertex[tci] == vi ) quadric_n[tci] = q;
+	else shared_normals.at( key( vi, tci ) ) = q;
+}
+
+void QuadricStore::add_normal_quadric( int vi, int tci, const Quadric8d & q )
+{
+	assert( normals && contains( vi, tci ) );
+	if( tc_vertex[tci] == vi ) quadric_n[tci] += q;
+	else shared_normals.at( key( vi, tci ) ) += q;
+}
+
+Quadric5d QuadricStore::merged( int v0, int t0, int v1, int t1 ) const
+{
+	if( !normals ) return at( v0, t0 ) + at( v1, t1 );
+	return reduce_attributes( normal_quadric( v0, t0 ) + normal_quadric( v1, t1 ) );
+}
+
+void QuadricStore::erase( int vi, int tci )
+{
+	if( tc_vertex[tci] == vi ) {
+		tc_vertex[tci] = NO_WEDGE;
+	}
+	else if( shared.empty() || !shared.erase( key( vi, tci ) ) ) {
+		return;
+	}
+	else {
+		shared_normals.erase( key( vi, tci ) );
+	}
+	remove_from_vertex( vi, tci );
+}
+
+int QuadricStore::num_wedges( int vi ) const
+{
+	const int t = vertex_tc[vi];
+	if( t == NO_WEDGE ) return 0;
+	if( t != SEVERAL_WEDGES ) return 1;
+	return int( vertex_tcs.at( vi ).size() );
+}
+
+const int * QuadricStore::wedges( int vi ) const
+{
+	const int t = vertex_tc[vi];
+	if( t == NO_WEDGE ) return nullptr;
+	if( t != SEVERAL_WEDGES ) return &vertex_tc[vi];
+	return vertex_tcs.at( vi ).data();
+}
+
+void QuadricStore::move_wedges( int from, int to )
+{
+	assert( from != to );
+	while( num_wedges( from ) > 0 ) {
+		const int tci = wedges( from )[0];
+		if( contains( to, tci ) ) {
+			erase( from, tci );
+			continue;
+		}
+		if( tc_vertex[tci] == from ) {
+			tc_vertex[tci] = to;
+		}
+		else if( tc_vertex[tci] == NO_WEDGE ) {
+			tc_vertex[tci] = to;
+			set_dense( tci, shared.at( key( from, tci ) ) );
+			shared.erase( key( from, tci ) );
+			if( normals ) {
+				quadric_n[tci] = shared_normals.at( key( from, tci ) );
+				shared_normals.erase( key( from, tci ) );
+			}
+		}
+		else {
+			shared[ key( to, tci ) ] = shared.at( key( from, tci ) );
+			shared.erase( key( from, tci ) );
+			if( normals ) {
+				shared_normals[ key( to, tci ) ] = shared_normals.at( key( from, tci ) );
+				shared_normals.erase( key( from, tci ) );
+			}
+		}
+		remove_from_vertex( from, tci );
+		add_to_vertex( to, tci );
+	}
+}
+
+void QuadricStore::rename(
+	const std::vector< int > & new_vertices,
+	int num_vertices,
+	const std::vector< int > & new_tcs,
+	int num_tcs )
+{
+	assert( int( new_vertices.size() ) == this->num_vertices() );
+	assert( int( new_tcs.size() ) == this->num_tcs() );
+	QuadricStore renamed;
+	renamed.set_single_precision( single );
+	renamed.set_normals( normals );
+	renamed.resize( num_vertices, num_tcs );
+	// Adding the wedges vertex by vertex keeps the order of the wedge lists.
+	for( int vi = 0; vi < int( new_vertices.size() ); ++vi ) {
+		if( new_vertices[vi] == -1 ) continue;
+		const int n = num_wedges( vi );
+		const int * tcs = wedges( vi );
+		for( int k = 0; k < n; ++k ) {
+			if( new_tcs[ tcs[k] ] == -1 ) continue;
+			renamed.set( new_vertices[vi], new_tcs[ tcs[k] ], at( vi, tcs[k] ) );
+			if( normals ) renamed.set_normal_quadric( new_vertices[vi], new_tcs[ tcs[k] ], normal_quadric( vi, tcs[k] ) );
+		}
+	}
+	*this = std::move( renamed );
+}
+
+void QuadricStore::add_to_vertex( int vi, int tci )
+{
+	int & t = vertex_tc[vi];
+	if( t == NO_WEDGE ) {
+		t = tci;
+		return;
+	}
+	std::vector< int > & list = vertex_tcs[vi];
+	if( t != SEVERAL_WEDGES ) {
+		list.assign( 1, t );
+		t = SEVERAL_WEDGES;
+	}
+	list.push_back( tci );
+}
+
+void QuadricStore::remove_from_vertex( int vi, int tci )
+{
+	int & t = vertex_tc[vi];
+	if( t != SEVERAL_WEDGES ) {
+		assert( t == tci );
+		t = NO_WEDGE;
+		return;
+	}
+	std::vector< int > & list = vertex_tcs.at( vi );
+	list.erase( std::find( list.begin(), list.end(), tci ) );
+	if( list.size() == 1 ) {
+		t = list.front();
+		vertex_tcs.erase( vi );
+	}
+}
@@ -0,0 +1,133 @@
+#ifndef QUADRIC_STORE_H
+#define QUADRIC_STORE_H
+
+#include <Eigen/Core>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include "attribute_quadric.h"
+
+// A symmetric 6x6 quadric over homogeneous 5D points (x,y,z,u,v,1), stored as
+// the 21 coefficients of its upper triangle (row by row).
+typedef AttributeQuadric< 5 > Quadric5d;
+// The same over (x,y,z,u,v,nx,ny,nz,1), with the normal.
+typedef AttributeQuadric< 8 > Quadric8d;
+
+// The coefficients of a Quadric5d rounded to single precision.
+struct Quadric5f
+{
+	float c[21];
+};
+
+// The per-wedge quadrics of a mesh. A wedge is a (vertex index, texcoord index)
+// pair. In practice every texcoord belongs to exactly one vertex, so quadrics
+// are stored densely by texcoord index; the rare texcoord shared by several
+// vertices keeps its extra wedges in a side table. Every vertex normally has a
+// single wedge; the wedge lists of seam vertices (which have several) live in a
+// second side table.
+//
+// With set_single_precision() the dense quadrics are stored as floats, which
+// halves the memory of the store. Quadrics still come out and go in as
+// Quadric5d, so sums are computed in double and rounded once when stored.
+//
+// With set_normals() every wedge also has a Quadric8d, which carries the
+// normal (see half_edge_qslim_8d()). The 8D quadrics follow the wedges
+// around like the 5D ones, and merged() reduces them to the 5D quadric the
+// costs and placements are computed with.
+class QuadricStore
+{
+public:
+	// Makes room for vertices [0,num_vertices) and texcoords [0,num_tcs),
+	// keeping any wedges already stored.
+	void resize( int num_vertices, int num_tcs );
+	// Removes all wedges.
+	void clear();
+
+	int num_vertices() const { return int( vertex_tc.size() ); }
+	int num_tcs() const { return int( tc_vertex.size() ); }
+
+	// Returns whether the wedge (vi,tci) exists.
+	bool contains( int vi, int tci ) const;
+	// Returns the quadric of the existing wedge (vi,tci).
+	Quadric5d at( int vi, int tci ) const;
+	// Sets the quadric of wedge (vi,tci), adding the wedge if it doesn't exist
+	// yet.
+	void set( int vi, int tci, const Quadric5d & q );
+	// Adds q to the quadric of wedge (vi,tci), adding the wedge with a zero
+	// quadric first if it doesn't exist yet. Adding to existing wedges of
+	// different texcoords can run concurrently.
+	void add( int vi, int tci, const Quadric5d & q );
+	// Removes the wedge (vi,tci) if it exists.
+	void erase( int vi, int tci );
+
+	// The quadric of the wedge merging the existing wedges (v0,t0) and
+	// (v1,t1): the sum of their quadrics, or with normals the
+	// reduce_attributes() of the sum of their 8D quadrics, so that the cost
+	// of a placement includes the error of the best normal there.
+	Quadric5d merged( int v0, int t0, int v1, int t1 ) const;
+
+	// The texcoord indices of the wedges of `vi`, in insertion order.
+	int num_wedges( int vi ) const;
+	const int * wedges( int vi ) const;
+
+	// Moves all wedges of vertex `from` to vertex `to`. Wedges `to` already
+	// has keep their quadric.
+	void move_wedges( int from, int to );
+
+	// Renames vertex vi to new_vertices[vi] and texcoord tci to new_tcs[tci],
+	// for vertices [0,num_vertices) and texcoords [0,num_tcs) from then on.
+	// Wedges of a vertex or texcoord renamed to -1 are dropped. The wedges of
+	// each vertex keep their order.
+	void rename(
+		const std::vector< int > & new_vertices,
+		int num_vertices,
+		const std::vector< int > & new_tcs,
+		int num_tcs );
+
+	// Switches the dense quadrics to single or double precision, converting
+	// those stored. The quadrics of the side table stay in double.
+	void set_single_precision( bool single );
+	bool single_precision() const { return single; }
+
+	// Gives every wedge a zero 8D quadric, including those added later, or
+	// drops them. The 8D quadrics are always stored in double precision.
+	void set_normals( bool normals );
+	bool has_normals() const { return normals; }
+	// Like at(), set() and add() for the 8D quadric of the existing wedge
+	// (vi,tci).
+	Quadric8d normal_quadric( int vi, int tci ) const;
+	void set_normal_quadric( int vi, int tci, const Quadric8d & q );
+	void add_normal_quadric( int vi, int tci, const Quadric8d & q );
+
+private:
+	static long long key( int vi, int tci ) { return ( (long long)vi << 32 ) | (unsigned int)tci; }
+	void add_to_vertex( int vi, int tci );
+	void remove_from_vertex( int vi, int tci );
+	// Adds the wedge (vi,tci) with a zero quadric if it doesn't exist yet.
+	// Returns its quadric if it is in the side table, and null if it is dense.
+	Quadric5d * find_or_add( int vi, int tci );
+	Quadric5d dense( int tci ) const;
+	void set_dense( int tci, const Quadric5d & q );
+
+	enum { NO_WEDGE = -1, SEVERAL_WEDGES = -2 };
+
+	// quadric[tci], or quadric_f[tci] in single precision, is the quadric of
+	// wedge (tc_vertex[tci], tci).
+	bool single = false;
+	std::vector< Quadric5d > quadric;
+	std::vector< Quadric5f > quadric_f;
+	// With normals, quadric_n[tci] is the 8D quadric of the same wedge.
+	bool normals = false;
+	std::vector< Quadric8d > quadric_n;
+	// The vertex owning quadric[tci], or NO_WEDGE.
+	std::vector< int > tc_vertex;
+	// The only texcoord of each vertex, NO_WEDGE or SEVERAL_WEDGES.
+	std::vector< int > vertex_tc;
+	// The wedge lists of vertices marked SEVERAL_WEDGES.
+	std::unordered_map< int, std::vector< int > > vertex_tcs;
+	// Quadrics of wedges whose texcoord is owned by another vertex.
+	std::unordered_map< long long, Quadric5d > shared;
+	std::unordered_map< long long, Quadric8d > shared_normals;
+};
+
+#endif
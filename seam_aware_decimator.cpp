@@ -0,0 +1,477 @@
+#include "seam_aware_decimator.h"
+#include "quadric_error_metric.h"
+#include "allocation_counter.h"
+#include "instrumentation.h"
+#include "edge_topology.h"
+#include "mesh_order.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+	// The finalizer of splitmix64.
+	uint64_t mix_bits( uint64_t x )
+	{
+		x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+		x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebULL;
+		return x ^ ( x >> 31 );
+	}
+
+	// A hash of the positions of the endpoints of edge e, whichever comes
+	// first, for DecimationOptions::stable_ties. Collapsed edges get 0.
+	uint64_t edge_position_key( const Eigen::MatrixXd & V, const Eigen::MatrixXi & E, int e )
+	{
+		if( E(e,0) == DUV_COLLAPSE_EDGE_NULL ) return 0;
+		uint64_t keys[2];
+		for( int k = 0; k < 2; ++k ) {
+			uint64_t key = 0;
+			for( int c = 0; c < V.cols(); ++c ) {
+				// Adding 0 turns -0 into 0, which compares equal to it.
+				const double x = V( E(e,k), c ) + 0.0;
+				uint64_t bits;
+				std::memcpy( &bits, &x, sizeof( bits ) );
+				key = mix_bits( key ^ bits );
+			}
+			keys[k] = key;
+		}
+		if( keys[1] < keys[0] ) std::swap( keys[0], keys[1] );
+		return mix_bits( keys[0] ^ mix_bits( keys[1] ) );
+	}
+}
+
+void SeamAwareDecimator::prepare(
+	const Eigen::MatrixXd & OV,
+	const Eigen::MatrixXi & OF,
+	const Eigen::MatrixXd & OTC,
+	const Eigen::MatrixXi & OFT,
+	EdgeMap & seam_edges,
+	QuadricStore & metrics,
+	int seam_aware_degree,
+	bool preserve_boundaries,
+	double pos_scale,
+	double uv_weight,
+	const DecimationOptions & options,
+	CollapseLog * log,
+	const EdgeTopology * topology )
+{
+	this->options = options;
+	this->seam_aware_degree = seam_aware_degree;
+	this->preserve_boundaries = preserve_boundaries;
+	this->pos_scale = pos_scale;
+	this->uv_weight = uv_weight;
+	collapse_log = log;
+	cost_limit = options.max_error == std::numeric_limits<double>::infinity()
+		? options.max_error : ( options.max_error*pos_scale )*( options.max_error*pos_scale );
+	num_input_faces = OF.rows();
+
+	Vmetrics = std::move( metrics );
+	metrics.clear();
+	Vmetrics.set_single_precision( options.single_precision_quadrics );
+	// The input, and what refers to its rows, in spatial order.
+	const bool reorder = options.spatial_order && !log;
+	MeshOrder order;
+	Eigen::MatrixXd RV, RTC;
+	Eigen::MatrixXi RF, RFT;
+	EdgeMap reordered_seam_edges;
+	std::vector< int > locked_vertices;
+	if( reorder ) {
+		PhaseTimer reorder_timer( REORDER_PHASE );
+		spatial_mesh_order( OV, OF, OTC, OFT, order );
+		reorder_mesh( order, OV, OF, OTC, OFT, RV, RF, RTC, RFT );
+		std::vector< int > new_vertices, new_tcs;
+		inverse_order( order.vertices, new_vertices );
+		inverse_order( order.tcs, new_tcs );
+		Vmetrics.rename( new_vertices, OV.rows(), new_tcs, OTC.rows() );
+		for( const auto & edges : seam_edges ) {
+			for( auto v : edges.second ) {
+				if( edges.first < v ) insert_edge( reordered_seam_edges, new_vertices[ edges.first ], new_vertices[v] );
+			}
+		}
+		for( auto v : options.locked_vertices ) locked_vertices.push_back( new_vertices[v] );
+		// The topology of the input doesn't apply.
+		topology = nullptr;
+	}
+	if( options.stable_ties ) Q.set_tie_key( [this]( int e ) { return edge_position_key( V, E, e ); } );
+	else Q.set_tie_key( PriorityQueue::TieKey() );
+	{
+		PhaseTimer queue_setup_timer( QUEUE_SETUP_PHASE );
+		// Counts the vertex at infinity once it is added.
+		int target_num_vertices = 0;
+		if( reorder ) {
+			prepare_decimate_halfedge_5d(RV,RF,RTC,RFT,reordered_seam_edges,Vmetrics,target_num_vertices,seam_aware_degree,preserve_boundaries,
+					pos_scale, uv_weight, locked_vertices, V,F,TC,FT,EMAP,E,EF,EI,Q,C,seams,topology);
+		}
+		else {
+			prepare_decimate_halfedge_5d(OV,OF,OTC,OFT,seam_edges,Vmetrics,target_num_vertices,seam_aware_degree,preserve_boundaries,
+					pos_scale, uv_weight, options.locked_vertices, V,F,TC,FT,EMAP,E,EF,EI,Q,C,seams,topology);
+		}
+		infinity_offset = target_num_vertices;
+	}
+
+	if( collapse_log ) {
+		collapse_log->num_vertices = OV.rows();
+		collapse_log->num_tcs = OTC.rows();
+		collapse_log->num_faces = OF.rows();
+		collapse_log->pos_scale = pos_scale;
+		collapse_log->uv_weight = uv_weight;
+		collapse_log->records.clear();
+	}
+
+	lazy = LazyEdgeUpdates();
+	lazy.enabled = options.lazy_updates;
+	if( lazy.enabled ) lazy.resize( E.rows() );
+	workspace.uv_orientations.enabled = options.cache_uv_orientations;
+	if( options.cache_uv_orientations ) workspace.uv_orientations.compute( TC, FT );
+	batch_state = IndependentSetState();
+	vertex_origins.clear();
+	tc_origins.clear();
+	face_origins.clear();
+	if( reorder ) {
+		// The rows at infinity come last either way.
+		vertex_origins = order.vertices;
+		tc_origins = order.tcs;
+		face_origins = order.faces;
+		for( int v = OV.rows(); v < V.rows(); ++v ) vertex_origins.push_back( v );
+		for( int t = OTC.rows(); t < TC.rows(); ++t ) tc_origins.push_back( t );
+		for( int f = OF.rows(); f < F.rows(); ++f ) face_origins.push_back( f );
+		// With the boundary edges, like prepare_decimate_halfedge_5d() adds.
+		this->seam_edges( seam_edges );
+	}
+	compactions = 0;
+	prev_e = -1;
+	remain_vertices = V.rows();
+	current_max_error = 0.0;
+	stopped_at_max_error = false;
+	heap_allocations = 0;
+}
+
+void SeamAwareDecimator::prepare(
+	const Eigen::MatrixXd & V,
+	const Eigen::MatrixXi & F,
+	const Eigen::MatrixXd & TC,
+	const Eigen::MatrixXi & FT,
+	int seam_aware_degree,
+	bool preserve_boundaries,
+	double uv_weight,
+	const DecimationOptions & options,
+	CollapseLog * log )
+{
+	const double pos_scale = unit_area_position_scale( V, F );
+	EdgeTopology topology;
+	EdgeMap seam_edges;
+	{
+		PhaseTimer seam_detection_timer( SEAM_DETECTION_PHASE );
+		build_edge_topology( F, TC, FT, V.rows(), topology );
+		insert_edges_of_kind( topology, ANY_SEAM_EDGE, seam_edges );
+	}
+	QuadricStore metrics;
+	{
+		PhaseTimer quadrics_timer( QUADRICS_PHASE );
+		half_edge_qslim_5d( V, F, TC, FT, pos_scale, uv_weight, metrics );
+	}
+	prepare( V, F, TC, FT, seam_edges, metrics, seam_aware_degree, preserve_boundaries, pos_scale, uv_weight, options, log, &topology );
+}
+
+bool SeamAwareDecimator::collapse_until( int target_num_vertices )
+{
+	target_num_vertices += infinity_offset;
+	bool clean_finish = true;
+	PhaseTimer collapse_loop_timer( COLLAPSE_LOOP_PHASE );
+	const long long allocations_before = heap_allocation_count();
+	while(remain_vertices > target_num_vertices)
+	{
+		// The cost of a stale edge is only an estimate.
+		refresh_queue_top(E,EF,EI,V,F,TC,FT,seams,Vmetrics,seam_aware_degree,pos_scale,uv_weight,Q,C,lazy,workspace);
+		if(Q.empty())
+		{
+			break;
+		}
+		const double cost = Q.top().first;
+		if(cost == std::numeric_limits<double>::infinity())
+		{
+			// min cost edge is infinite cost
+			break;
+		}
+		if(cost > cost_limit)
+		{
+			stopped_at_max_error = true;
+			break;
+		}
+
+		if( options.batch_size > 1 )
+		{
+			collapsed_costs.clear();
+			const int max_collapses = std::min( options.batch_size, remain_vertices - target_num_vertices );
+			collapse_independent_edges(max_collapses,options.batch_tolerance,cost_limit,V,F,E,EMAP,EF,EI,TC,FT,seams,Vmetrics,seam_aware_degree,Q,C,lazy,batch_state,collapsed_costs,preserve_boundaries,pos_scale,uv_weight,workspace,collapse_log);
+			for( auto collapsed_cost : collapsed_costs )
+			{
+				current_max_error = std::max(current_max_error, sqrt(std::max(0.0, collapsed_cost)) / pos_scale);
+			}
+			remain_vertices -= int( collapsed_costs.size() );
+		}
+		else
+		{
+			bool collapse_success = collapse_one_edge(V,F,TC,FT,EMAP,E,EF,EI,seams,Vmetrics,seam_aware_degree,Q,C,lazy,prev_e, preserve_boundaries, pos_scale, uv_weight, cost_limit, workspace, collapse_log);
+			if(!collapse_success) {
+				// Every collapsible edge would exceed the error bound.
+				if( !Q.empty() && Q.top().first > cost_limit && Q.top().first != std::numeric_limits<double>::infinity() ) {
+					stopped_at_max_error = true;
+					break;
+				}
+				clean_finish = false;
+				break;
+			}
+
+			const double error = sqrt(std::max(0.0, cost)) / pos_scale;
+			current_max_error = std::max(current_max_error, error);
+
+			remain_vertices--;
+		}
+
+		if( options.compaction_threshold > 0 && !collapse_log && remain_vertices < options.compaction_threshold * V.rows() )
+		{
+			compact();
+		}
+	}
+	if( allocations_before < 0 ) heap_allocations = -1;
+	else heap_allocations += heap_allocation_count() - allocations_before;
+	return clean_finish;
+}
+
+void SeamAwareDecimator::extract(
+	Eigen::MatrixXd & V_out,
+	Eigen::MatrixXi & F_out,
+	Eigen::MatrixXd & TC_out,
+	Eigen::MatrixXi & FT_out,
+	DecimationOrigins * origins,
+	Eigen::MatrixXd * CN_out,
+	Eigen::MatrixXi * FN_out ) const
+{
+	const bool restore = options.restore_input_order && !face_origins.empty();
+	const bool normals = CN_out && FN_out && Vmetrics.has_normals();
+	DecimationOrigins restored;
+	if( ( restore || normals ) && !origins ) origins = &restored;
+	// remove all DUV_COLLAPSE_EDGE_NULL faces
+	clean_mesh(V,F,TC,FT,num_input_faces,pos_scale,uv_weight,V_out,F_out,TC_out,FT_out,origins);
+	if( origins && !vertex_origins.empty() ) {
+		for( int i = 0; i < origins->vertices.size(); ++i ) origins->vertices(i) = vertex_origins[ origins->vertices(i) ];
+		for( int i = 0; i < origins->tcs.size(); ++i ) origins->tcs(i) = tc_origins[ origins->tcs(i) ];
+	}
+	if( restore ) {
+		// clean_mesh() keeps the faces left in order.
+		Eigen::VectorXi faces( F_out.rows() );
+		for( int f = 0, i = 0; f < num_input_faces; ++f ) {
+			if( F(f,0) != DUV_COLLAPSE_EDGE_NULL ) faces( i++ ) = face_origins[f];
+		}
+		sort_by_origins( V_out, F_out, TC_out, FT_out, origins->vertices, origins->tcs, faces );
+	}
+	if( normals ) wedge_normals( F_out, FT_out, TC_out.rows(), *origins, *CN_out, *FN_out );
+	else {
+		if( CN_out ) CN_out->resize( 0, 0 );
+		if( FN_out ) FN_out->resize( 0, 0 );
+	}
+}
+
+void SeamAwareDecimator::wedge_normals(
+	const Eigen::MatrixXi & F_out,
+	const Eigen::MatrixXi & FT_out,
+	int num_tcs,
+	const DecimationOrigins & origins,
+	Eigen::MatrixXd & CN_out,
+	Eigen::MatrixXi & FN_out ) const
+{
+	// Back from the rows of the input to those of the working mesh.
+	const auto & working_rows = []( const Eigen::VectorXi & input_rows, const std::vector< int > & row_origins, std::vector< int > & rows )
+	{
+		rows.assign( input_rows.data(), input_rows.data() + input_rows.size() );
+		if( row_origins.empty() ) return;
+		std::vector< int > working( *std::max_element( row_origins.begin(), row_origins.end() ) + 1, -1 );
+		for( int i = 0; i < int( row_origins.size() ); ++i ) working[ row_origins[i] ] = i;
+		for( auto & row : rows ) row = working[ row ];
+	};
+	std::vector< int > vertices, tcs;
+	working_rows( origins.vertices, vertex_origins, vertices );
+	working_rows( origins.tcs, tc_origins, tcs );
+
+	// The output vertex and texture coordinate of each row of CN_out.
+	std::vector< int > row_vertex( num_tcs, -1 ), row_tc( num_tcs );
+	for( int t = 0; t < num_tcs; ++t ) row_tc[t] = t;
+	// Rare: the rows of the further vertices sharing a texture coordinate.
+	std::unordered_map< long long, int > shared_rows;
+	FN_out.resize( FT_out.rows(), FT_out.cols() );
+	for( int f = 0; f < F_out.rows(); ++f ) {
+		for( int k = 0; k < 3; ++k ) {
+			const int v = F_out(f,k), t = FT_out(f,k);
+			if( row_vertex[t] == -1 ) row_vertex[t] = v;
+			int row = t;
+			if( row_vertex[t] != v ) {
+				const auto inserted = shared_rows.insert( std::make_pair( ( (long long)v << 32 ) | (unsigned int)t, int( row_vertex.size() ) ) );
+				row = inserted.first->second;
+				if( inserted.second ) {
+					row_vertex.push_back( v );
+					row_tc.push_back( t );
+				}
+			}
+			FN_out(f,k) = row;
+		}
+	}
+	CN_out.resize( row_vertex.size(), 3 );
+	parallel_for( int( row_vertex.size() ), [&]( const int row )
+	{
+		if( row_vertex[row] == -1 ) {
+			CN_out.row( row ).setZero();
+			return;
+		}
+		const int v = vertices[ row_vertex[row] ];
+		const int t = tcs[ row_tc[row] ];
+		Eigen::Matrix<double,5,1> p;
+		p << V.row(v).transpose(), TC.row(t).transpose();
+		const Eigen::Vector3d n = best_attributes( Vmetrics.normal_quadric( v, t ), p );
+		CN_out.row( row ) = ( n.norm() > 0 ? n.normalized() : n ).transpose();
+	} );
+}
+
+void SeamAwareDecimator::seam_edges( EdgeMap & seam_edges ) const
+{
+	seams.to_edge_map( E, seam_edges );
+	if( vertex_origins.empty() ) return;
+	// Back to the vertex indices of the input; the map has both directions.
+	EdgeMap renamed;
+	for( const auto & edges : seam_edges ) {
+		for( auto v : edges.second ) {
+			if( edges.first < v ) insert_edge( renamed, vertex_origins[ edges.first ], vertex_origins[v] );
+		}
+	}
+	seam_edges.swap( renamed );
+}
+
+void SeamAwareDecimator::compact()
+{
+	PhaseTimer compaction_timer( COMPACTION_PHASE );
+	const int m = F.rows();
+
+	// What is live keeps its order, and so the vertex at infinity, its
+	// texture coordinate and the faces at infinity stay last.
+	std::vector< int > new_faces( m, -1 ), new_vertices( V.rows(), -1 ), new_tcs( TC.rows(), -1 ), new_edges( E.rows(), -1 );
+	int num_faces = 0, num_input = 0;
+	for( int f = 0; f < m; ++f ) {
+		if( F(f,0) == DUV_COLLAPSE_EDGE_NULL ) continue;
+		new_faces[f] = num_faces++;
+		if( f < num_input_faces ) ++num_input;
+		for( int k = 0; k < 3; ++k ) {
+			new_vertices[ F(f,k) ] = 0;
+			new_tcs[ FT(f,k) ] = 0;
+		}
+	}
+	const auto & number = []( std::vector< int > & ids )
+	{
+		int n = 0;
+		for( auto & id : ids ) id = id == -1 ? -1 : n++;
+		return n;
+	};
+	const int num_vertices = number( new_vertices );
+	const int num_tcs = number( new_tcs );
+	int num_edges = 0;
+	for( int e = 0; e < E.rows(); ++e ) {
+		if( E(e,0) != DUV_COLLAPSE_EDGE_NULL ) new_edges[e] = num_edges++;
+	}
+
+	// The rows, in place: row i only moves to a row <= i.
+	for( int v = 0; v < V.rows(); ++v ) {
+		if( new_vertices[v] == -1 ) continue;
+		V.row( new_vertices[v] ) = V.row(v);
+	}
+	for( int t = 0; t < TC.rows(); ++t ) {
+		if( new_tcs[t] == -1 ) continue;
+		TC.row( new_tcs[t] ) = TC.row(t);
+	}
+	V.conservativeResize( num_vertices, Eigen::NoChange );
+	TC.conservativeResize( num_tcs, Eigen::NoChange );
+
+	Eigen::VectorXi new_EMAP( 3*num_faces );
+	for( int f = 0; f < m; ++f ) {
+		const int g = new_faces[f];
+		if( g == -1 ) continue;
+		for( int k = 0; k < 3; ++k ) {
+			F(g,k) = new_vertices[ F(f,k) ];
+			FT(g,k) = new_tcs[ FT(f,k) ];
+			assert( new_edges[ EMAP( k*m + f ) ] != -1 );
+			new_EMAP( k*num_faces + g ) = new_edges[ EMAP( k*m + f ) ];
+		}
+	}
+	F.conservativeResize( num_faces, Eigen::NoChange );
+	FT.conservativeResize( num_faces, Eigen::NoChange );
+	EMAP.swap( new_EMAP );
+
+	for( int e = 0; e < int( new_edges.size() ); ++e ) {
+		const int g = new_edges[e];
+		if( g == -1 ) continue;
+		for( int i = 0; i < 2; ++i ) {
+			assert( EF(e,i) == -1 || new_faces[ EF(e,i) ] != -1 );
+			E(g,i) = new_vertices[ E(e,i) ];
+			EF(g,i) = EF(e,i) == -1 ? -1 : new_faces[ EF(e,i) ];
+			EI(g,i) = EI(e,i);
+		}
+		if( g != e ) C[g] = C[e];
+		if( lazy.enabled ) {
+			lazy.version[g] = lazy.version[e];
+			lazy.evaluated[g] = lazy.evaluated[e];
+		}
+	}
+	E.conservativeResize( num_edges, Eigen::NoChange );
+	EF.conservativeResize( num_edges, Eigen::NoChange );
+	EI.conservativeResize( num_edges, Eigen::NoChange );
+	C.resize( num_edges );
+	if( lazy.enabled ) {
+		lazy.version.resize( num_edges );
+		lazy.evaluated.resize( num_edges );
+	}
+
+	Q.rename( new_edges, num_edges );
+	seams.rename( new_vertices, num_vertices, new_edges, num_edges );
+	Vmetrics.rename( new_vertices, num_vertices, new_tcs, num_tcs );
+	FaceUVOrientations & orientations = workspace.uv_orientations;
+	if( orientations.enabled ) {
+		for( int f = 0; f < m; ++f ) {
+			if( new_faces[f] != -1 ) orientations.values[ new_faces[f] ] = orientations.values[f];
+		}
+		orientations.values.resize( num_faces );
+	}
+	batch_state.vertex_round.clear();
+	batch_state.tc_round.clear();
+	prev_e = prev_e == -1 ? -1 : new_edges[ prev_e ];
+
+	const auto & compose = []( std::vector< int > & origins, const std::vector< int > & new_ids, int n )
+	{
+		if( origins.empty() ) {
+			origins.resize( new_ids.size() );
+			for( int i = 0; i < int( origins.size() ); ++i ) origins[i] = i;
+		}
+		for( int i = 0; i < int( new_ids.size() ); ++i ) {
+			if( new_ids[i] != -1 ) origins[ new_ids[i] ] = origins[i];
+		}
+		origins.resize( n );
+	};
+	compose( vertex_origins, new_vertices, num_vertices );
+	compose( tc_origins, new_tcs, num_tcs );
+	compose( face_origins, new_faces, num_faces );
+	num_input_faces = num_input;
+	++compactions;
+}
+
+DecimationStats SeamAwareDecimator::stats() const
+{
+	DecimationStats stats;
+	stats.cost_evaluations = lazy.evaluations;
+	stats.saved_evaluations = lazy.enabled ? lazy.deferred - lazy.evaluations : 0;
+	stats.heap_allocations = heap_allocations;
+	stats.reached_max_error = stopped_at_max_error;
+	stats.compactions = compactions;
+	return stats;
+}
@@ -0,0 +1,159 @@
+#ifndef SEAM_AWARE_DECIMATOR_H
+#define SEAM_AWARE_DECIMATOR_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "decimate.h"
+#include "collapse_edge_seam.h"
+
+// The state of one decimation, which decimate_halfedge_5d() runs from start to
+// finish, split into steps so that it can be driven from other code:
+//
+//     SeamAwareDecimator decimator;
+//     decimator.prepare( V, F, TC, FT, 2, false, 1.0 );
+//     for( int target : { 10000, 5000, 1000 } ) {
+//         decimator.collapse_until( target );
+//         decimator.extract( V_lod, F_lod, TC_lod, FT_lod );
+//         ...
+//     }
+//
+// Each collapse_until() continues from where the previous one stopped, so a
+// sequence of levels of detail costs one decimation. With
+// DecimationOptions::batch_size 1 the mesh at each level is the one
+// decimating to it directly gives. With batches, the last round before each
+// target is cut short to stop there, so the rounds after it split
+// differently and the levels depend on the sequence of targets. Instances
+// don't share any state, so several can decimate concurrently.
+class SeamAwareDecimator
+{
+public:
+	SeamAwareDecimator() = default;
+	SeamAwareDecimator( const SeamAwareDecimator & ) = delete;
+	SeamAwareDecimator & operator=( const SeamAwareDecimator & ) = delete;
+
+	// Sets up the decimation of (V,F,TC,FT) with the parameters of
+	// decimate_halfedge_5d(), discarding any previous one. seam_edges gets the
+	// boundary edges if preserve_boundaries is set, like in
+	// prepare_decimate_halfedge_5d(), and Vmetrics is moved into the
+	// decimator. log, unless it is null, gets every collapse from now on.
+	// topology is build_edge_topology() of the input, if the caller has it.
+	void prepare(
+		const Eigen::MatrixXd & V,
+		const Eigen::MatrixXi & F,
+		const Eigen::MatrixXd & TC,
+		const Eigen::MatrixXi & FT,
+		EdgeMap & seam_edges,
+		QuadricStore & Vmetrics,
+		int seam_aware_degree,
+		bool preserve_boundaries,
+		double pos_scale,
+		double uv_weight,
+		const DecimationOptions & options = DecimationOptions(),
+		CollapseLog * log = nullptr,
+		const EdgeTopology * topology = nullptr );
+	// Like the above, with the seams of find_seam_edges(), the metrics of
+	// half_edge_qslim_5d() and the scale of unit_area_position_scale(), like
+	// the decimater.
+	void prepare(
+		const Eigen::MatrixXd & V,
+		const Eigen::MatrixXi & F,
+		const Eigen::MatrixXd & TC,
+		const Eigen::MatrixXi & FT,
+		int seam_aware_degree,
+		bool preserve_boundaries,
+		double uv_weight,
+		const DecimationOptions & options = DecimationOptions(),
+		CollapseLog * log = nullptr );
+
+	// Collapses edges until at most target_num_vertices vertices are left, or
+	// no edge can be collapsed, or the next collapse would exceed
+	// DecimationOptions::max_error. With DecimationOptions::batch_size > 1 the
+	// last round is cut short to stop at the target, which changes the rounds
+	// of later calls, so the mesh they reach may differ from the one a single
+	// call to their target gives. Returns false if it stopped early because
+	// every remaining edge failed the collapse checks; see num_vertices() and
+	// reached_max_error() for the other reasons.
+	bool collapse_until( int target_num_vertices );
+
+	// The current mesh, as decimate_halfedge_5d() outputs it. CN_out and
+	// FN_out, unless they are null, get the normals of its wedges if the
+	// quadrics carry them (see half_edge_qslim_8d()), and are emptied
+	// otherwise.
+	void extract(
+		Eigen::MatrixXd & V_out,
+		Eigen::MatrixXi & F_out,
+		Eigen::MatrixXd & TC_out,
+		Eigen::MatrixXi & FT_out,
+		DecimationOrigins * origins = nullptr,
+		Eigen::MatrixXd * CN_out = nullptr,
+		Eigen::MatrixXi * FN_out = nullptr ) const;
+	// The seam edges left, as pairs of vertex indices.
+	void seam_edges( EdgeMap & seam_edges ) const;
+
+	// The number of vertices of the current mesh, not counting the vertex at
+	// infinity of meshes with boundary.
+	int num_vertices() const { return remain_vertices - infinity_offset; }
+	// The largest geometric error of the collapses so far.
+	double max_error() const { return current_max_error; }
+	bool reached_max_error() const { return stopped_at_max_error; }
+	// What the collapses so far did. heap_allocations counts those made by
+	// collapse_until().
+	DecimationStats stats() const;
+
+private:
+	// Drops the collapsed rows of the working mesh and renumbers everything
+	// indexed by vertex, texture coordinate, face or edge, keeping the order.
+	void compact();
+	// The normal minimizing the 8D quadric of the wedge of every output
+	// corner, normalized. The rows of CN_out follow the texture coordinates,
+	// plus one for each further vertex sharing a texture coordinate. origins
+	// are those of the output, in the rows of the input.
+	void wedge_normals(
+		const Eigen::MatrixXi & F_out,
+		const Eigen::MatrixXi & FT_out,
+		int num_tcs,
+		const DecimationOrigins & origins,
+		Eigen::MatrixXd & CN_out,
+		Eigen::MatrixXi & FN_out ) const;
+
+	// The working mesh, with the vertex, texture coordinate and faces at
+	// infinity, scaled by pos_scale and uv_weight, and its edges (see
+	// prepare_decimate_halfedge_5d()).
+	Eigen::MatrixXd V, TC;
+	Eigen::MatrixXi F, FT;
+	Eigen::VectorXi EMAP;
+	Eigen::MatrixXi E, EF, EI;
+	PriorityQueue Q;
+	std::vector< placement_info_5d > C;
+	SeamFlags seams;
+	QuadricStore Vmetrics;
+
+	DecimationOptions options;
+	int seam_aware_degree = 0;
+	bool preserve_boundaries = false;
+	double pos_scale = 1.0;
+	double uv_weight = 1.0;
+	// The error of a collapse is sqrt(cost)/pos_scale.
+	double cost_limit = 0.0;
+	CollapseLog * collapse_log = nullptr;
+	int num_input_faces = 0;
+	// 1 if the working mesh has a vertex at infinity.
+	int infinity_offset = 0;
+	// The row of the input each row of V, TC and F comes from, once
+	// DecimationOptions::spatial_order or compact() has renumbered them; empty
+	// before.
+	std::vector< int > vertex_origins, tc_origins, face_origins;
+	int compactions = 0;
+
+	LazyEdgeUpdates lazy;
+	IndependentSetState batch_state;
+	std::vector< double > collapsed_costs;
+	DecimationWorkspace workspace;
+	int prev_e = -1;
+	int remain_vertices = 0;
+	double current_max_error = 0.0;
+	bool stopped_at_max_error = false;
+	long long heap_allocations = 0;
+};
+
+#endif
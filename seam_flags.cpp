@@ -0,0 +1,157 @@
+#include "seam_flags.h"
+#include <cassert>
+
+#define SEAM_FLAGS_NULL_EDGE -1
+
+void SeamFlags::build( const EdgeMap & edges, const Eigen::MatrixXi & E, int num_vertices )
+{
+	edge_flags.assign( E.rows(), 0 );
+	vertex_valence.assign( num_vertices, 0 );
+	vertex_locked.assign( num_vertices, 0 );
+	dense_neighbors.assign( 2*num_vertices, -1 );
+	extra_neighbors.clear();
+	for( int e = 0; e < E.rows(); ++e )
+	{
+		if( E(e,0) == SEAM_FLAGS_NULL_EDGE ) continue;
+		if( !contains_edge( edges, E(e,0), E(e,1) ) ) continue;
+		edge_flags[e] = 1;
+		add_neighbor( E(e,0), E(e,1) );
+		add_neighbor( E(e,1), E(e,0) );
+	}
+}
+
+void SeamFlags::to_edge_map( const Eigen::MatrixXi & E, EdgeMap & edges ) const
+{
+	edges.clear();
+	for( int e = 0; e < E.rows(); ++e )
+	{
+		if( edge_flags[e] ) insert_edge( edges, E(e,0), E(e,1) );
+	}
+}
+
+void SeamFlags::collapse_edge(
+	int e,
+	int s,
+	int d,
+	const int removed[2],
+	const int kept[2],
+	const std::vector<int> & renamed,
+	const Eigen::MatrixXi & E )
+{
+	// (d,x) merges into (s,x): a seam if either was one.
+	for( int side = 0; side < 2; ++side )
+	{
+		if( !edge_flags[ removed[side] ] ) continue;
+		edge_flags[ removed[side] ] = 0;
+		const int x = E( kept[side], 0 ) == s ? E( kept[side], 1 ) : E( kept[side], 0 );
+		remove_neighbor( d, x );
+		remove_neighbor( x, d );
+		if( !edge_flags[ kept[side] ] )
+		{
+			edge_flags[ kept[side] ] = 1;
+			add_neighbor( s, x );
+			add_neighbor( x, s );
+		}
+	}
+	if( edge_flags[e] )
+	{
+		edge_flags[e] = 0;
+		remove_neighbor( s, d );
+		remove_neighbor( d, s );
+	}
+	// The other seam edges of d now end at s.
+	for( auto r : renamed )
+	{
+		if( !edge_flags[r] ) continue;
+		const int y = E(r,0) == s ? E(r,1) : E(r,0);
+		replace_neighbor( y, d, s );
+		add_neighbor( s, y );
+	}
+	vertex_valence[d] = 0;
+	dense_neighbors[2*d] = dense_neighbors[2*d+1] = -1;
+	extra_neighbors.erase( d );
+}
+
+void SeamFlags::rename(
+	const std::vector<int> & new_vertices,
+	int num_vertices,
+	const std::vector<int> & new_edges,
+	int num_edges )
+{
+	std::vector<unsigned char> flags( num_edges, 0 );
+	for( int e = 0; e < int( new_edges.size() ); ++e )
+	{
+		if( new_edges[e] != -1 ) flags[ new_edges[e] ] = edge_flags[e];
+	}
+	edge_flags.swap( flags );
+
+	const auto & rename_neighbor = [&]( int n )
+	{
+		assert( n == -1 || new_vertices[n] != -1 );
+		return n == -1 ? -1 : new_vertices[n];
+	};
+	std::vector<int> valence( num_vertices, 0 );
+	std::vector<unsigned char> locked( num_vertices, 0 );
+	std::vector<int> dense( 2*num_vertices, -1 );
+	std::unordered_map< int, std::vector<int> > extra;
+	for( int v = 0; v < int( new_vertices.size() ); ++v )
+	{
+		const int w = new_vertices[v];
+		if( w == -1 ) continue;
+		valence[w] = vertex_valence[v];
+		locked[w] = vertex_locked[v];
+		dense[2*w] = rename_neighbor( dense_neighbors[2*v] );
+		dense[2*w+1] = rename_neighbor( dense_neighbors[2*v+1] );
+	}
+	for( const auto & entry : extra_neighbors )
+	{
+		if( new_vertices[ entry.first ] == -1 ) continue;
+		std::vector<int> & neighbors = extra[ new_vertices[ entry.first ] ];
+		for( auto n : entry.second ) neighbors.push_back( rename_neighbor( n ) );
+	}
+	vertex_valence.swap( valence );
+	vertex_locked.swap( locked );
+	dense_neighbors.swap( dense );
+	extra_neighbors.swap( extra );
+}
+
+void SeamFlags::add_neighbor( int v, int n )
+{
+	const int k = vertex_valence[v]++;
+	if( k < 2 ) dense_neighbors[2*v+k] = n;
+	else extra_neighbors[v].push_back( n );
+}
+
+void SeamFlags::remove_neighbor( int v, int n )
+{
+	const int last = vertex_valence[v] - 1;
+	for( int k = 0; k <= last; ++k )
+	{
+		if( neighbor_slot( v, k ) != n ) continue;
+		// Move the last neighbor into the hole.
+		neighbor_slot( v, k ) = neighbor_slot( v, last );
+		if( last >= 2 )
+		{
+			std::vector<int> & extra = extra_neighbors[v];
+			extra.pop_back();
+			if( extra.empty() ) extra_neighbors.erase( v );
+		}
+		else dense_neighbors[2*v+last] = -1;
+		--vertex_valence[v];
+		return;
+	}
+	assert( false && "Not a seam neighbor" );
+}
+
+void SeamFlags::replace_neighbor( int v, int old_n, int new_n )
+{
+	for( int k = 0; k < vertex_valence[v]; ++k )
+	{
+		if( neighbor_slot( v, k ) == old_n )
+		{
+			neighbor_slot( v, k ) = new_n;
+			return;
+		}
+	}
+	assert( false && "Not a seam neighbor" );
+}
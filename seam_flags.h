@@ -0,0 +1,75 @@
+#ifndef SEAM_FLAGS_H
+#define SEAM_FLAGS_H
+
+#include <Eigen/Core>
+#include <vector>
+#include <unordered_map>
+#include "half_edge.h"
+
+// The seam edges of an EdgeMap in flat arrays over the edges E of the mesh
+// being decimated: a flag per edge, and per vertex the number of seam edges
+// it is on and the vertices at their other ends. Every seam vertex normally
+// has at most two seam neighbors, which are stored densely; the neighbors of
+// the rare vertex where three or more seam edges meet are in a side table.
+class SeamFlags
+{
+public:
+	// Flags the edges of E whose endpoints are an edge of `edges`, for
+	// vertices [0,num_vertices).
+	void build( const EdgeMap & edges, const Eigen::MatrixXi & E, int num_vertices );
+	// Replaces `edges` with the seam edges among the live edges of E.
+	void to_edge_map( const Eigen::MatrixXi & E, EdgeMap & edges ) const;
+
+	bool is_seam_edge( int e ) const { return edge_flags[e] != 0; }
+	bool is_seam_vertex( int v ) const { return vertex_valence[v] != 0; }
+	// Locked vertices are never collapsed; build() unlocks all of them.
+	void lock_vertex( int v ) { vertex_locked[v] = 1; }
+	bool is_locked_vertex( int v ) const { return vertex_locked[v] != 0; }
+	// The number of seam edges vertex v is on.
+	int valence( int v ) const { return vertex_valence[v]; }
+	// The other end of the kth seam edge of v, k < valence(v).
+	int neighbor( int v, int k ) const
+	{
+		return k < 2 ? dense_neighbors[2*v+k] : extra_neighbors.at( v )[k-2];
+	}
+
+	// Updates the flags for collapsing edge e, merging d into s. removed[i]
+	// and kept[i] are the edges of the two collapsed faces that were merged,
+	// (d,x) into (s,x), and renamed the remaining edges of d, which now end
+	// at s in E.
+	void collapse_edge(
+		int e,
+		int s,
+		int d,
+		const int removed[2],
+		const int kept[2],
+		const std::vector<int> & renamed,
+		const Eigen::MatrixXi & E );
+
+	// Renames vertex v to new_vertices[v] and edge e to new_edges[e], dropping
+	// those renamed to -1, for a mesh compacted to num_vertices vertices and
+	// num_edges edges. The vertices dropped must not be seam neighbors of any
+	// vertex kept.
+	void rename(
+		const std::vector<int> & new_vertices,
+		int num_vertices,
+		const std::vector<int> & new_edges,
+		int num_edges );
+
+private:
+	void add_neighbor( int v, int n );
+	void remove_neighbor( int v, int n );
+	void replace_neighbor( int v, int old_n, int new_n );
+	int & neighbor_slot( int v, int k )
+	{
+		return k < 2 ? dense_neighbors[2*v+k] : extra_neighbors[v][k-2];
+	}
+
+	std::vector<unsigned char> edge_flags;
+	std::vector<int> vertex_valence;
+	std::vector<unsigned char> vertex_locked;
+	std::vector<int> dense_neighbors;
+	std::unordered_map< int, std::vector<int> > extra_neighbors;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "trace_events.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef DECIMATE_TRACING
+namespace
+{
+	struct TraceEvent
+	{
+		const char * name;
+		// Nanoseconds.
+		long long start, duration;
+		int edge, one_ring, count;
+		signed char seam;
+	};
+
+	// The events of one thread, which only that thread appends to.
+	struct ThreadTrace
+	{
+		int tid = 0;
+		std::vector< TraceEvent > events;
+	};
+
+	// start_tracing() sets the parameters before recording, which the scopes
+	// load with acquire.
+	std::atomic< bool > recording( false );
+	std::chrono::steady_clock::time_point origin;
+	long long min_duration = 0;
+	long long max_events = 0;
+	// The events kept by the duration filter, including those over max_events.
+	std::atomic< long long > num_offered( 0 );
+
+	// The trace of every thread that recorded an event. OpenMP keeps its
+	// threads around, so they are kept too and reused by the next trace.
+	std::mutex threads_mutex;
+	std::vector< std::unique_ptr< ThreadTrace > > threads;
+	thread_local ThreadTrace * this_thread = nullptr;
+
+	long long nanoseconds_since_origin()
+	{
+		return std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - origin ).count();
+	}
+
+	ThreadTrace & thread_trace()
+	{
+		if( !this_thread ) {
+			std::lock_guard< std::mutex > lock( threads_mutex );
+			threads.emplace_back( new ThreadTrace() );
+			this_thread = threads.back().get();
+			this_thread->tid = int( threads.size() );
+		}
+		return *this_thread;
+	}
+}
+#endif
+
+bool tracing_enabled()
+{
+#ifdef DECIMATE_TRACING
+	return true;
+#else
+	return false;
+#endif
+}
+
+void start_tracing( double min_duration_seconds, long long max_events )
+{
+#ifdef DECIMATE_TRACING
+	stop_tracing();
+	{
+		std::lock_guard< std::mutex > lock( threads_mutex );
+		for( auto & t : threads ) t->events.clear();
+	}
+	min_duration = (long long)( std::max( 0.0, min_duration_seconds )*1e9 );
+	::max_events = std::max( 0LL, max_events );
+	num_offered.store( 0, std::memory_order_relaxed );
+	origin = std::chrono::steady_clock::now();
+	recording.store( true, std::memory_order_release );
+#else
+	(void)min_duration_seconds;
+	(void)max_events;
+#endif
+}
+
+void stop_tracing()
+{
+#ifdef DECIMATE_TRACING
+	recording.store( false, std::memory_order_release );
+#endif
+}
+
+long long num_trace_events()
+{
+#ifdef DECIMATE_TRACING
+	return std::min( num_offered.load( std::memory_order_relaxed ), max_events );
+#else
+	return 0;
+#endif
+}
+
+long long num_dropped_trace_events()
+{
+#ifdef DECIMATE_TRACING
+	return std::max( 0LL, num_offered.load( std::memory_order_relaxed ) - max_events );
+#else
+	return 0;
+#endif
+}
+
+bool write_trace_json( const std::string & path )
+{
+#ifdef DECIMATE_TRACING
+	FILE * out = fopen( path.c_str(), "w" );
+	if( !out ) return false;
+
+	std::lock_guard< std::mutex > lock( threads_mutex );
+	fprintf( out, "{\"traceEvents\":[\n" );
+	bool first = true;
+	for( auto & t : threads ) {
+		fprintf( out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", first ? "" : ",\n", t->tid, t->tid - 1 );
+		first = false;
+		// Enclosing scopes first, so that viewers stack them the same way
+		// however close together they start.
+		std::sort( t->events.begin(), t->events.end(), []( const TraceEvent & a, const TraceEvent & b )
+		{
+			return a.start != b.start ? a.start < b.start : a.duration > b.duration;
+		} );
+		for( const auto & event : t->events ) {
+			fprintf( out, ",\n{\"name\":\"%s\",\"cat\":\"decimate\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+				event.name, t->tid, event.start*1e-3, event.duration*1e-3 );
+			const char * separator = "";
+			if( event.edge >= 0 ) {
+				fprintf( out, "\"edge\":%d,\"seam\":%s", event.edge, event.seam ? "true" : "false" );
+				separator = ",";
+			}
+			if( event.one_ring >= 0 ) {
+				fprintf( out, "%s\"one_ring\":%d", separator, event.one_ring );
+				separator = ",";
+			}
+			if( event.count >= 0 ) fprintf( out, "%s\"edges\":%d", separator, event.count );
+			fprintf( out, "}}" );
+		}
+	}
+	fprintf( out, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%lld}}\n", num_dropped_trace_events() );
+	return fclose( out ) == 0;
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+TraceScope::TraceScope( const char * name )
+	: name( name ), start( -1 ), edge( -1 ), one_ring( -1 ), count( -1 ), seam( 0 )
+{
+#ifdef DECIMATE_TRACING
+	if( recording.load( std::memory_order_acquire ) ) start = nanoseconds_since_origin();
+#endif
+}
+
+TraceScope::~TraceScope()
+{
+#ifdef DECIMATE_TRACING
+	if( start < 0 || !recording.load( std::memory_order_relaxed ) ) return;
+	const long long duration = nanoseconds_since_origin() - start;
+	if( duration < min_duration ) return;
+	if( num_offered.fetch_add( 1, std::memory_order_relaxed ) >= max_events ) return;
+	const TraceEvent event = { name, start, duration, edge, one_ring, count, seam };
+	thread_trace().events.push_back( event );
+#endif
+}
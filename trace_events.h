@@ -0,0 +1,76 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <string>
+
+// A trace of the individual steps of the collapse loop, for finding the
+// collapses that cost far more than the others (e.g. around a seam vertex of
+// high valence), which the totals of instrumentation.h average away. Each
+// traced scope becomes a Chrome trace event ("ph":"X") with the edge it
+// worked on, the number of faces around its ends and whether it is a seam
+// edge; write_trace_json() writes them in the JSON format that
+// chrome://tracing, https://ui.perfetto.dev and speedscope read, with one
+// track per thread.
+//
+// Tracing is compiled in only with DECIMATE_TRACING (the CMake option of the
+// same name, OFF by default). Without it the DECIMATE_TRACE_* macros expand
+// to nothing, their arguments aren't evaluated and tracing_enabled() returns
+// false. With it, a scope costs an atomic load until start_tracing().
+
+// Returns false unless built with DECIMATE_TRACING.
+bool tracing_enabled();
+// Discards the events so far and records from now on. Events shorter than
+// min_duration_seconds are left out, which keeps long runs small without
+// losing the slow ones; since a scope lasts at least as long as the scopes
+// inside it, what remains still nests. Once max_events are recorded, further
+// ones are only counted.
+void start_tracing( double min_duration_seconds = 0.0, long long max_events = 1 << 24 );
+void stop_tracing();
+// The events recorded and those left out because of max_events.
+long long num_trace_events();
+long long num_dropped_trace_events();
+// Writes the events recorded so far. Call it once no traced code is running.
+// Returns false if it can't write the file.
+bool write_trace_json( const std::string & path );
+
+// Records the wall time from its construction to its destruction as an event
+// named name, which must outlive the trace (a string literal), if tracing was
+// started.
+class TraceScope
+{
+public:
+	explicit TraceScope( const char * name );
+	~TraceScope();
+
+	// The arguments of the event. edge < 0 or one_ring < 0 leave them out.
+	void set_edge( int edge, int one_ring, bool seam )
+	{
+		this->edge = edge;
+		this->one_ring = one_ring;
+		this->seam = seam ? 1 : 0;
+	}
+	// The number of edges the scope handled, for those working on several.
+	void set_count( int count ) { this->count = count; }
+
+private:
+	TraceScope( const TraceScope & );
+	TraceScope & operator=( const TraceScope & );
+
+	const char * name;
+	// Nanoseconds since start_tracing(), or < 0 if not recording.
+	long long start;
+	int edge, one_ring, count;
+	signed char seam;
+};
+
+#ifdef DECIMATE_TRACING
+#define DECIMATE_TRACE_SCOPE( scope, name ) TraceScope scope( name )
+#define DECIMATE_TRACE_EDGE( scope, edge, one_ring, seam ) scope.set_edge( edge, one_ring, seam )
+#define DECIMATE_TRACE_COUNT( scope, count ) scope.set_count( count )
+#else
+#define DECIMATE_TRACE_SCOPE( scope, name ) ((void)0)
+#define DECIMATE_TRACE_EDGE( scope, edge, one_ring, seam ) ((void)0)
+#define DECIMATE_TRACE_COUNT( scope, count ) ((void)0)
+#endif
+
+#endif